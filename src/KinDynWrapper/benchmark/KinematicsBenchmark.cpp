@@ -0,0 +1,130 @@
+/**
+ * @file KinematicsBenchmark.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Eigen
+#include <Eigen/Dense>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/KinDynComputations.h>
+#include <iDynTree/Model/Model.h>
+#include <iDynTree/ModelIO/ModelLoader.h>
+
+#include <WalkingControllers/KinDynWrapper/GeneratedKinematics.h>
+
+using namespace WalkingControllers;
+
+int main(int argc, char * argv[])
+{
+    std::size_t numberOfSamples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+
+    // the model is the one used to generate the kinematics
+    iDynTree::ModelLoader loader;
+    if(!loader.loadReducedModelFromFile(GeneratedKinematics::getModelPath(), GeneratedKinematics::getJointsList()))
+    {
+        std::cerr << "Unable to load the model " << GeneratedKinematics::getModelPath() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const iDynTree::Model& model = loader.model();
+    std::size_t numberOfJoints = model.getNrOfDOFs();
+
+    std::array<iDynTree::FrameIndex, GeneratedKinematics::NumberOfFrames> frameIndices;
+    for(std::size_t frame = 0; frame < GeneratedKinematics::NumberOfFrames; frame++)
+        frameIndices[frame] = model.getFrameIndex(GeneratedKinematics::getFramesList()[frame]);
+
+    const std::array<GeneratedKinematics::Frame, GeneratedKinematics::NumberOfBases> baseFrames
+        = {GeneratedKinematics::LeftFoot, GeneratedKinematics::RightFoot, GeneratedKinematics::Root};
+
+    std::mt19937 randomGenerator(0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    std::vector<Eigen::VectorXd> jointPositions(numberOfSamples, Eigen::VectorXd(numberOfJoints));
+    for(auto& sample : jointPositions)
+        for(unsigned int i = 0; i < numberOfJoints; i++)
+            sample(i) = distribution(randomGenerator);
+
+    GeneratedKinematics::Data data;
+    data.resize(numberOfJoints);
+
+    iDynTree::VectorDynSize positions(numberOfJoints), velocities(numberOfJoints);
+    velocities.zero();
+    iDynTree::Twist baseTwist;
+    baseTwist.zero();
+    iDynTree::Vector3 gravity;
+    gravity.zero();
+    gravity(2) = -9.81;
+    iDynTree::MatrixDynSize jacobian(6, numberOfJoints + 6), comJacobian(3, numberOfJoints + 6);
+
+    for(std::size_t base = 0; base < GeneratedKinematics::NumberOfBases; base++)
+    {
+        // the base is the link of the frame. In the link frame the world to base transform is
+        // the identity, hence the quantities of the two implementations can be directly compared
+        iDynTree::KinDynComputations kinDyn;
+        kinDyn.loadRobotModel(model);
+        kinDyn.setFrameVelocityRepresentation(iDynTree::MIXED_REPRESENTATION);
+        iDynTree::LinkIndex baseLink = model.getFrameLink(frameIndices[baseFrames[base]]);
+        kinDyn.setFloatingBase(model.getLinkName(baseLink));
+
+        double maxError = 0;
+        auto kinDynTime = std::chrono::steady_clock::duration::zero();
+        auto generatedTime = std::chrono::steady_clock::duration::zero();
+        for(const auto& sample : jointPositions)
+        {
+            // the frames quantities are retrieved in both the implementations, the comparison is not timed
+            iDynTree::toEigen(positions) = sample;
+
+            auto start = std::chrono::steady_clock::now();
+            kinDyn.setRobotState(iDynTree::Transform::Identity(), positions, baseTwist, velocities, gravity);
+            for(std::size_t frame = 0; frame < GeneratedKinematics::NumberOfFrames; frame++)
+            {
+                iDynTree::Transform transform = kinDyn.getWorldTransform(frameIndices[frame]);
+                kinDyn.getFrameFreeFloatingJacobian(frameIndices[frame], jacobian);
+            }
+            iDynTree::Position comPosition = kinDyn.getCenterOfMassPosition();
+            kinDyn.getCenterOfMassJacobian(comJacobian);
+            kinDynTime += std::chrono::steady_clock::now() - start;
+
+            start = std::chrono::steady_clock::now();
+            GeneratedKinematics::computeKinematics(static_cast<GeneratedKinematics::Base>(base), sample, data);
+            generatedTime += std::chrono::steady_clock::now() - start;
+
+            for(std::size_t frame = 0; frame < GeneratedKinematics::NumberOfFrames; frame++)
+            {
+                iDynTree::Transform transform = kinDyn.getWorldTransform(frameIndices[frame]);
+                kinDyn.getFrameFreeFloatingJacobian(frameIndices[frame], jacobian);
+                maxError = std::max(maxError, (iDynTree::toEigen(transform.getPosition())
+                                               - data.positions[frame]).cwiseAbs().maxCoeff());
+                maxError = std::max(maxError, (iDynTree::toEigen(transform.getRotation())
+                                               - data.rotations[frame]).cwiseAbs().maxCoeff());
+                maxError = std::max(maxError, (iDynTree::toEigen(jacobian).rightCols(numberOfJoints)
+                                               - data.jacobians[frame]).cwiseAbs().maxCoeff());
+            }
+            maxError = std::max(maxError, (iDynTree::toEigen(comPosition) - data.comPosition).cwiseAbs().maxCoeff());
+            maxError = std::max(maxError, (iDynTree::toEigen(comJacobian).rightCols(numberOfJoints)
+                                           - data.comJacobian).cwiseAbs().maxCoeff());
+        }
+
+        using Microseconds = std::chrono::duration<double, std::micro>;
+        std::cout << "Base: " << model.getLinkName(baseLink) << std::endl
+                  << "    KinDynComputations: "
+                  << Microseconds(kinDynTime).count() / numberOfSamples << " us" << std::endl
+                  << "    generated kinematics: "
+                  << Microseconds(generatedTime).count() / numberOfSamples << " us" << std::endl
+                  << "    maximum error: " << maxError << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,451 @@
+/**
+ * @file KinematicsGenerator.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// YARP
+#include <yarp/os/Bottle.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Property.h>
+
+// Eigen
+#include <Eigen/Dense>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Model/Model.h>
+#include <iDynTree/Model/Traversal.h>
+#include <iDynTree/ModelIO/ModelLoader.h>
+
+#include <WalkingControllers/KinDynWrapper/GeneratedKinematics.h>
+
+namespace
+{
+    /**
+     * Keys of the forwardKinematics.ini file associated to the generated frames.
+     */
+    const std::array<std::string, WalkingControllers::GeneratedKinematics::NumberOfFrames> frameKeys
+        = {"left_foot_frame", "right_foot_frame", "left_hand_frame", "right_hand_frame",
+           "head_frame", "root_frame", "torso_frame"};
+
+    /**
+     * Frames whose links are used as floating base.
+     */
+    const std::array<WalkingControllers::GeneratedKinematics::Frame,
+                     WalkingControllers::GeneratedKinematics::NumberOfBases> baseFrames
+        = {WalkingControllers::GeneratedKinematics::LeftFoot,
+           WalkingControllers::GeneratedKinematics::RightFoot,
+           WalkingControllers::GeneratedKinematics::Root};
+
+    const std::array<std::string, WalkingControllers::GeneratedKinematics::NumberOfBases> baseNames
+        = {"LeftFootBase", "RightFootBase", "RootBase"};
+
+    const double tolerance = 1e-12;
+
+    std::string toString(const double& value)
+    {
+        std::ostringstream stream;
+        stream << std::setprecision(17) << value;
+        return stream.str();
+    }
+
+    std::string toString(const Eigen::Vector3d& vector)
+    {
+        return "Eigen::Vector3d(" + toString(vector(0)) + ", " + toString(vector(1)) + ", "
+            + toString(vector(2)) + ")";
+    }
+
+    std::string toString(const Eigen::Matrix3d& matrix)
+    {
+        std::string output = "(Eigen::Matrix3d() << ";
+        for(int i = 0; i < 3; i++)
+            for(int j = 0; j < 3; j++)
+                output += toString(matrix(i, j)) + ((i == 2 && j == 2) ? "" : ", ");
+        return output + ").finished()";
+    }
+
+    bool isIdentity(const Eigen::Matrix3d& matrix)
+    {
+        return matrix.isIdentity(tolerance);
+    }
+
+    bool isZero(const Eigen::Vector3d& vector)
+    {
+        return vector.isZero(tolerance);
+    }
+
+    /**
+     * Joint whose motion is unrolled in the generated code.
+     */
+    struct JointData
+    {
+        int dofOffset; /**< Index of the joint in the joint positions vector. */
+        Eigen::Vector3d axis; /**< Direction of the axis expressed in the child link. */
+        Eigen::Vector3d point; /**< Point of the axis expressed in the child link. */
+    };
+
+    /**
+     * Write the function evaluating the kinematics for a floating base.
+     * @param model the model of the robot;
+     * @param frameIndices indices of the frames;
+     * @param base the floating base;
+     * @param stream output stream.
+     * @return true/false in case of success/failure.
+     */
+    bool writeKinematics(const iDynTree::Model& model,
+                         const std::array<iDynTree::FrameIndex, WalkingControllers::GeneratedKinematics::NumberOfFrames>& frameIndices,
+                         const WalkingControllers::GeneratedKinematics::Base& base,
+                         std::ostream& stream)
+    {
+        iDynTree::LinkIndex baseLinkIndex = model.getFrameLink(frameIndices[baseFrames[base]]);
+
+        iDynTree::Traversal traversal;
+        if(!model.computeFullTreeTraversal(traversal, baseLinkIndex))
+        {
+            yError() << "[writeKinematics] Unable to compute the traversal of the model.";
+            return false;
+        }
+
+        iDynTree::VectorDynSize zeroJointPositions(model.getNrOfPosCoords());
+        zeroJointPositions.zero();
+
+        std::vector<JointData> joints(model.getNrOfLinks());
+        std::vector<std::vector<iDynTree::LinkIndex>> children(model.getNrOfLinks());
+
+        stream << "    void computeKinematics" << baseNames[base]
+               << "(const Eigen::Ref<const Eigen::VectorXd>& q, GeneratedKinematics::Data& data)\n";
+        stream << "    {\n";
+
+        // forward kinematics (the links are visited from the floating base)
+        for(unsigned int i = 0; i < traversal.getNrOfVisitedLinks(); i++)
+        {
+            iDynTree::LinkIndex link = traversal.getLink(i)->getIndex();
+            std::string R = "R" + std::to_string(link);
+            std::string p = "p" + std::to_string(link);
+
+            if(i == 0)
+            {
+                stream << "        // " << model.getLinkName(link) << " (floating base)\n";
+                stream << "        const Eigen::Matrix3d " << R << " = Eigen::Matrix3d::Identity();\n";
+                stream << "        const Eigen::Vector3d " << p << " = Eigen::Vector3d::Zero();\n";
+                continue;
+            }
+
+            iDynTree::LinkIndex parent = traversal.getParentLink(i)->getIndex();
+            iDynTree::IJointConstPtr joint = traversal.getParentJoint(i);
+            children[parent].push_back(link);
+
+            std::string parentR = "R" + std::to_string(parent);
+            std::string parentp = "p" + std::to_string(parent);
+
+            // parent_H_link at the rest position
+            iDynTree::Transform restTransform = joint->getTransform(zeroJointPositions, parent, link);
+            Eigen::Matrix3d restRotation = iDynTree::toEigen(restTransform.getRotation());
+            Eigen::Vector3d restPosition = iDynTree::toEigen(restTransform.getPosition());
+
+            stream << "        // " << model.getLinkName(link) << " (joint "
+                   << model.getJointName(joint->getIndex()) << ")\n";
+
+            std::string parentRrest = isIdentity(restRotation) ? parentR
+                : "(" + parentR + " * " + toString(restRotation) + ")";
+
+            if(joint->getNrOfDOFs() == 0)
+            {
+                joints[link].dofOffset = -1;
+                stream << "        const Eigen::Matrix3d " << R << " = " << parentRrest << ";\n";
+                stream << "        const Eigen::Vector3d " << p << " = " << parentp << " + " << parentR
+                       << " * " << toString(restPosition) << ";\n";
+                continue;
+            }
+
+            if(joint->getNrOfDOFs() != 1)
+            {
+                yError() << "[writeKinematics] Only the joints with one degree of freedom are supported. Joint:"
+                         << model.getJointName(joint->getIndex());
+                return false;
+            }
+
+            // motion subspace of the joint expressed in the link frame. The link rotates about
+            // the axis (axis, point) fixed in the link frame
+            iDynTree::SpatialMotionVector motionSubspace = joint->getMotionSubspaceVector(0, link, parent);
+            Eigen::Vector3d linear = iDynTree::toEigen(motionSubspace.getLinearVec3());
+            Eigen::Vector3d angular = iDynTree::toEigen(motionSubspace.getAngularVec3());
+            if(std::abs(angular.norm() - 1) > 1e-9)
+            {
+                yError() << "[writeKinematics] Only the revolute joints are supported. Joint:"
+                         << model.getJointName(joint->getIndex());
+                return false;
+            }
+
+            JointData& jointData = joints[link];
+            jointData.dofOffset = joint->getDOFsOffset();
+            jointData.axis = angular;
+            jointData.point = angular.cross(linear);
+
+            std::string Q = "Q" + std::to_string(link);
+            std::string jointPosition = "q(" + std::to_string(jointData.dofOffset) + ")";
+            stream << "        const Eigen::Matrix3d " << Q << " = Eigen::AngleAxisd(" << jointPosition
+                   << ", " << toString(jointData.axis) << ").toRotationMatrix();\n";
+            stream << "        const Eigen::Matrix3d " << R << " = " << parentRrest << " * " << Q << ";\n";
+            if(isZero(jointData.point))
+                stream << "        const Eigen::Vector3d " << p << " = " << parentp << " + " << parentR
+                       << " * " << toString(restPosition) << ";\n";
+            else
+                stream << "        const Eigen::Vector3d " << p << " = " << parentp << " + " << parentR
+                       << " * (" << toString(restPosition) << " + " << toString(restRotation) << " * ("
+                       << toString(jointData.point) << " - " << Q << " * " << toString(jointData.point)
+                       << "));\n";
+
+            // axis of the joint expressed in the base frame
+            stream << "        const Eigen::Vector3d z" << link << " = " << R << " * "
+                   << toString(jointData.axis) << ";\n";
+            if(isZero(jointData.point))
+                stream << "        const Eigen::Vector3d o" << link << " = " << p << ";\n";
+            else
+                stream << "        const Eigen::Vector3d o" << link << " = " << p << " + " << R << " * "
+                       << toString(jointData.point) << ";\n";
+        }
+
+        // frames
+        for(std::size_t frame = 0; frame < WalkingControllers::GeneratedKinematics::NumberOfFrames; frame++)
+        {
+            iDynTree::FrameIndex frameIndex = frameIndices[frame];
+            iDynTree::LinkIndex link = model.getFrameLink(frameIndex);
+            iDynTree::Transform linkTransform = model.getFrameTransform(frameIndex);
+            Eigen::Matrix3d rotation = iDynTree::toEigen(linkTransform.getRotation());
+            Eigen::Vector3d position = iDynTree::toEigen(linkTransform.getPosition());
+
+            std::string R = "R" + std::to_string(link);
+            std::string p = "p" + std::to_string(link);
+            std::string rotationName = "data.rotations[" + std::to_string(frame) + "]";
+            std::string positionName = "data.positions[" + std::to_string(frame) + "]";
+            std::string jacobianName = "data.jacobians[" + std::to_string(frame) + "]";
+
+            stream << "\n        // " << model.getFrameName(frameIndex) << "\n";
+            if(isIdentity(rotation))
+                stream << "        " << rotationName << " = " << R << ";\n";
+            else
+                stream << "        " << rotationName << " = " << R << " * " << toString(rotation) << ";\n";
+
+            if(isZero(position))
+                stream << "        " << positionName << " = " << p << ";\n";
+            else
+                stream << "        " << positionName << " = " << p << " + " << R << " * "
+                       << toString(position) << ";\n";
+
+            // only the joints between the frame and the floating base move the frame
+            stream << "        " << jacobianName << ".setZero();\n";
+            for(iDynTree::LinkIndex l = link; l != baseLinkIndex;
+                l = traversal.getParentLinkFromLinkIndex(l)->getIndex())
+            {
+                const JointData& jointData = joints[l];
+                if(jointData.dofOffset < 0)
+                    continue;
+
+                std::string column = std::to_string(jointData.dofOffset);
+                stream << "        " << jacobianName << ".block<3, 1>(0, " << column << ") = z" << l
+                       << ".cross(" << positionName << " - o" << l << ");\n";
+                stream << "        " << jacobianName << ".block<3, 1>(3, " << column << ") = z" << l << ";\n";
+            }
+        }
+
+        // center of mass. The first moments of the subtrees are evaluated from the leaves
+        double totalMass = 0;
+        std::vector<double> subtreeMasses(model.getNrOfLinks(), 0);
+        stream << "\n        // center of mass\n";
+        for(int i = traversal.getNrOfVisitedLinks() - 1; i >= 0; i--)
+        {
+            iDynTree::LinkIndex link = traversal.getLink(i)->getIndex();
+            const iDynTree::SpatialInertia& inertia = model.getLink(link)->getInertia();
+            double mass = inertia.getMass();
+            Eigen::Vector3d com = iDynTree::toEigen(inertia.getCenterOfMass());
+            std::string firstMoment;
+
+            if(mass > 0)
+            {
+                std::string R = "R" + std::to_string(link);
+                std::string p = "p" + std::to_string(link);
+                firstMoment = toString(mass) + " * (" + p + " + " + R + " * " + toString(com) + ")";
+            }
+
+            subtreeMasses[link] = mass;
+            for(const auto& child : children[link])
+            {
+                if(subtreeMasses[child] <= 0)
+                    continue;
+
+                subtreeMasses[link] += subtreeMasses[child];
+                firstMoment += (firstMoment.empty() ? "" : " + ") + std::string("s") + std::to_string(child);
+            }
+
+            if(subtreeMasses[link] > 0)
+                stream << "        const Eigen::Vector3d s" << link << " = " << firstMoment << ";\n";
+        }
+
+        totalMass = subtreeMasses[baseLinkIndex];
+        if(totalMass <= 0)
+        {
+            yError() << "[writeKinematics] The mass of the model is not positive.";
+            return false;
+        }
+
+        stream << "        data.comPosition = s" << baseLinkIndex << " / " << toString(totalMass) << ";\n";
+        stream << "        data.comJacobian.setZero();\n";
+        for(unsigned int i = 1; i < traversal.getNrOfVisitedLinks(); i++)
+        {
+            iDynTree::LinkIndex link = traversal.getLink(i)->getIndex();
+            const JointData& jointData = joints[link];
+            if(jointData.dofOffset < 0 || subtreeMasses[link] <= 0)
+                continue;
+
+            stream << "        data.comJacobian.col(" << jointData.dofOffset << ") = z" << link
+                   << ".cross(s" << link << " - " << toString(subtreeMasses[link]) << " * o" << link
+                   << ") / " << toString(totalMass) << ";\n";
+        }
+
+        stream << "    }\n\n";
+        return true;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    if(!options.check("model") || !options.check("robot_control")
+       || !options.check("forward_kinematics") || !options.check("output"))
+    {
+        yError() << "Usage: WalkingControllersKinematicsGenerator --model <urdf> --robot_control <robotControl.ini>"
+                 << "--forward_kinematics <forwardKinematics.ini> --output <cpp file>";
+        return EXIT_FAILURE;
+    }
+
+    std::string modelPath = options.find("model").asString();
+
+    // the joints list is retrieved from the robot control configuration
+    yarp::os::Property robotControlOptions;
+    if(!robotControlOptions.fromConfigFile(options.find("robot_control").asString()))
+    {
+        yError() << "[main] Unable to read the robot control configuration.";
+        return EXIT_FAILURE;
+    }
+
+    yarp::os::Value* jointsListYarp;
+    if(!robotControlOptions.check("joints_list", jointsListYarp) || !jointsListYarp->isList())
+    {
+        yError() << "[main] Unable to find joints_list into config file.";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> jointsList;
+    for(int i = 0; i < jointsListYarp->asList()->size(); i++)
+        jointsList.push_back(jointsListYarp->asList()->get(i).asString());
+
+    yarp::os::Property forwardKinematicsOptions;
+    if(!forwardKinematicsOptions.fromConfigFile(options.find("forward_kinematics").asString()))
+    {
+        yError() << "[main] Unable to read the forward kinematics configuration.";
+        return EXIT_FAILURE;
+    }
+
+    // only the controlled joints are extracted from the URDF file (as in the WalkingModule)
+    iDynTree::ModelLoader loader;
+    if(!loader.loadReducedModelFromFile(modelPath, jointsList))
+    {
+        yError() << "[main] Error while loading the model from " << modelPath;
+        return EXIT_FAILURE;
+    }
+    const iDynTree::Model& model = loader.model();
+
+    std::array<std::string, WalkingControllers::GeneratedKinematics::NumberOfFrames> frameNames;
+    std::array<iDynTree::FrameIndex, WalkingControllers::GeneratedKinematics::NumberOfFrames> frameIndices;
+    for(std::size_t frame = 0; frame < WalkingControllers::GeneratedKinematics::NumberOfFrames; frame++)
+    {
+        frameNames[frame] = forwardKinematicsOptions.find(frameKeys[frame]).asString();
+        frameIndices[frame] = model.getFrameIndex(frameNames[frame]);
+        if(frameIndices[frame] == iDynTree::FRAME_INVALID_INDEX)
+        {
+            yError() << "[main] Unable to find the frame named: " << frameNames[frame];
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::string> modelJointsList(model.getNrOfDOFs());
+    for(iDynTree::JointIndex joint = 0; joint < model.getNrOfJoints(); joint++)
+        if(model.getJoint(joint)->getNrOfDOFs() == 1)
+            modelJointsList[model.getJoint(joint)->getDOFsOffset()] = model.getJointName(joint);
+
+    std::ostringstream stream;
+    stream << "// This file has been generated by WalkingControllersKinematicsGenerator. Do not edit it.\n";
+    stream << "// model: " << modelPath << "\n\n";
+    stream << "#include <WalkingControllers/KinDynWrapper/GeneratedKinematics.h>\n\n";
+    stream << "using namespace WalkingControllers;\n\n";
+    stream << "namespace\n{\n";
+    for(std::size_t base = 0; base < WalkingControllers::GeneratedKinematics::NumberOfBases; base++)
+        if(!writeKinematics(model, frameIndices, static_cast<WalkingControllers::GeneratedKinematics::Base>(base), stream))
+        {
+            yError() << "[main] Unable to generate the kinematics for the base" << baseNames[base];
+            return EXIT_FAILURE;
+        }
+    stream << "}\n\n";
+
+    stream << "void GeneratedKinematics::Data::resize(const std::size_t& numberOfJoints)\n{\n";
+    stream << "    for(auto& jacobian : jacobians)\n";
+    stream << "        jacobian.resize(6, numberOfJoints);\n";
+    stream << "    comJacobian.resize(3, numberOfJoints);\n}\n\n";
+
+    stream << "std::size_t GeneratedKinematics::getNumberOfJoints()\n{\n";
+    stream << "    return " << model.getNrOfDOFs() << ";\n}\n\n";
+
+    stream << "const std::vector<std::string>& GeneratedKinematics::getJointsList()\n{\n";
+    stream << "    static const std::vector<std::string> jointsList = {";
+    for(std::size_t i = 0; i < modelJointsList.size(); i++)
+        stream << (i == 0 ? "" : ", ") << "\"" << modelJointsList[i] << "\"";
+    stream << "};\n    return jointsList;\n}\n\n";
+
+    stream << "const std::array<std::string, GeneratedKinematics::NumberOfFrames>& GeneratedKinematics::getFramesList()\n{\n";
+    stream << "    static const std::array<std::string, NumberOfFrames> framesList = {";
+    for(std::size_t i = 0; i < frameNames.size(); i++)
+        stream << (i == 0 ? "" : ", ") << "\"" << frameNames[i] << "\"";
+    stream << "};\n    return framesList;\n}\n\n";
+
+    stream << "const std::string& GeneratedKinematics::getModelPath()\n{\n";
+    stream << "    static const std::string modelPath = \"" << modelPath << "\";\n";
+    stream << "    return modelPath;\n}\n\n";
+
+    stream << "void GeneratedKinematics::computeKinematics(const Base& base, const Eigen::Ref<const Eigen::VectorXd>& jointPositions,\n";
+    stream << "                                            Data& data)\n{\n";
+    stream << "    switch(base)\n    {\n";
+    for(std::size_t base = 0; base < WalkingControllers::GeneratedKinematics::NumberOfBases; base++)
+    {
+        stream << "    case " << baseNames[base] << ":\n";
+        stream << "        computeKinematics" << baseNames[base] << "(jointPositions, data);\n";
+        stream << "        break;\n";
+    }
+    stream << "    default:\n        break;\n    }\n}\n";
+
+    std::string outputPath = options.find("output").asString();
+    std::ofstream outputFile(outputPath);
+    if(!outputFile.is_open())
+    {
+        yError() << "[main] Unable to open the file " << outputPath;
+        return EXIT_FAILURE;
+    }
+    outputFile << stream.str();
+
+    yInfo() << "[main] The kinematics of the model" << modelPath << "has been written in" << outputPath;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file GeneratedKinematics.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_KINDYN_WRAPPER_GENERATED_KINEMATICS_H
+#define WALKING_CONTROLLERS_KINDYN_WRAPPER_GENERATED_KINEMATICS_H
+
+// std
+#include <array>
+#include <string>
+#include <vector>
+
+// Eigen
+#include <Eigen/Dense>
+
+namespace WalkingControllers
+{
+    /**
+     * Kinematics of the frames used by WalkingFK specialized for a robot model. The
+     * implementation is generated at build time by WalkingControllersKinematicsGenerator
+     * starting from the URDF model and the list of the controlled joints. For each candidate
+     * floating base the forward kinematics is unrolled in straight-line code.
+     */
+    namespace GeneratedKinematics
+    {
+        /**
+         * Frames evaluated by the generated kinematics (same order of the forwardKinematics.ini keys).
+         */
+        enum Frame : std::size_t
+        {
+            LeftFoot = 0, /**< left_foot_frame. */
+            RightFoot, /**< right_foot_frame. */
+            LeftHand, /**< left_hand_frame. */
+            RightHand, /**< right_hand_frame. */
+            Head, /**< head_frame. */
+            Root, /**< root_frame. */
+            Neck, /**< torso_frame. */
+            NumberOfFrames
+        };
+
+        /**
+         * Candidate floating bases. The floating base is the link to which the frame is attached.
+         */
+        enum Base : std::size_t
+        {
+            LeftFootBase = 0, /**< link of the left_foot_frame. */
+            RightFootBase, /**< link of the right_foot_frame. */
+            RootBase, /**< link of the root_frame. */
+            NumberOfBases
+        };
+
+        /**
+         * Kinematic quantities expressed in the floating base link frame.
+         */
+        struct Data
+        {
+            std::array<Eigen::Matrix3d, NumberOfFrames> rotations; /**< base_R_frame. */
+            std::array<Eigen::Vector3d, NumberOfFrames> positions; /**< base_p_frame. */
+            std::array<Eigen::MatrixXd, NumberOfFrames> jacobians; /**< Joint part of the frames Jacobians (linear and angular). */
+            Eigen::Vector3d comPosition; /**< base_p_com. */
+            Eigen::MatrixXd comJacobian; /**< Joint part of the CoM Jacobian. */
+
+            /**
+             * Resize the Jacobians.
+             * @param numberOfJoints number of joints of the model.
+             */
+            void resize(const std::size_t& numberOfJoints);
+        };
+
+        /**
+         * Get the number of joints of the model used to generate the kinematics.
+         * @return the number of joints.
+         */
+        std::size_t getNumberOfJoints();
+
+        /**
+         * Get the names of the joints (in the order of the model).
+         * @return the joints list.
+         */
+        const std::vector<std::string>& getJointsList();
+
+        /**
+         * Get the names of the frames.
+         * @return the frames list.
+         */
+        const std::array<std::string, NumberOfFrames>& getFramesList();
+
+        /**
+         * Get the path of the model used to generate the kinematics.
+         * @return the path of the URDF file.
+         */
+        const std::string& getModelPath();
+
+        /**
+         * Evaluate the kinematics.
+         * @param base the floating base;
+         * @param jointPositions joint positions in radians;
+         * @param data quantities expressed in the floating base link frame (the Jacobians have
+         * to be already resized).
+         */
+        void computeKinematics(const Base& base, const Eigen::Ref<const Eigen::VectorXd>& jointPositions,
+                               Data& data);
+    };
+};
+
+#endif
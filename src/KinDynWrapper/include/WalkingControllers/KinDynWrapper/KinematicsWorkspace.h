@@ -0,0 +1,199 @@
+/**
+ * @file KinematicsWorkspace.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_KINDYN_WRAPPER_KINEMATICS_WORKSPACE_H
+#define WALKING_CONTROLLERS_KINDYN_WRAPPER_KINEMATICS_WORKSPACE_H
+
+// std
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// iDynTree
+#include <iDynTree/Core/MatrixDynSize.h>
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/Model/LinkState.h>
+#include <iDynTree/Model/Model.h>
+#include <iDynTree/Model/Traversal.h>
+
+namespace WalkingControllers
+{
+    /**
+     * Immutable data shared by all the KinematicsWorkspace objects. It contains the reduced
+     * model and the traversal of the model rooted at the floating base.
+     */
+    struct KinematicsModel
+    {
+        iDynTree::Model model; /**< Reduced model of the robot. */
+        iDynTree::Traversal traversal; /**< Traversal of the model whose root is the base link. */
+        iDynTree::LinkIndex baseLink; /**< Index of the floating base link. */
+        iDynTree::Transform baseFrameToLinkTransform; /**< Transform between the base frame and its link. */
+        std::vector<iDynTree::Position> linkCoMs; /**< CoM of the links expressed in the link frames. */
+        std::vector<double> linkMasses; /**< Mass of the links. */
+        double totalMass; /**< Mass of the robot. */
+    };
+
+    /**
+     * Create the data shared by the KinematicsWorkspace objects.
+     * @param model reduced model of the robot;
+     * @param baseFrame name of the frame whose configuration is set in the workspaces (its link
+     * is the floating base);
+     * @param kinematicsModel the shared data.
+     * @return true/false in case of success/failure.
+     */
+    bool createKinematicsModel(const iDynTree::Model& model, const std::string& baseFrame,
+                               std::shared_ptr<const KinematicsModel>& kinematicsModel);
+
+    /**
+     * Configuration of the robot evaluated by a KinematicsWorkspace.
+     */
+    struct KinematicsConfiguration
+    {
+        iDynTree::Transform worldToBaseTransform; /**< Transform between the world and the base frame. */
+        iDynTree::VectorDynSize jointPositions; /**< Joint positions in radians. */
+    };
+
+    /**
+     * KinematicsWorkspace class. It evaluates the forward kinematics of an hypothetical
+     * configuration of the robot. The model is shared among the workspaces, each workspace only
+     * stores the state of its configuration, so several workspaces can be used in the same tick
+     * (e.g. by different threads).
+     */
+    class KinematicsWorkspace
+    {
+        std::shared_ptr<const KinematicsModel> m_kinematicsModel; /**< Shared model. */
+
+        iDynTree::Transform m_worldToBaseLinkTransform; /**< Transform between the world and the base link. */
+        iDynTree::VectorDynSize m_jointPositions; /**< Joint positions in radians. */
+        iDynTree::LinkPositions m_linkPositions; /**< Transform between the world and each link. */
+        iDynTree::Position m_comPosition; /**< Position of the CoM. */
+        bool m_isEvaluated{false}; /**< True if the configuration is evaluated. */
+
+    public:
+
+        /**
+         * Initialize the workspace.
+         * @param kinematicsModel shared model.
+         * @return true/false in case of success/failure.
+         */
+        bool initialize(std::shared_ptr<const KinematicsModel> kinematicsModel);
+
+        /**
+         * Evaluate the forward kinematics of a configuration.
+         * @param worldToBaseTransform transform between the world and the base frame;
+         * @param jointPositions joint positions in radians.
+         * @return true/false in case of success/failure.
+         */
+        bool setConfiguration(const iDynTree::Transform& worldToBaseTransform,
+                              const iDynTree::VectorDynSize& jointPositions);
+
+        /**
+         * Evaluate the forward kinematics of a configuration.
+         * @param configuration the configuration of the robot.
+         * @return true/false in case of success/failure.
+         */
+        bool setConfiguration(const KinematicsConfiguration& configuration);
+
+        /**
+         * Get the transform between the world and a frame.
+         * @param frame index of the frame in the model;
+         * @param transform world_H_frame.
+         * @return true/false in case of success/failure.
+         */
+        bool getWorldTransform(const iDynTree::FrameIndex& frame, iDynTree::Transform& transform) const;
+
+        /**
+         * Get the free floating jacobian of a frame. The mixed representation is used and the base
+         * is the base link.
+         * @param frame index of the frame in the model;
+         * @param jacobian the jacobian (6 x (n + 6)).
+         * @return true/false in case of success/failure.
+         */
+        bool getFrameFreeFloatingJacobian(const iDynTree::FrameIndex& frame, iDynTree::MatrixDynSize& jacobian) const;
+
+        /**
+         * Get the position of the CoM.
+         * @return the CoM position.
+         */
+        const iDynTree::Position& getCoMPosition() const;
+
+        /**
+         * Get the shared model.
+         * @return the shared model.
+         */
+        const KinematicsModel& getKinematicsModel() const;
+    };
+
+    /**
+     * KinematicsBatch class. It evaluates a batch of configurations in parallel. Each configuration
+     * is assigned to a KinematicsWorkspace and the workspaces are processed by a pool of threads.
+     */
+    class KinematicsBatch
+    {
+        std::vector<KinematicsWorkspace> m_workspaces; /**< One workspace for each configuration. */
+        std::vector<bool> m_isEvaluated; /**< True if the configuration is correctly evaluated. */
+        const std::vector<KinematicsConfiguration>* m_configurations{nullptr}; /**< Configurations of the batch. */
+        std::size_t m_numberOfConfigurations{0}; /**< Number of configurations of the batch. */
+        std::size_t m_nextConfiguration{0}; /**< Next configuration to be evaluated. */
+        std::size_t m_evaluatedConfigurations{0}; /**< Number of evaluated configurations. */
+
+        std::vector<std::thread> m_workers; /**< Thread pool. */
+        bool m_isClosing{false}; /**< True if the workers have to stop. */
+        std::mutex m_mutex; /**< Mutex protecting the batch. */
+        std::condition_variable m_startCondition; /**< Used to wake up the workers. */
+        std::condition_variable m_doneCondition; /**< Used to notify that the batch is evaluated. */
+
+        /**
+         * Main loop of a worker thread.
+         */
+        void run();
+
+    public:
+
+        /**
+         * Destructor.
+         */
+        ~KinematicsBatch();
+
+        /**
+         * Initialize the workspaces and start the thread pool.
+         * @param kinematicsModel shared model;
+         * @param capacity maximum number of configurations in a batch;
+         * @param numberOfThreads number of threads of the pool.
+         * @return true/false in case of success/failure.
+         */
+        bool initialize(std::shared_ptr<const KinematicsModel> kinematicsModel, const std::size_t& capacity,
+                        const std::size_t& numberOfThreads);
+
+        /**
+         * Evaluate the configurations. The function returns when all the configurations are evaluated.
+         * @param configurations the configurations (the number of configurations cannot be greater
+         * than the capacity).
+         * @return true if all the configurations are evaluated.
+         */
+        bool evaluate(const std::vector<KinematicsConfiguration>& configurations);
+
+        /**
+         * Get the workspace of an evaluated configuration.
+         * @param configuration index of the configuration in the last batch.
+         * @return the workspace.
+         */
+        const KinematicsWorkspace& getWorkspace(const std::size_t& configuration) const;
+
+        /**
+         * Stop the thread pool.
+         */
+        void close();
+    };
+};
+
+#endif
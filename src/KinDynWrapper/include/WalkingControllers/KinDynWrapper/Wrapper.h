@@ -10,35 +10,101 @@
 #define WALKING_CONTROLLERS_KINDYN_WRAPPER_WRAPPER_H
 
 // std
+#include <array>
 #include <memory>
 
 // YARP
 #include <yarp/os/Searchable.h>
 
 //iDynTree
+#include <iDynTree/Core/Wrench.h>
 #include <iDynTree/KinDynComputations.h>
 #include <iDynTree/Model/FreeFloatingState.h>
+#include <iDynTree/Model/Model.h>
 
-// iCub-ctrl
-#include <iCub/ctrl/filters.h>
-
-#include <unordered_map>
+#include <WalkingControllers/iDynTreeUtilities/FilterBank.h>
+#include <WalkingControllers/KinDynWrapper/KinematicsWorkspace.h>
 
 namespace WalkingControllers
 {
+    /**
+     * Robot configuration used to evaluate the kinematic quantities.
+     */
+    enum class KinematicsState
+    {
+        Measured, /**< Joint positions and velocities retrieved from the robot. */
+        Desired /**< Joint positions and velocities computed by the inverse kinematics. */
+    };
 
     class WalkingFK
     {
-        iDynTree::KinDynComputations m_kinDyn; /**< KinDynComputations solver. */
+        /**
+         * Frames whose world transformations are cached.
+         */
+        enum CachedFrame : std::size_t
+        {
+            LeftFoot = 0,
+            RightFoot,
+            LeftHand,
+            RightHand,
+            Head,
+            Root,
+            Neck,
+            NumberOfCachedFrames
+        };
+
+        /**
+         * World transformations of the cached frames evaluated for a robot state.
+         */
+        struct FrameTransformsCache
+        {
+            std::array<iDynTree::Transform, NumberOfCachedFrames> worldTransforms; /**< world_H_frame of the cached frames. */
+            bool isEvaluated{false}; /**< are the transformations evaluated? */
+        };
+
+        /**
+         * Links that can be used as floating base.
+         */
+        enum BaseFrame : std::size_t
+        {
+            LeftFootBase = 0,
+            RightFootBase,
+            RootBase,
+            NumberOfBaseFrames
+        };
+
+        /**
+         * Kinematics associated to a candidate floating base. The floating base is set only once
+         * when the base frame is registered, hence switching the base does not require to
+         * evaluate again the traversal of the model.
+         */
+        struct BaseKinematics
+        {
+            iDynTree::Transform frameToLinkTransform; /**< Transformation between the base frame and its link. */
+            iDynTree::KinDynComputations kinDyn; /**< KinDynComputations solver (measured state). */
+            iDynTree::KinDynComputations kinDynDesired; /**< KinDynComputations solver (desired state). */
+        };
+
+        /**
+         * State of the kinematics generated for the robot model (see GeneratedKinematics.h).
+         */
+        struct GeneratedKinematicsState;
+
+        iDynTree::Model m_model; /**< Model of the robot. */
+        std::shared_ptr<const KinematicsModel> m_kinematicsModel; /**< Model shared with the workspaces (the base is the root frame). */
+        std::array<std::unique_ptr<BaseKinematics>, NumberOfBaseFrames> m_baseKinematics; /**< Kinematics of the registered base frames. */
+        BaseFrame m_activeBase; /**< Base frame currently used. */
 
         bool m_useExternalRobotBase; /**< is external estimator for the base of robot used? */
+        bool m_useLegOdometry; /**< is the base estimated with the leg odometry? */
+        double m_legOdometryContactThreshold; /**< Minimum normal force of a foot in contact (N). */
+        double m_legOdometrySwitchMargin; /**< Margin between the normal forces of the feet required to switch the stance foot (N). */
         iDynTree::FreeFloatingGeneralizedTorques m_generalizedBiasForces;
 
         bool m_prevContactLeft; /**< Boolean is the previous contact foot the left one? */
         bool m_dcmEvaluated; /**< is the DCM evaluated? */
         bool m_comEvaluated; /**< is the CoM evaluated? */
 
-        iDynTree::FrameIndex m_frameBaseIndex;
         iDynTree::FrameIndex m_frameLeftIndex; /**< Index of the frame attached to the left foot in which all the left foot transformations are expressed. */
         iDynTree::FrameIndex m_frameRightIndex; /**< Index of the frame attached to the right foot in which all the right foot transformations are expressed. */
         iDynTree::FrameIndex m_frameRootIndex; /**< Index of the frame attached to the root_link. */
@@ -47,13 +113,16 @@ namespace WalkingControllers
         iDynTree::FrameIndex m_frameRightHandIndex; /**< Index of the frame attached to the right hand. */
         iDynTree::FrameIndex m_frameHeadIndex; /**< Index of the frame attached to the head. */
 
+        std::array<iDynTree::FrameIndex, NumberOfCachedFrames> m_cachedFrameIndices; /**< Indices of the cached frames. */
+        FrameTransformsCache m_transformsCache; /**< Cached transformations (measured state). */
+        FrameTransformsCache m_desiredTransformsCache; /**< Cached transformations (desired state). */
+
         std::string m_baseFrameLeft; /**< Name of the left base frame. */
         std::string m_baseFrameRight;  /**< Name of the right base frame. */
 
         iDynTree::Transform m_frameHlinkLeft; /**< Transformation between the l_sole and the l_foot frame (l_ankle_2?!). */
         iDynTree::Transform m_frameHlinkRight; /**< Transformation between the l_sole and the l_foot frame (l_ankle_2?!). */
         iDynTree::Transform m_worldToBaseTransform; /**< World to base transformation. */
-        std::unordered_map<std::string, std::pair<const std::string, const iDynTree::Transform>> m_baseFrames;/**< Transform related to the base frame */
         iDynTree::Twist m_baseTwist;/**< twist related to base frame */
 
         iDynTree::Position m_comPosition; /**< Position of the CoM. */
@@ -61,8 +130,9 @@ namespace WalkingControllers
         iDynTree::Vector2 m_dcm; /**< DCM position. */
         double m_omega; /**< Inverted time constant of the 3D-LIPM. */
 
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_comPositionFilter; /**< CoM position low pass filter. */
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_comVelocityFilter; /**< CoM velocity low pass filter. */
+        FirstOrderLowPassFilterBank m_filters; /**< Low pass filters of the CoM position and velocity. */
+        std::size_t m_comPositionSignal; /**< Index of the CoM position in the filter bank. */
+        std::size_t m_comVelocitySignal; /**< Index of the CoM velocity in the filter bank. */
         iDynTree::Position m_comPositionFiltered; /**< Filtered position of the CoM. */
         iDynTree::Vector3 m_comVelocityFiltered; /**< Filtered velocity of the CoM. */
         bool m_useFilters; /**< If it is true the filters will be used. */
@@ -70,6 +140,14 @@ namespace WalkingControllers
         bool m_firstStep; /**< True only during the first step. */
 
         iDynTree::VectorDynSize m_jointPositions; /**< joint positions in radians. */
+        iDynTree::VectorDynSize m_desiredJointPositions; /**< desired joint positions in radians. */
+        iDynTree::Position m_desiredCoMPosition; /**< Position of the CoM (desired state). */
+
+        bool m_useGeneratedKinematics; /**< If it is true the generated kinematics is used instead of KinDynComputations. */
+        std::unique_ptr<GeneratedKinematicsState> m_generatedKinematics; /**< Generated kinematics (measured state). */
+        std::unique_ptr<GeneratedKinematicsState> m_desiredGeneratedKinematics; /**< Generated kinematics (desired state). */
+        iDynTree::MatrixDynSize m_jacobianBuffer; /**< Buffer used to evaluate the frames velocities. */
+        iDynTree::MatrixDynSize m_comJacobianBuffer; /**< Buffer used to evaluate the predicted CoM. */
 
         /**
          * Set the model of the robot.
@@ -89,12 +167,55 @@ namespace WalkingControllers
         bool setBaseFrames(const std::string& lFootFrame, const std::string& rFootFrame);
 
         /**
-         * Set The base frames for enabling using Gazebo as a base estimator.
+         * Register a candidate base frame. The link to which the frame is attached is used as
+         * floating base of the measured and desired kinematics associated to the frame.
          * @param baseFrame the frame name inside model;
-         * @param name label for storing the frame information;
+         * @param base label of the base frame;
+         * @return true/false in case of success/failure.
+         */
+        bool setBaseFrame(const std::string& baseFrame, const BaseFrame& base);
+
+        /**
+         * Get the KinDynComputations object associated to a state.
+         * @param state measured or desired state.
+         * @return the KinDynComputations object.
+         */
+        iDynTree::KinDynComputations& getKinDyn(const KinematicsState& state);
+
+        /**
+         * Get the world transformation of a cached frame. The transformations of all the cached
+         * frames are evaluated the first time this method is called after the state is updated.
+         * @param frame the cached frame;
+         * @param state measured or desired state.
+         * @return world_H_frame.
+         */
+        const iDynTree::Transform& getCachedWorldTransform(const CachedFrame& frame,
+                                                           const KinematicsState& state);
+
+        /**
+         * Get the free floating Jacobian (mixed representation) of a cached frame.
+         * @param frame the cached frame;
+         * @param jacobian the Jacobian matrix;
+         * @param state measured or desired state.
+         * @return true/false in case of success/failure.
+         */
+        bool getFrameJacobian(const CachedFrame& frame, iDynTree::MatrixDynSize& jacobian,
+                              const KinematicsState& state);
+
+        /**
+         * Initialize the generated kinematics and compare it with KinDynComputations.
+         * @param config config of the FK solver.
          * @return true/false in case of success/failure.
          */
-        bool setBaseFrame(const std::string& baseFrame, const std::string& name);
+        bool initializeGeneratedKinematics(const yarp::os::Searchable& config);
+
+        /**
+         * Get the generated kinematics associated to a state. The kinematics is evaluated the
+         * first time this method is called after the state or the base is changed.
+         * @param state measured or desired state.
+         * @return the generated kinematics.
+         */
+        const GeneratedKinematicsState& getGeneratedKinematics(const KinematicsState& state);
 
         /**
          * Evaluate the Divergent component of motion.
@@ -108,6 +229,11 @@ namespace WalkingControllers
 
     public:
 
+        /**
+         * Destructor.
+         */
+        ~WalkingFK();
+
         /**
          * Initialize the walking FK solver.
          * @param config config of the FK solver;
@@ -139,6 +265,30 @@ namespace WalkingControllers
                                                const iDynTree::Transform& rightFootTransform,
                                                const bool& isLeftFixedFrame);
 
+        /**
+         * Update the world to base transformation with the leg odometry. The stance foot is the one
+         * measured by the force torque sensors: the base switches to the other foot only if its normal
+         * force is greater than the threshold and than the normal force of the stance foot plus a
+         * margin (hysteresis). When the base switches, the pose of the new stance foot is the one
+         * given by the measured kinematics, otherwise the stance foot is considered fixed and nothing
+         * is evaluated.
+         * @note evaluateWorldToBaseTransformation() has to be called before: during the first step it
+         * sets the initial pose of the stance foot. The measured joints of the current tick have to
+         * be set with setInternalRobotState() before calling this function, and set again after it
+         * only if the base switches.
+         * @param leftWrench wrench measured by the left foot sensor;
+         * @param rightWrench wrench measured by the right foot sensor;
+         * @param isBaseSwitched true if the world to base transformation changed.
+         * @return true/false in case of success/failure.
+         */
+        bool updateLegOdometry(const iDynTree::Wrench& leftWrench, const iDynTree::Wrench& rightWrench,
+                               bool& isBaseSwitched);
+
+        /**
+         * Return true if the base is estimated with the leg odometry.
+         */
+        bool isLegOdometryUsed() const;
+
         /**
          * Set the base for the onTheFly feature
          * @return true/false in case of success/failure.
@@ -153,11 +303,23 @@ namespace WalkingControllers
         bool setInternalRobotState(const iDynTree::VectorDynSize& positionFeedbackInRadians,
                                    const iDynTree::VectorDynSize& velocityFeedbackInRadians);
 
+        /**
+         * Set the desired state of the robot (joint position and velocity). The desired state is
+         * stored in a separate KinDynComputations object, hence the quantities evaluated with the
+         * measured state are not invalidated.
+         * @param desiredPositionInRadians desired joint position expressed in radians;
+         * @param desiredVelocityInRadians desired joint velocity expressed in radians per seconds.
+         * @return true/false in case of success/failure.
+         */
+        bool setDesiredRobotState(const iDynTree::VectorDynSize& desiredPositionInRadians,
+                                  const iDynTree::VectorDynSize& desiredVelocityInRadians);
+
         /**
          * Get the CoM position.
+         * @param state measured or desired state. The filters are applied only to the measured CoM.
          * @return CoM position
          */
-        const iDynTree::Position& getCoMPosition();
+        const iDynTree::Position& getCoMPosition(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the CoM velocity.
@@ -171,41 +333,74 @@ namespace WalkingControllers
          */
         const iDynTree::Vector2& getDCM();
 
+        /**
+         * Predict the CoM position and velocity after a time step for a candidate joint velocity.
+         * The first-order approximation x + J * nu * dt is used, where J is the CoM Jacobian and nu
+         * contains the base twist and the joint velocities. The robot state is not updated.
+         * @param jointVelocities candidate joint velocities expressed in radians per seconds;
+         * @param dt time step in seconds;
+         * @param comPosition predicted CoM position;
+         * @param comVelocity predicted CoM velocity (i.e. J * nu);
+         * @param state measured or desired state.
+         * @return true/false in case of success/failure.
+         */
+        bool getPredictedCoM(const iDynTree::VectorDynSize& jointVelocities, const double& dt,
+                             iDynTree::Position& comPosition, iDynTree::Vector3& comVelocity,
+                             const KinematicsState& state = KinematicsState::Measured);
+
+        /**
+         * Predict the 2d-Divergent component of motion after a time step for a candidate joint
+         * velocity. The predicted CoM position and velocity are evaluated with getPredictedCoM().
+         * @param jointVelocities candidate joint velocities expressed in radians per seconds;
+         * @param dt time step in seconds;
+         * @param dcm predicted 2d-Divergent component of motion;
+         * @param state measured or desired state.
+         * @return true/false in case of success/failure.
+         */
+        bool getPredictedDCM(const iDynTree::VectorDynSize& jointVelocities, const double& dt,
+                             iDynTree::Vector2& dcm, const KinematicsState& state = KinematicsState::Measured);
+
         /**
          * Return the transformation between the left foot frame (l_sole) and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_left_frame.
          */
-        iDynTree::Transform getLeftFootToWorldTransform();
+        const iDynTree::Transform& getLeftFootToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the transformation between the right foot frame (r_sole) and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_right_frame.
          */
-        iDynTree::Transform getRightFootToWorldTransform();
+        const iDynTree::Transform& getRightFootToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the transformation between the left hand frame and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_left_hand.
          */
-        iDynTree::Transform getLeftHandToWorldTransform();
+        const iDynTree::Transform& getLeftHandToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the transformation between the right hand frame and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_right_hand.
          */
-        iDynTree::Transform getRightHandToWorldTransform();
+        const iDynTree::Transform& getRightHandToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the transformation between the head frame and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_head.
          */
-        iDynTree::Transform getHeadToWorldTransform();
+        const iDynTree::Transform& getHeadToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the transformation between the root frame and the world reference frame.
+         * @param state measured or desired state.
          * @return world_H_root_frame.
          */
-        iDynTree::Transform getRootLinkToWorldTransform();
+        const iDynTree::Transform& getRootLinkToWorldTransform(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Return the root link velocity.
@@ -215,57 +410,78 @@ namespace WalkingControllers
 
         /**
          * Return the neck orientation.
+         * @param state measured or desired state.
          * @return the rotation matrix between the neck and the reference frame.
          */
-        iDynTree::Rotation getNeckOrientation();
+        const iDynTree::Rotation& getNeckOrientation(const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the left foot jacobian.
          * @oaram jacobian is the left foot jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getLeftFootJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getLeftFootJacobian(iDynTree::MatrixDynSize &jacobian,
+                                 const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the right foot jacobian.
          * @oaram jacobian is the right foot jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getRightFootJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getRightFootJacobian(iDynTree::MatrixDynSize &jacobian,
+                                  const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the left hand jacobian.
          * @oaram jacobian is the left hand jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getLeftHandJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getLeftHandJacobian(iDynTree::MatrixDynSize &jacobian,
+                                 const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the right hand jacobian.
          * @oaram jacobian is the right hand jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getRightHandJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getRightHandJacobian(iDynTree::MatrixDynSize &jacobian,
+                                  const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the neck jacobian.
          * @oaram jacobian is the neck jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getNeckJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getNeckJacobian(iDynTree::MatrixDynSize &jacobian,
+                             const KinematicsState& state = KinematicsState::Measured);
 
         /**
          * Get the CoM jacobian.
          * @oaram jacobian is the CoM jacobian matrix
+         * @param state measured or desired state.
          * @return true/false in case of success/failure.
          */
-        bool getCoMJacobian(iDynTree::MatrixDynSize &jacobian);
+        bool getCoMJacobian(iDynTree::MatrixDynSize &jacobian,
+                            const KinematicsState& state = KinematicsState::Measured);
+
+        /**
+         * Get the model used to evaluate hypothetical configurations with KinematicsWorkspace or
+         * KinematicsBatch. The base frame of the configurations is the root frame.
+         * @return the shared model.
+         */
+        std::shared_ptr<const KinematicsModel> getKinematicsModel() const;
 
         /**
          * Get the joint position
+         * @param state measured or desired state.
          * @return the joint position expressed in radians
          */
-        const iDynTree::VectorDynSize& getJointPos();
+        const iDynTree::VectorDynSize& getJointPos(const KinematicsState& state = KinematicsState::Measured);
     };
 };
 #endif
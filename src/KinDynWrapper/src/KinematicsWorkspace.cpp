@@ -0,0 +1,330 @@
+/**
+ * @file KinematicsWorkspace.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// YARP
+#include <yarp/os/LogStream.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Model/ForwardKinematics.h>
+
+#include <WalkingControllers/KinDynWrapper/KinematicsWorkspace.h>
+
+using namespace WalkingControllers;
+
+bool WalkingControllers::createKinematicsModel(const iDynTree::Model& model, const std::string& baseFrame,
+                                               std::shared_ptr<const KinematicsModel>& kinematicsModel)
+{
+    auto newModel = std::make_shared<KinematicsModel>();
+
+    // the traversal stores pointers to the links, so it is evaluated on the stored model
+    newModel->model = model;
+    iDynTree::FrameIndex baseFrameIndex = newModel->model.getFrameIndex(baseFrame);
+    if(baseFrameIndex == iDynTree::FRAME_INVALID_INDEX)
+    {
+        yError() << "[createKinematicsModel] Unable to find the frame named: " << baseFrame;
+        return false;
+    }
+
+    newModel->baseLink = newModel->model.getFrameLink(baseFrameIndex);
+    newModel->baseFrameToLinkTransform = newModel->model.getFrameTransform(baseFrameIndex).inverse();
+    if(!newModel->model.computeFullTreeTraversal(newModel->traversal, newModel->baseLink))
+    {
+        yError() << "[createKinematicsModel] Unable to compute the traversal of the model.";
+        return false;
+    }
+
+    newModel->totalMass = 0;
+    for(iDynTree::LinkIndex link = 0; link < newModel->model.getNrOfLinks(); link++)
+    {
+        const iDynTree::SpatialInertia& inertia = newModel->model.getLink(link)->getInertia();
+        newModel->linkMasses.push_back(inertia.getMass());
+        newModel->linkCoMs.push_back(inertia.getCenterOfMass());
+        newModel->totalMass += inertia.getMass();
+    }
+
+    if(newModel->totalMass <= 0)
+    {
+        yError() << "[createKinematicsModel] The mass of the model is not positive.";
+        return false;
+    }
+
+    kinematicsModel = newModel;
+    return true;
+}
+
+bool KinematicsWorkspace::initialize(std::shared_ptr<const KinematicsModel> kinematicsModel)
+{
+    if(kinematicsModel == nullptr)
+    {
+        yError() << "[KinematicsWorkspace::initialize] The model is not valid.";
+        return false;
+    }
+
+    m_kinematicsModel = kinematicsModel;
+    m_jointPositions.resize(m_kinematicsModel->model.getNrOfPosCoords());
+    m_jointPositions.zero();
+    m_linkPositions.resize(m_kinematicsModel->model);
+    m_isEvaluated = false;
+
+    return true;
+}
+
+bool KinematicsWorkspace::setConfiguration(const iDynTree::Transform& worldToBaseTransform,
+                                           const iDynTree::VectorDynSize& jointPositions)
+{
+    if(m_kinematicsModel == nullptr)
+    {
+        yError() << "[KinematicsWorkspace::setConfiguration] The workspace is not initialized.";
+        return false;
+    }
+
+    if(jointPositions.size() != m_jointPositions.size())
+    {
+        yError() << "[KinematicsWorkspace::setConfiguration] The size of the joint positions vector is"
+                 << jointPositions.size() << "while the model has" << m_jointPositions.size() << "joints.";
+        return false;
+    }
+
+    m_isEvaluated = false;
+    m_jointPositions = jointPositions;
+    m_worldToBaseLinkTransform = worldToBaseTransform * m_kinematicsModel->baseFrameToLinkTransform;
+
+    if(!iDynTree::ForwardPositionKinematics(m_kinematicsModel->model, m_kinematicsModel->traversal,
+                                            m_worldToBaseLinkTransform, m_jointPositions, m_linkPositions))
+    {
+        yError() << "[KinematicsWorkspace::setConfiguration] Unable to evaluate the forward kinematics.";
+        return false;
+    }
+
+    // the CoM is evaluated here, so the workspace can be read concurrently
+    iDynTree::Vector3 firstMoment;
+    firstMoment.zero();
+    for(iDynTree::LinkIndex link = 0; link < m_kinematicsModel->model.getNrOfLinks(); link++)
+    {
+        iDynTree::Position linkCoM = m_linkPositions(link) * m_kinematicsModel->linkCoMs[link];
+        iDynTree::toEigen(firstMoment) += m_kinematicsModel->linkMasses[link] * iDynTree::toEigen(linkCoM);
+    }
+    iDynTree::toEigen(m_comPosition) = iDynTree::toEigen(firstMoment) / m_kinematicsModel->totalMass;
+
+    m_isEvaluated = true;
+    return true;
+}
+
+bool KinematicsWorkspace::setConfiguration(const KinematicsConfiguration& configuration)
+{
+    return setConfiguration(configuration.worldToBaseTransform, configuration.jointPositions);
+}
+
+bool KinematicsWorkspace::getWorldTransform(const iDynTree::FrameIndex& frame,
+                                            iDynTree::Transform& transform) const
+{
+    if(!m_isEvaluated)
+    {
+        yError() << "[KinematicsWorkspace::getWorldTransform] The configuration is not evaluated.";
+        return false;
+    }
+
+    const iDynTree::Model& model = m_kinematicsModel->model;
+    if(!model.isValidFrameIndex(frame))
+    {
+        yError() << "[KinematicsWorkspace::getWorldTransform] The frame index is not valid.";
+        return false;
+    }
+
+    transform = m_linkPositions(model.getFrameLink(frame)) * model.getFrameTransform(frame);
+    return true;
+}
+
+bool KinematicsWorkspace::getFrameFreeFloatingJacobian(const iDynTree::FrameIndex& frame,
+                                                       iDynTree::MatrixDynSize& jacobian) const
+{
+    if(!m_isEvaluated)
+    {
+        yError() << "[KinematicsWorkspace::getFrameFreeFloatingJacobian] The configuration is not evaluated.";
+        return false;
+    }
+
+    const iDynTree::Model& model = m_kinematicsModel->model;
+    const iDynTree::Traversal& traversal = m_kinematicsModel->traversal;
+    iDynTree::Transform frameTransform;
+    if(!getWorldTransform(frame, frameTransform))
+    {
+        yError() << "[KinematicsWorkspace::getFrameFreeFloatingJacobian] Unable to get the transform of the frame.";
+        return false;
+    }
+
+    Eigen::Vector3d framePosition = iDynTree::toEigen(frameTransform.getPosition());
+    Eigen::Vector3d basePosition = iDynTree::toEigen(m_worldToBaseLinkTransform.getPosition());
+
+    jacobian.resize(6, model.getNrOfDOFs() + 6);
+    auto jacobianEigen = iDynTree::toEigen(jacobian);
+    jacobianEigen.setZero();
+    jacobianEigen.leftCols<6>().setIdentity();
+    jacobianEigen.block<3, 3>(0, 3) = -iDynTree::skew(framePosition - basePosition);
+
+    // only the joints between the frame and the floating base move the frame
+    for(iDynTree::LinkIndex link = model.getFrameLink(frame); link != m_kinematicsModel->baseLink;
+        link = traversal.getParentLinkFromLinkIndex(link)->getIndex())
+    {
+        iDynTree::IJointConstPtr joint = traversal.getParentJointFromLinkIndex(link);
+        iDynTree::LinkIndex parent = traversal.getParentLinkFromLinkIndex(link)->getIndex();
+        const iDynTree::Transform& linkTransform = m_linkPositions(link);
+        Eigen::Matrix3d linkRotation = iDynTree::toEigen(linkTransform.getRotation());
+        Eigen::Vector3d linkPosition = iDynTree::toEigen(linkTransform.getPosition());
+
+        for(unsigned int dof = 0; dof < joint->getNrOfDOFs(); dof++)
+        {
+            // motion subspace of the joint (i.e. twist of the link) expressed in the world frame
+            iDynTree::SpatialMotionVector motionSubspace = joint->getMotionSubspaceVector(dof, link, parent);
+            Eigen::Vector3d axis = linkRotation * iDynTree::toEigen(motionSubspace.getAngularVec3());
+            Eigen::Vector3d linearVelocity = linkRotation * iDynTree::toEigen(motionSubspace.getLinearVec3());
+
+            // velocity of the link frame origin and angular velocity, the point is then moved to the frame
+            std::size_t column = joint->getDOFsOffset() + dof + 6;
+            jacobianEigen.block<3, 1>(0, column) = linearVelocity + axis.cross(framePosition - linkPosition);
+            jacobianEigen.block<3, 1>(3, column) = axis;
+        }
+    }
+
+    return true;
+}
+
+const iDynTree::Position& KinematicsWorkspace::getCoMPosition() const
+{
+    return m_comPosition;
+}
+
+const KinematicsModel& KinematicsWorkspace::getKinematicsModel() const
+{
+    return *m_kinematicsModel;
+}
+
+KinematicsBatch::~KinematicsBatch()
+{
+    close();
+}
+
+bool KinematicsBatch::initialize(std::shared_ptr<const KinematicsModel> kinematicsModel,
+                                 const std::size_t& capacity, const std::size_t& numberOfThreads)
+{
+    if(!m_workers.empty())
+    {
+        yError() << "[KinematicsBatch::initialize] The batch is already initialized.";
+        return false;
+    }
+
+    if(capacity == 0 || numberOfThreads == 0)
+    {
+        yError() << "[KinematicsBatch::initialize] The capacity and the number of threads have to be positive.";
+        return false;
+    }
+
+    // the workspaces are allocated once
+    m_workspaces = std::vector<KinematicsWorkspace>(capacity);
+    for(auto& workspace : m_workspaces)
+        if(!workspace.initialize(kinematicsModel))
+        {
+            yError() << "[KinematicsBatch::initialize] Unable to initialize a workspace.";
+            m_workspaces.clear();
+            return false;
+        }
+    m_isEvaluated = std::vector<bool>(capacity, false);
+
+    m_isClosing = false;
+    m_numberOfConfigurations = 0;
+    m_nextConfiguration = 0;
+    m_evaluatedConfigurations = 0;
+    for(std::size_t i = 0; i < numberOfThreads; i++)
+        m_workers.emplace_back(&KinematicsBatch::run, this);
+
+    return true;
+}
+
+void KinematicsBatch::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        m_startCondition.wait(lock, [&]{return m_isClosing
+                    || m_nextConfiguration < m_numberOfConfigurations;});
+        if(m_isClosing)
+            return;
+
+        // each configuration is evaluated by one thread only
+        std::size_t configuration = m_nextConfiguration++;
+        lock.unlock();
+
+        bool ok = m_workspaces[configuration].setConfiguration((*m_configurations)[configuration]);
+
+        lock.lock();
+        m_isEvaluated[configuration] = ok;
+        m_evaluatedConfigurations++;
+        if(m_evaluatedConfigurations == m_numberOfConfigurations)
+            m_doneCondition.notify_all();
+    }
+}
+
+bool KinematicsBatch::evaluate(const std::vector<KinematicsConfiguration>& configurations)
+{
+    if(m_workers.empty())
+    {
+        yError() << "[KinematicsBatch::evaluate] The batch is not initialized.";
+        return false;
+    }
+
+    if(configurations.size() > m_workspaces.size())
+    {
+        yError() << "[KinematicsBatch::evaluate] The number of configurations is" << configurations.size()
+                 << "while the capacity of the batch is" << m_workspaces.size();
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_configurations = &configurations;
+    m_numberOfConfigurations = configurations.size();
+    m_nextConfiguration = 0;
+    m_evaluatedConfigurations = 0;
+    m_startCondition.notify_all();
+
+    m_doneCondition.wait(lock, [&]{return m_evaluatedConfigurations == m_numberOfConfigurations;});
+
+    // the workers are idle until the next batch
+    m_configurations = nullptr;
+    m_numberOfConfigurations = 0;
+    m_nextConfiguration = 0;
+
+    for(std::size_t i = 0; i < configurations.size(); i++)
+        if(!m_isEvaluated[i])
+        {
+            yError() << "[KinematicsBatch::evaluate] Unable to evaluate the configuration" << i;
+            return false;
+        }
+
+    return true;
+}
+
+const KinematicsWorkspace& KinematicsBatch::getWorkspace(const std::size_t& configuration) const
+{
+    return m_workspaces[configuration];
+}
+
+void KinematicsBatch::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isClosing = true;
+    }
+    m_startCondition.notify_all();
+
+    for(auto& worker : m_workers)
+        if(worker.joinable())
+            worker.join();
+
+    m_workers.clear();
+}
@@ -8,6 +8,7 @@
 
 // std
 #include <cmath>
+#include <random>
 
 // YARP
 #include <yarp/os/LogStream.h>
@@ -15,24 +16,36 @@
 
 // iDynTree
 #include <iDynTree/Core/EigenHelpers.h>
-#include <iDynTree/yarp/YARPConversions.h>
-#include <iDynTree/yarp/YARPEigenConversions.h>
 #include <iDynTree/Model/Model.h>
 
 #include <WalkingControllers/YarpUtilities/Helper.h>
 #include <WalkingControllers/KinDynWrapper/Wrapper.h>
+#include <WalkingControllers/KinDynWrapper/GeneratedKinematics.h>
 
 using namespace WalkingControllers;
 
+struct WalkingFK::GeneratedKinematicsState
+{
+    GeneratedKinematics::Data data; /**< Quantities expressed in the floating base link frame. */
+    Eigen::VectorXd jointPositions; /**< Joint positions in radians. */
+    Eigen::VectorXd jointVelocities; /**< Joint velocities in radians per second. */
+    BaseFrame base; /**< Floating base used to evaluate the quantities. */
+    bool isEvaluated{false}; /**< are the quantities evaluated? */
+};
+
+WalkingFK::~WalkingFK() = default;
+
 bool WalkingFK::setRobotModel(const iDynTree::Model& model)
 {
-    if(!m_kinDyn.loadRobotModel(model))
+    if(model.getNrOfLinks() == 0)
     {
-        yError() << "[WalkingFK::setRobotModel] Error while loading into KinDynComputations object.";
+        yError() << "[WalkingFK::setRobotModel] The model is empty.";
         return false;
     }
 
-    m_kinDyn.setFrameVelocityRepresentation(iDynTree::MIXED_REPRESENTATION);
+    m_model = model;
+    for(auto& baseKinematics : m_baseKinematics)
+        baseKinematics.reset();
 
     // initialize some quantities needed for the first step
     m_prevContactLeft = false;
@@ -40,11 +53,11 @@ bool WalkingFK::setRobotModel(const iDynTree::Model& model)
     return true;
 }
 
-bool WalkingFK::setBaseFrame(const std::string& baseFrame, const std::string& name)
+bool WalkingFK::setBaseFrame(const std::string& baseFrame, const BaseFrame& base)
 {
-    if(!m_kinDyn.isValid())
+    if(m_model.getNrOfLinks() == 0)
     {
-        yError() << "[WalkingFK::setBaseFrames] Please set the Robot model before calling this method.";
+        yError() << "[WalkingFK::setBaseFrame] Please set the Robot model before calling this method.";
         return false;
     }
 
@@ -53,18 +66,125 @@ bool WalkingFK::setBaseFrame(const std::string& baseFrame, const std::string& na
     // - left_foot when the left foot is the stance foot;
     // - right_foot when the right foot is the stance foot.
     //.-.root when the external base supposed to be used
-    m_frameBaseIndex = m_kinDyn.model().getFrameIndex(baseFrame);
-    if(m_frameBaseIndex == iDynTree::FRAME_INVALID_INDEX)
+    iDynTree::FrameIndex frameBaseIndex = m_model.getFrameIndex(baseFrame);
+    if(frameBaseIndex == iDynTree::FRAME_INVALID_INDEX)
     {
-        yError() << "[setBaseFrames] Unable to find the frame named: " << baseFrame;
+        yError() << "[WalkingFK::setBaseFrame] Unable to find the frame named: " << baseFrame;
         return false;
     }
-    iDynTree::LinkIndex linkBaseIndex = m_kinDyn.model().getFrameLink(m_frameBaseIndex);
+    iDynTree::LinkIndex linkBaseIndex = m_model.getFrameLink(frameBaseIndex);
+    std::string linkBaseName = m_model.getLinkName(linkBaseIndex);
+
+    auto baseKinematics = std::make_unique<BaseKinematics>();
+    baseKinematics->frameToLinkTransform = m_model.getFrameTransform(frameBaseIndex).inverse();
+
+    // the desired state is stored in a different object so that the quantities evaluated with
+    // the measured state are not invalidated
+    for(auto kinDyn : {&baseKinematics->kinDyn, &baseKinematics->kinDynDesired})
+    {
+        if(!kinDyn->loadRobotModel(m_model))
+        {
+            yError() << "[WalkingFK::setBaseFrame] Error while loading into KinDynComputations object.";
+            return false;
+        }
+
+        kinDyn->setFrameVelocityRepresentation(iDynTree::MIXED_REPRESENTATION);
+
+        if(!kinDyn->setFloatingBase(linkBaseName))
+        {
+            yError() << "[WalkingFK::setBaseFrame] Error while setting the floating base on link "
+                     << linkBaseName;
+            return false;
+        }
+    }
+
+    m_baseKinematics[base] = std::move(baseKinematics);
+    return true;
+}
+
+iDynTree::KinDynComputations& WalkingFK::getKinDyn(const KinematicsState& state)
+{
+    if(state == KinematicsState::Desired)
+        return m_baseKinematics[m_activeBase]->kinDynDesired;
+
+    return m_baseKinematics[m_activeBase]->kinDyn;
+}
+
+std::shared_ptr<const KinematicsModel> WalkingFK::getKinematicsModel() const
+{
+    return m_kinematicsModel;
+}
+
+const iDynTree::Transform& WalkingFK::getCachedWorldTransform(const CachedFrame& frame,
+                                                             const KinematicsState& state)
+{
+    FrameTransformsCache& cache = state == KinematicsState::Desired ?
+        m_desiredTransformsCache : m_transformsCache;
+
+    if(!cache.isEvaluated)
+    {
+        if(m_useGeneratedKinematics)
+        {
+            const GeneratedKinematics::Data& data = getGeneratedKinematics(state).data;
+            iDynTree::Rotation rotation;
+            iDynTree::Position position;
+            for(std::size_t i = 0; i < NumberOfCachedFrames; i++)
+            {
+                iDynTree::toEigen(rotation) = data.rotations[i];
+                iDynTree::toEigen(position) = data.positions[i];
+                cache.worldTransforms[i] = m_worldToBaseTransform * iDynTree::Transform(rotation, position);
+            }
+        }
+        else
+        {
+            iDynTree::KinDynComputations& kinDyn = getKinDyn(state);
+            for(std::size_t i = 0; i < NumberOfCachedFrames; i++)
+                cache.worldTransforms[i] = kinDyn.getWorldTransform(m_cachedFrameIndices[i]);
+        }
+
+        cache.isEvaluated = true;
+    }
+
+    return cache.worldTransforms[frame];
+}
+
+const WalkingFK::GeneratedKinematicsState& WalkingFK::getGeneratedKinematics(const KinematicsState& state)
+{
+    GeneratedKinematicsState& generatedKinematics = state == KinematicsState::Desired ?
+        *m_desiredGeneratedKinematics : *m_generatedKinematics;
+
+    if(!generatedKinematics.isEvaluated || generatedKinematics.base != m_activeBase)
+    {
+#ifdef WALKING_CONTROLLERS_USE_GENERATED_KINEMATICS
+        GeneratedKinematics::computeKinematics(static_cast<GeneratedKinematics::Base>(m_activeBase),
+                                               generatedKinematics.jointPositions,
+                                               generatedKinematics.data);
+#endif
+        generatedKinematics.base = m_activeBase;
+        generatedKinematics.isEvaluated = true;
+    }
 
-    std::string baseFrameName = m_kinDyn.model().getLinkName(linkBaseIndex);
-    m_baseFrames.insert({name, std::make_pair(baseFrameName,
-                                              m_kinDyn.getRelativeTransform(m_frameBaseIndex,
-                                                                            linkBaseIndex))});
+    return generatedKinematics;
+}
+
+bool WalkingFK::getFrameJacobian(const CachedFrame& frame, iDynTree::MatrixDynSize& jacobian,
+                                 const KinematicsState& state)
+{
+    if(!m_useGeneratedKinematics)
+        return getKinDyn(state).getFrameFreeFloatingJacobian(m_cachedFrameIndices[frame], jacobian);
+
+    // the generated quantities are expressed in the base frame. The base velocity is expressed
+    // with the mixed representation
+    const GeneratedKinematics::Data& data = getGeneratedKinematics(state).data;
+    Eigen::Matrix3d worldToBaseRotation = iDynTree::toEigen(m_worldToBaseTransform.getRotation());
+    std::size_t numberOfJoints = data.comJacobian.cols();
+
+    jacobian.resize(6, numberOfJoints + 6);
+    auto jacobianEigen = iDynTree::toEigen(jacobian);
+    jacobianEigen.leftCols<6>().setIdentity();
+    jacobianEigen.block<3, 3>(0, 3) = -iDynTree::skew(worldToBaseRotation * data.positions[frame]);
+    jacobianEigen.block(0, 6, 3, numberOfJoints) = worldToBaseRotation * data.jacobians[frame].topRows<3>();
+    jacobianEigen.block(3, 6, 3, numberOfJoints) = worldToBaseRotation * data.jacobians[frame].bottomRows<3>();
 
     return true;
 }
@@ -101,7 +221,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         return false;
     }
 
-    m_frameLeftIndex = m_kinDyn.model().getFrameIndex(lFootFrame);
+    m_frameLeftIndex = m_model.getFrameIndex(lFootFrame);
     if(m_frameLeftIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << lFootFrame;
@@ -110,7 +230,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
 
 
     // set base frames
-    m_frameRightIndex = m_kinDyn.model().getFrameIndex(rFootFrame);
+    m_frameRightIndex = m_model.getFrameIndex(rFootFrame);
     if(m_frameRightIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << rFootFrame;
@@ -124,7 +244,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         yError() << "[WalkingFK::initialize] Unable to get the string from searchable.";
         return false;
     }
-    m_frameLeftHandIndex = m_kinDyn.model().getFrameIndex(lHandFrame);
+    m_frameLeftHandIndex = m_model.getFrameIndex(lHandFrame);
     if(m_frameLeftHandIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << lHandFrame;
@@ -138,7 +258,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         yError() << "[WalkingFK::initialize] Unable to get the string from searchable.";
         return false;
     }
-    m_frameRightHandIndex = m_kinDyn.model().getFrameIndex(rHandFrame);
+    m_frameRightHandIndex = m_model.getFrameIndex(rHandFrame);
     if(m_frameRightHandIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << rHandFrame;
@@ -151,7 +271,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         yError() << "[WalkingFK::initialize] Unable to get the string from searchable.";
         return false;
     }
-    m_frameHeadIndex = m_kinDyn.model().getFrameIndex(headFrame);
+    m_frameHeadIndex = m_model.getFrameIndex(headFrame);
     if(m_frameHeadIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << headFrame;
@@ -164,7 +284,7 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         yError() << "[WalkingFK::initialize] Unable to get the string from searchable.";
         return false;
     }
-    m_frameRootIndex = m_kinDyn.model().getFrameIndex(rootFrame);
+    m_frameRootIndex = m_model.getFrameIndex(rootFrame);
     if(m_frameRootIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << rootFrame;
@@ -177,28 +297,53 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
         yError() << "[WalkingFK::initialize] Unable to get the string from searchable.";
         return false;
     }
-    m_frameNeckIndex = m_kinDyn.model().getFrameIndex(torsoFrame);
+    m_frameNeckIndex = m_model.getFrameIndex(torsoFrame);
     if(m_frameNeckIndex == iDynTree::FRAME_INVALID_INDEX)
     {
         yError() << "[WalkingFK::initialize] Unable to find the frame named: " << torsoFrame;
         return false;
     }
 
+    m_cachedFrameIndices[LeftFoot] = m_frameLeftIndex;
+    m_cachedFrameIndices[RightFoot] = m_frameRightIndex;
+    m_cachedFrameIndices[LeftHand] = m_frameLeftHandIndex;
+    m_cachedFrameIndices[RightHand] = m_frameRightHandIndex;
+    m_cachedFrameIndices[Head] = m_frameHeadIndex;
+    m_cachedFrameIndices[Root] = m_frameRootIndex;
+    m_cachedFrameIndices[Neck] = m_frameNeckIndex;
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
+
     m_useExternalRobotBase = config.check("use_external_robot_base", yarp::os::Value("False")).asBool();
 
+    m_useLegOdometry = config.check("use_leg_odometry", yarp::os::Value(false)).asBool();
+    m_legOdometryContactThreshold = config.check("leg_odometry_contact_threshold", yarp::os::Value(100.0)).asDouble();
+    m_legOdometrySwitchMargin = config.check("leg_odometry_switch_margin", yarp::os::Value(20.0)).asDouble();
+    if(m_legOdometrySwitchMargin < 0)
+    {
+        yError() << "[WalkingFK::initialize] The switch margin of the leg odometry cannot be negative.";
+        return false;
+    }
+    if(m_useLegOdometry && m_useExternalRobotBase)
+    {
+        yError() << "[WalkingFK::initialize] The leg odometry cannot be used if the base is retrieved from external.";
+        return false;
+    }
+
     if(!m_useExternalRobotBase)
     {
-        if(!setBaseFrame(lFootFrame, "leftFoot"))
+        if(!setBaseFrame(lFootFrame, LeftFootBase))
         {
             yError() << "[initialize] Unable to set the leftFootFrame.";
             return false;
         }
 
-        if(!setBaseFrame(rFootFrame, "rightFoot"))
+        if(!setBaseFrame(rFootFrame, RightFootBase))
         {
             yError() << "[initialize] Unable to set the rightFootFrame.";
             return false;
         }
+        m_activeBase = LeftFootBase;
 
         // Since the base is attached to the stance foot its velocity is always equal to zero
         // (stable contact hypothesis)
@@ -206,18 +351,20 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
     }
     else
     {
-        if(!setBaseFrame(rootFrame, "root"))
-        {
-            yError() << "[initialize] Unable to set the rightFootFrame.";
-            return false;
-        }
-
         // in this specific case the base is always the root link
-        if(!m_kinDyn.setFloatingBase(m_baseFrames["root"].first))
+        if(!setBaseFrame(rootFrame, RootBase))
         {
-            yError() << "[initialize] Unable to set the floating base";
+            yError() << "[initialize] Unable to set the rootFrame.";
             return false;
         }
+        m_activeBase = RootBase;
+    }
+
+    // the model shared by the workspaces used to evaluate hypothetical configurations
+    if(!createKinematicsModel(m_model, rootFrame, m_kinematicsModel))
+    {
+        yError() << "[WalkingFK::initialize] Unable to create the kinematics model.";
+        return false;
     }
 
     double comHeight;
@@ -249,16 +396,17 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
     m_comPositionFiltered(2) = comHeight;
 
 
-    m_comPositionFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(cutFrequency, samplingTime);
-    m_comVelocityFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(cutFrequency, samplingTime);
+    m_filters.initialize(6);
+    if(!m_filters.addSignal(3, cutFrequency, samplingTime, m_comPositionSignal)
+       || !m_filters.addSignal(3, cutFrequency, samplingTime, m_comVelocitySignal))
+    {
+        yError() << "[WalkingFK::initialize] Unable to initialize the filters.";
+        return false;
+    }
 
     // TODO this is wrong, we shold initialize the filter with a meaningful value;
-    yarp::sig::Vector buff(3);
-    iDynTree::toYarp(m_comPositionFiltered, buff);
-    m_comPositionFilter->init(buff);
-
-    iDynTree::toYarp(m_comVelocityFiltered, buff);
-    m_comVelocityFilter->init(buff);
+    m_filters.reset(m_comPositionSignal, iDynTree::toEigen(m_comPositionFiltered));
+    m_filters.reset(m_comVelocitySignal, iDynTree::toEigen(m_comVelocityFiltered));
 
     m_useFilters = config.check("use_filters", yarp::os::Value(false)).asBool();
     m_firstStep = true;
@@ -266,9 +414,176 @@ bool WalkingFK::initialize(const yarp::os::Searchable& config,
 
     // resize the joint positions
     m_jointPositions.resize(model.getNrOfDOFs());
+    m_desiredJointPositions.resize(model.getNrOfDOFs());
+
+    m_useGeneratedKinematics = false;
+    if(config.check("use_generated_kinematics", yarp::os::Value(false)).asBool())
+    {
+        if(!initializeGeneratedKinematics(config))
+        {
+            yError() << "[WalkingFK::initialize] Unable to initialize the generated kinematics.";
+            return false;
+        }
+    }
+
     return true;
 }
 
+bool WalkingFK::initializeGeneratedKinematics(const yarp::os::Searchable& config)
+{
+#ifdef WALKING_CONTROLLERS_USE_GENERATED_KINEMATICS
+    // the generated kinematics has to be generated with the same model, joints and frames
+    std::size_t numberOfJoints = m_model.getNrOfDOFs();
+    if(GeneratedKinematics::getNumberOfJoints() != numberOfJoints)
+    {
+        yError() << "[WalkingFK::initializeGeneratedKinematics] The kinematics has been generated with"
+                 << GeneratedKinematics::getNumberOfJoints() << "joints while the model has"
+                 << numberOfJoints << "joints.";
+        return false;
+    }
+
+    for(iDynTree::JointIndex joint = 0; joint < m_model.getNrOfJoints(); joint++)
+    {
+        if(m_model.getJoint(joint)->getNrOfDOFs() != 1)
+            continue;
+
+        std::size_t dofOffset = m_model.getJoint(joint)->getDOFsOffset();
+        if(GeneratedKinematics::getJointsList()[dofOffset] != m_model.getJointName(joint))
+        {
+            yError() << "[WalkingFK::initializeGeneratedKinematics] The joint" << dofOffset << "is"
+                     << m_model.getJointName(joint) << "while the kinematics has been generated with"
+                     << GeneratedKinematics::getJointsList()[dofOffset];
+            return false;
+        }
+    }
+
+    for(std::size_t i = 0; i < NumberOfCachedFrames; i++)
+    {
+        if(GeneratedKinematics::getFramesList()[i] != m_model.getFrameName(m_cachedFrameIndices[i]))
+        {
+            yError() << "[WalkingFK::initializeGeneratedKinematics] The frame"
+                     << m_model.getFrameName(m_cachedFrameIndices[i])
+                     << "is different from the one used to generate the kinematics:"
+                     << GeneratedKinematics::getFramesList()[i];
+            return false;
+        }
+    }
+
+    m_generatedKinematics = std::make_unique<GeneratedKinematicsState>();
+    m_desiredGeneratedKinematics = std::make_unique<GeneratedKinematicsState>();
+    for(auto generatedKinematics : {m_generatedKinematics.get(), m_desiredGeneratedKinematics.get()})
+    {
+        generatedKinematics->data.resize(numberOfJoints);
+        generatedKinematics->jointPositions = Eigen::VectorXd::Zero(numberOfJoints);
+        generatedKinematics->jointVelocities = Eigen::VectorXd::Zero(numberOfJoints);
+    }
+    m_useGeneratedKinematics = true;
+
+    // the generated kinematics is compared with KinDynComputations on random configurations
+    double tolerance = config.check("generated_kinematics_tolerance", yarp::os::Value(1e-6)).asDouble();
+    std::mt19937 randomGenerator(0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    // evaluateCoM() feeds the CoM filters, their initial state is restored after the check
+    BaseFrame activeBase = m_activeBase;
+    iDynTree::Position comPositionFiltered = m_comPositionFiltered;
+    iDynTree::Vector3 comVelocityFiltered = m_comVelocityFiltered;
+    iDynTree::Vector3 gravity;
+    gravity.zero();
+    gravity(2) = -9.81;
+
+    iDynTree::VectorDynSize jointPositions(numberOfJoints), jointVelocities(numberOfJoints);
+    iDynTree::MatrixDynSize jacobian, expectedJacobian;
+    double maxError = 0;
+    for(std::size_t base = 0; base < NumberOfBaseFrames; base++)
+    {
+        if(m_baseKinematics[base] == nullptr)
+            continue;
+
+        m_activeBase = static_cast<BaseFrame>(base);
+        for(unsigned int i = 0; i < numberOfJoints; i++)
+        {
+            jointPositions(i) = distribution(randomGenerator);
+            jointVelocities(i) = distribution(randomGenerator);
+        }
+        m_worldToBaseTransform = iDynTree::Transform(iDynTree::Rotation::RPY(distribution(randomGenerator),
+                                                                             distribution(randomGenerator),
+                                                                             distribution(randomGenerator)),
+                                                     iDynTree::Position(distribution(randomGenerator),
+                                                                        distribution(randomGenerator),
+                                                                        distribution(randomGenerator)));
+        for(unsigned int i = 0; i < 6; i++)
+            m_baseTwist(i) = distribution(randomGenerator);
+
+        iDynTree::KinDynComputations& kinDyn = getKinDyn(KinematicsState::Measured);
+        if(!kinDyn.setRobotState(m_worldToBaseTransform, jointPositions, m_baseTwist, jointVelocities, gravity)
+           || !setInternalRobotState(jointPositions, jointVelocities))
+        {
+            yError() << "[WalkingFK::initializeGeneratedKinematics] Unable to set the robot state.";
+            return false;
+        }
+
+        for(std::size_t frame = 0; frame < NumberOfCachedFrames; frame++)
+        {
+            iDynTree::Transform expectedTransform = kinDyn.getWorldTransform(m_cachedFrameIndices[frame]);
+            const iDynTree::Transform& transform = getCachedWorldTransform(static_cast<CachedFrame>(frame),
+                                                                           KinematicsState::Measured);
+            maxError = std::max(maxError, (iDynTree::toEigen(transform.getPosition())
+                                           - iDynTree::toEigen(expectedTransform.getPosition())).cwiseAbs().maxCoeff());
+            maxError = std::max(maxError, (iDynTree::toEigen(transform.getRotation())
+                                           - iDynTree::toEigen(expectedTransform.getRotation())).cwiseAbs().maxCoeff());
+
+            kinDyn.getFrameFreeFloatingJacobian(m_cachedFrameIndices[frame], expectedJacobian);
+            getFrameJacobian(static_cast<CachedFrame>(frame), jacobian, KinematicsState::Measured);
+            maxError = std::max(maxError, (iDynTree::toEigen(jacobian)
+                                           - iDynTree::toEigen(expectedJacobian)).cwiseAbs().maxCoeff());
+        }
+
+        evaluateCoM();
+        maxError = std::max(maxError, (iDynTree::toEigen(m_comPosition)
+                                       - iDynTree::toEigen(kinDyn.getCenterOfMassPosition())).cwiseAbs().maxCoeff());
+        maxError = std::max(maxError, (iDynTree::toEigen(m_comVelocity)
+                                       - iDynTree::toEigen(kinDyn.getCenterOfMassVelocity())).cwiseAbs().maxCoeff());
+
+        kinDyn.getCenterOfMassJacobian(expectedJacobian);
+        getCoMJacobian(jacobian);
+        maxError = std::max(maxError, (iDynTree::toEigen(jacobian)
+                                       - iDynTree::toEigen(expectedJacobian)).cwiseAbs().maxCoeff());
+    }
+
+    // restore the initial state
+    m_activeBase = activeBase;
+    m_worldToBaseTransform = iDynTree::Transform::Identity();
+    m_baseTwist.zero();
+    m_comEvaluated = false;
+    m_dcmEvaluated = false;
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
+    m_generatedKinematics->isEvaluated = false;
+    m_comPositionFiltered = comPositionFiltered;
+    m_comVelocityFiltered = comVelocityFiltered;
+    m_filters.reset(m_comPositionSignal, iDynTree::toEigen(m_comPositionFiltered));
+    m_filters.reset(m_comVelocitySignal, iDynTree::toEigen(m_comVelocityFiltered));
+
+    if(maxError > tolerance)
+    {
+        yError() << "[WalkingFK::initializeGeneratedKinematics] The generated kinematics differs from"
+                 << "KinDynComputations. Maximum error:" << maxError << "Please generate again the"
+                 << "kinematics from" << GeneratedKinematics::getModelPath();
+        m_useGeneratedKinematics = false;
+        return false;
+    }
+
+    yInfo() << "[WalkingFK::initializeGeneratedKinematics] The generated kinematics is used. Maximum error"
+            << "w.r.t. KinDynComputations:" << maxError;
+    return true;
+#else
+    yError() << "[WalkingFK::initializeGeneratedKinematics] The library has been compiled without the"
+             << "generated kinematics. Please enable WALKING_CONTROLLERS_GENERATE_KINEMATICS.";
+    return false;
+#endif
+}
+
 void WalkingFK::evaluateWorldToBaseTransformation(const iDynTree::Transform& rootTransform,
                                                   const iDynTree::Twist& rootTwist){
     if(!m_useExternalRobotBase)
@@ -276,12 +591,13 @@ void WalkingFK::evaluateWorldToBaseTransformation(const iDynTree::Transform& roo
         yWarning() << "[evaluateWorldToBaseTransformation] The base position is not retrieved from external. There is no reason to call this function.";
                        return;
     }
-    auto& base = m_baseFrames["root"];
-    m_worldToBaseTransform = rootTransform * base.second;
+    m_worldToBaseTransform = rootTransform * m_baseKinematics[RootBase]->frameToLinkTransform;
     m_baseTwist = rootTwist;
 
     m_comEvaluated = false;
     m_dcmEvaluated = false;
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
     return;
 }
 
@@ -295,20 +611,18 @@ bool WalkingFK::evaluateWorldToBaseTransformation(const iDynTree::Transform& lef
            return true;
        }
 
+    // after the first step the base is evaluated by updateLegOdometry()
+    if(m_useLegOdometry && !m_firstStep)
+        return true;
+
     if(isLeftFixedFrame)
     {
         // evaluate the new world to base transformation only if the previous fixed frame was
         // the right foot
         if(!m_prevContactLeft || m_firstStep)
         {
-            auto& base = m_baseFrames["leftFoot"];
-            m_worldToBaseTransform = leftFootTransform * base.second;
-            if(!m_kinDyn.setFloatingBase(base.first))
-            {
-                yError() << "[evaluateWorldToBaseTransformation] Error while setting the floating "
-                         << "base on link " << base.first;
-                return false;
-            }
+            m_activeBase = LeftFootBase;
+            m_worldToBaseTransform = leftFootTransform * m_baseKinematics[LeftFootBase]->frameToLinkTransform;
             m_prevContactLeft = true;
         }
     }
@@ -318,14 +632,8 @@ bool WalkingFK::evaluateWorldToBaseTransformation(const iDynTree::Transform& lef
         // the left foot
         if(m_prevContactLeft || m_firstStep)
         {
-            auto base = m_baseFrames["rightFoot"];
-            m_worldToBaseTransform = rightFootTransform * base.second;
-            if(!m_kinDyn.setFloatingBase(base.first))
-            {
-                yError() << "[WalkingFK::evaluateWorldToBaseTransformation] Error while setting the floating "
-                         << "base on link " << base.first;
-                return false;
-            }
+            m_activeBase = RightFootBase;
+            m_worldToBaseTransform = rightFootTransform * m_baseKinematics[RightFootBase]->frameToLinkTransform;
             m_prevContactLeft = false;
         }
     }
@@ -334,19 +642,88 @@ bool WalkingFK::evaluateWorldToBaseTransformation(const iDynTree::Transform& lef
 
     m_comEvaluated = false;
     m_dcmEvaluated = false;
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
+    return true;
+}
+
+bool WalkingFK::updateLegOdometry(const iDynTree::Wrench& leftWrench, const iDynTree::Wrench& rightWrench,
+                                  bool& isBaseSwitched)
+{
+    isBaseSwitched = false;
+
+    if(!m_useLegOdometry)
+    {
+        yError() << "[WalkingFK::updateLegOdometry] The leg odometry is not used.";
+        return false;
+    }
+
+    if(m_firstStep)
+    {
+        yError() << "[WalkingFK::updateLegOdometry] The initial pose of the stance foot is not set."
+                 << "Please call evaluateWorldToBaseTransformation() before.";
+        return false;
+    }
+
+    bool isLeftStance = m_activeBase == LeftFootBase;
+    double stanceForce = isLeftStance ? leftWrench.getLinearVec3()(2) : rightWrench.getLinearVec3()(2);
+    double swingForce = isLeftStance ? rightWrench.getLinearVec3()(2) : leftWrench.getLinearVec3()(2);
+
+    // the stance foot does not move, the world to base transformation is not updated. The margin
+    // avoids chattering when the load is shared between the feet
+    if(swingForce < m_legOdometryContactThreshold || swingForce <= stanceForce + m_legOdometrySwitchMargin)
+        return true;
+
+    // the pose of the new stance foot is given by the kinematics of the last measured state
+    if(isLeftStance)
+    {
+        iDynTree::Transform rightFootTransform = getCachedWorldTransform(RightFoot, KinematicsState::Measured);
+        m_activeBase = RightFootBase;
+        m_worldToBaseTransform = rightFootTransform * m_baseKinematics[RightFootBase]->frameToLinkTransform;
+    }
+    else
+    {
+        iDynTree::Transform leftFootTransform = getCachedWorldTransform(LeftFoot, KinematicsState::Measured);
+        m_activeBase = LeftFootBase;
+        m_worldToBaseTransform = leftFootTransform * m_baseKinematics[LeftFootBase]->frameToLinkTransform;
+    }
+    m_prevContactLeft = !isLeftStance;
+    isBaseSwitched = true;
+
+    m_comEvaluated = false;
+    m_dcmEvaluated = false;
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
     return true;
 }
 
+bool WalkingFK::isLegOdometryUsed() const
+{
+    return m_useLegOdometry;
+}
+
 bool WalkingFK::setInternalRobotState(const iDynTree::VectorDynSize& positionFeedbackInRadians,
                                       const iDynTree::VectorDynSize& velocityFeedbackInRadians)
 {
+    if(m_useGeneratedKinematics)
+    {
+        m_generatedKinematics->jointPositions = iDynTree::toEigen(positionFeedbackInRadians);
+        m_generatedKinematics->jointVelocities = iDynTree::toEigen(velocityFeedbackInRadians);
+        m_generatedKinematics->isEvaluated = false;
+
+        m_comEvaluated = false;
+        m_dcmEvaluated = false;
+        m_transformsCache.isEvaluated = false;
+        return true;
+    }
+
     iDynTree::Vector3 gravity;
     gravity.zero();
     gravity(2) = -9.81;
 
-    if(!m_kinDyn.setRobotState(m_worldToBaseTransform, positionFeedbackInRadians,
-                               m_baseTwist, velocityFeedbackInRadians,
-                               gravity))
+    if(!getKinDyn(KinematicsState::Measured).setRobotState(m_worldToBaseTransform, positionFeedbackInRadians,
+                                                           m_baseTwist, velocityFeedbackInRadians,
+                                                           gravity))
     {
         yError() << "[WalkingFK::setInternalRobotState] Error while updating the state.";
         return false;
@@ -354,6 +731,37 @@ bool WalkingFK::setInternalRobotState(const iDynTree::VectorDynSize& positionFee
 
     m_comEvaluated = false;
     m_dcmEvaluated = false;
+    m_transformsCache.isEvaluated = false;
+
+    return true;
+}
+
+bool WalkingFK::setDesiredRobotState(const iDynTree::VectorDynSize& desiredPositionInRadians,
+                                     const iDynTree::VectorDynSize& desiredVelocityInRadians)
+{
+    if(m_useGeneratedKinematics)
+    {
+        m_desiredGeneratedKinematics->jointPositions = iDynTree::toEigen(desiredPositionInRadians);
+        m_desiredGeneratedKinematics->jointVelocities = iDynTree::toEigen(desiredVelocityInRadians);
+        m_desiredGeneratedKinematics->isEvaluated = false;
+
+        m_desiredTransformsCache.isEvaluated = false;
+        return true;
+    }
+
+    iDynTree::Vector3 gravity;
+    gravity.zero();
+    gravity(2) = -9.81;
+
+    if(!getKinDyn(KinematicsState::Desired).setRobotState(m_worldToBaseTransform, desiredPositionInRadians,
+                                                          m_baseTwist, desiredVelocityInRadians,
+                                                          gravity))
+    {
+        yError() << "[WalkingFK::setDesiredRobotState] Error while updating the state.";
+        return false;
+    }
+
+    m_desiredTransformsCache.isEvaluated = false;
 
     return true;
 }
@@ -363,17 +771,30 @@ void WalkingFK::evaluateCoM()
     if(m_comEvaluated)
         return;
 
-    m_comPosition = m_kinDyn.getCenterOfMassPosition();
-    m_comVelocity = m_kinDyn.getCenterOfMassVelocity();
-
-    yarp::sig::Vector temp;
-    temp.resize(3);
-
-    iDynTree::toYarp(m_comPosition, temp);
-    iDynTree::toEigen(m_comPositionFiltered) = iDynTree::toEigen(m_comPositionFilter->filt(temp));
+    if(m_useGeneratedKinematics)
+    {
+        const GeneratedKinematicsState& generatedKinematics = getGeneratedKinematics(KinematicsState::Measured);
+        Eigen::Matrix3d worldToBaseRotation = iDynTree::toEigen(m_worldToBaseTransform.getRotation());
+        Eigen::Vector3d baseToCoMPosition = worldToBaseRotation * generatedKinematics.data.comPosition;
+
+        iDynTree::toEigen(m_comPosition) = iDynTree::toEigen(m_worldToBaseTransform.getPosition())
+            + baseToCoMPosition;
+        iDynTree::toEigen(m_comVelocity) = iDynTree::toEigen(m_baseTwist.getLinearVec3())
+            + iDynTree::toEigen(m_baseTwist.getAngularVec3()).cross(baseToCoMPosition)
+            + worldToBaseRotation * generatedKinematics.data.comJacobian * generatedKinematics.jointVelocities;
+    }
+    else
+    {
+        iDynTree::KinDynComputations& kinDyn = getKinDyn(KinematicsState::Measured);
+        m_comPosition = kinDyn.getCenterOfMassPosition();
+        m_comVelocity = kinDyn.getCenterOfMassVelocity();
+    }
 
-    iDynTree::toYarp(m_comVelocity, temp);
-    iDynTree::toEigen(m_comVelocityFiltered) = iDynTree::toEigen(m_comVelocityFilter->filt(temp));
+    m_filters.setInput(m_comPositionSignal, iDynTree::toEigen(m_comPosition));
+    m_filters.setInput(m_comVelocitySignal, iDynTree::toEigen(m_comVelocity));
+    m_filters.filter();
+    m_filters.getOutput(m_comPositionSignal, iDynTree::toEigen(m_comPositionFiltered));
+    m_filters.getOutput(m_comVelocitySignal, iDynTree::toEigen(m_comVelocityFiltered));
 
     m_comEvaluated = true;
 
@@ -412,8 +833,19 @@ const iDynTree::Vector2& WalkingFK::getDCM()
     return m_dcm;
 }
 
-const iDynTree::Position& WalkingFK::getCoMPosition()
+const iDynTree::Position& WalkingFK::getCoMPosition(const KinematicsState& state)
 {
+    if(state == KinematicsState::Desired)
+    {
+        if(m_useGeneratedKinematics)
+            iDynTree::toEigen(m_desiredCoMPosition) = iDynTree::toEigen(m_worldToBaseTransform.getPosition())
+                + iDynTree::toEigen(m_worldToBaseTransform.getRotation())
+                * getGeneratedKinematics(KinematicsState::Desired).data.comPosition;
+        else
+            m_desiredCoMPosition = getKinDyn(KinematicsState::Desired).getCenterOfMassPosition();
+        return m_desiredCoMPosition;
+    }
+
     evaluateCoM();
 
     if(m_useFilters)
@@ -432,6 +864,59 @@ const iDynTree::Vector3& WalkingFK::getCoMVelocity()
         return m_comVelocity;
 }
 
+bool WalkingFK::getPredictedCoM(const iDynTree::VectorDynSize& jointVelocities, const double& dt,
+                                iDynTree::Position& comPosition, iDynTree::Vector3& comVelocity,
+                                const KinematicsState& state)
+{
+    if(!getCoMJacobian(m_comJacobianBuffer, state))
+    {
+        yError() << "[WalkingFK::getPredictedCoM] Unable to get the CoM jacobian.";
+        return false;
+    }
+
+    if(jointVelocities.size() + 6 != m_comJacobianBuffer.cols())
+    {
+        yError() << "[WalkingFK::getPredictedCoM] The size of the joint velocities vector is not coherent"
+                 << "with the number of joints of the model.";
+        return false;
+    }
+
+    // the unfiltered CoM is used since the prediction is a first-order expansion of the kinematics
+    iDynTree::Position currentCoMPosition;
+    if(state == KinematicsState::Desired)
+        currentCoMPosition = getCoMPosition(KinematicsState::Desired);
+    else
+    {
+        evaluateCoM();
+        currentCoMPosition = m_comPosition;
+    }
+
+    auto jacobian = iDynTree::toEigen(m_comJacobianBuffer);
+    iDynTree::toEigen(comVelocity) = jacobian.leftCols<6>() * iDynTree::toEigen(m_baseTwist)
+        + jacobian.rightCols(jointVelocities.size()) * iDynTree::toEigen(jointVelocities);
+    iDynTree::toEigen(comPosition) = iDynTree::toEigen(currentCoMPosition) + iDynTree::toEigen(comVelocity) * dt;
+
+    return true;
+}
+
+bool WalkingFK::getPredictedDCM(const iDynTree::VectorDynSize& jointVelocities, const double& dt,
+                                iDynTree::Vector2& dcm, const KinematicsState& state)
+{
+    iDynTree::Position comPosition;
+    iDynTree::Vector3 comVelocity;
+    if(!getPredictedCoM(jointVelocities, dt, comPosition, comVelocity, state))
+    {
+        yError() << "[WalkingFK::getPredictedDCM] Unable to predict the CoM.";
+        return false;
+    }
+
+    // take only the 2D projection
+    dcm(0) = comPosition(0) + comVelocity(0) / m_omega;
+    dcm(1) = comPosition(1) + comVelocity(1) / m_omega;
+
+    return true;
+}
+
 bool WalkingFK::setBaseOnTheFly()
 {
     if(m_useExternalRobotBase)
@@ -440,94 +925,133 @@ bool WalkingFK::setBaseOnTheFly()
             return false;
     }
 
-    auto base = m_baseFrames["leftFoot"];
-    m_worldToBaseTransform = base.second;
-    if(!m_kinDyn.setFloatingBase(base.first))
-    {
-        yError() << "[setBaseOnTheFly] Error while setting the floating base on link "
-                 << base.first;
-        return false;
-    }
+    m_activeBase = LeftFootBase;
+    m_worldToBaseTransform = m_baseKinematics[LeftFootBase]->frameToLinkTransform;
+
+    m_transformsCache.isEvaluated = false;
+    m_desiredTransformsCache.isEvaluated = false;
 
     return true;
 }
 
-iDynTree::Transform WalkingFK::getLeftFootToWorldTransform()
+const iDynTree::Transform& WalkingFK::getLeftFootToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameLeftIndex);
+    return getCachedWorldTransform(LeftFoot, state);
 }
 
-iDynTree::Transform WalkingFK::getRightFootToWorldTransform()
+const iDynTree::Transform& WalkingFK::getRightFootToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameRightIndex);
+    return getCachedWorldTransform(RightFoot, state);
 }
 
-iDynTree::Transform WalkingFK::getLeftHandToWorldTransform()
+const iDynTree::Transform& WalkingFK::getLeftHandToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameLeftHandIndex);
+    return getCachedWorldTransform(LeftHand, state);
 }
 
-iDynTree::Transform WalkingFK::getRightHandToWorldTransform()
+const iDynTree::Transform& WalkingFK::getRightHandToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameRightHandIndex);
+    return getCachedWorldTransform(RightHand, state);
 }
 
-iDynTree::Transform WalkingFK::getHeadToWorldTransform()
+const iDynTree::Transform& WalkingFK::getHeadToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameHeadIndex);
+    return getCachedWorldTransform(Head, state);
 }
 
-iDynTree::Transform WalkingFK::getRootLinkToWorldTransform()
+const iDynTree::Transform& WalkingFK::getRootLinkToWorldTransform(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameRootIndex);
+    return getCachedWorldTransform(Root, state);
 }
 
 iDynTree::Twist WalkingFK::getRootLinkVelocity()
 {
-    return m_kinDyn.getFrameVel(m_frameRootIndex);
+    if(!m_useGeneratedKinematics)
+        return getKinDyn(KinematicsState::Measured).getFrameVel(m_frameRootIndex);
+
+    const GeneratedKinematicsState& generatedKinematics = getGeneratedKinematics(KinematicsState::Measured);
+    getFrameJacobian(Root, m_jacobianBuffer, KinematicsState::Measured);
+    auto jacobian = iDynTree::toEigen(m_jacobianBuffer);
+
+    iDynTree::Twist twist;
+    iDynTree::toEigen(twist.getLinearVec3()) = jacobian.topLeftCorner<3, 3>() * iDynTree::toEigen(m_baseTwist.getLinearVec3())
+        + jacobian.block<3, 3>(0, 3) * iDynTree::toEigen(m_baseTwist.getAngularVec3())
+        + jacobian.topRightCorner(3, generatedKinematics.jointVelocities.size()) * generatedKinematics.jointVelocities;
+    iDynTree::toEigen(twist.getAngularVec3()) = iDynTree::toEigen(m_baseTwist.getAngularVec3())
+        + jacobian.bottomRightCorner(3, generatedKinematics.jointVelocities.size()) * generatedKinematics.jointVelocities;
+    return twist;
 }
 
-iDynTree::Rotation WalkingFK::getNeckOrientation()
+const iDynTree::Rotation& WalkingFK::getNeckOrientation(const KinematicsState& state)
 {
-    return m_kinDyn.getWorldTransform(m_frameNeckIndex).getRotation();
+    return getCachedWorldTransform(Neck, state).getRotation();
 }
 
-bool WalkingFK::getLeftFootJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getLeftFootJacobian(iDynTree::MatrixDynSize &jacobian,
+                                    const KinematicsState& state)
 {
-    return m_kinDyn.getFrameFreeFloatingJacobian(m_frameLeftIndex, jacobian);
+    return getFrameJacobian(LeftFoot, jacobian, state);
 }
 
-bool WalkingFK::getRightFootJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getRightFootJacobian(iDynTree::MatrixDynSize &jacobian,
+                                     const KinematicsState& state)
 {
-    return m_kinDyn.getFrameFreeFloatingJacobian(m_frameRightIndex, jacobian);
+    return getFrameJacobian(RightFoot, jacobian, state);
 }
 
-bool WalkingFK::getRightHandJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getRightHandJacobian(iDynTree::MatrixDynSize &jacobian,
+                                     const KinematicsState& state)
 {
-    return m_kinDyn.getFrameFreeFloatingJacobian(m_frameRightHandIndex, jacobian);
+    return getFrameJacobian(RightHand, jacobian, state);
 }
 
-bool WalkingFK::getLeftHandJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getLeftHandJacobian(iDynTree::MatrixDynSize &jacobian,
+                                    const KinematicsState& state)
 {
-    return m_kinDyn.getFrameFreeFloatingJacobian(m_frameLeftHandIndex, jacobian);
+    return getFrameJacobian(LeftHand, jacobian, state);
 }
 
-bool WalkingFK::getNeckJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getNeckJacobian(iDynTree::MatrixDynSize &jacobian,
+                                const KinematicsState& state)
 {
-    return m_kinDyn.getFrameFreeFloatingJacobian(m_frameNeckIndex, jacobian);
+    return getFrameJacobian(Neck, jacobian, state);
 }
 
-bool WalkingFK::getCoMJacobian(iDynTree::MatrixDynSize &jacobian)
+bool WalkingFK::getCoMJacobian(iDynTree::MatrixDynSize &jacobian,
+                               const KinematicsState& state)
 {
-    return m_kinDyn.getCenterOfMassJacobian(jacobian);
+    if(!m_useGeneratedKinematics)
+        return getKinDyn(state).getCenterOfMassJacobian(jacobian);
+
+    const GeneratedKinematics::Data& data = getGeneratedKinematics(state).data;
+    Eigen::Matrix3d worldToBaseRotation = iDynTree::toEigen(m_worldToBaseTransform.getRotation());
+    std::size_t numberOfJoints = data.comJacobian.cols();
+
+    jacobian.resize(3, numberOfJoints + 6);
+    auto jacobianEigen = iDynTree::toEigen(jacobian);
+    jacobianEigen.leftCols<3>().setIdentity();
+    jacobianEigen.block<3, 3>(0, 3) = -iDynTree::skew(worldToBaseRotation * data.comPosition);
+    jacobianEigen.rightCols(numberOfJoints) = worldToBaseRotation * data.comJacobian;
+
+    return true;
 }
 
-const iDynTree::VectorDynSize& WalkingFK::getJointPos()
+const iDynTree::VectorDynSize& WalkingFK::getJointPos(const KinematicsState& state)
 {
+    iDynTree::VectorDynSize& jointPositions = state == KinematicsState::Desired ?
+        m_desiredJointPositions : m_jointPositions;
+
+    if(m_useGeneratedKinematics)
+    {
+        const GeneratedKinematicsState& generatedKinematics = state == KinematicsState::Desired ?
+            *m_desiredGeneratedKinematics : *m_generatedKinematics;
+        iDynTree::toEigen(jointPositions) = generatedKinematics.jointPositions;
+        return jointPositions;
+    }
 
-    bool ok = m_kinDyn.getJointPos(m_jointPositions);
+    bool ok = getKinDyn(state).getJointPos(jointPositions);
 
     assert(ok);
 
-    return m_jointPositions;
+    return jointPositions;
 }
@@ -11,6 +11,7 @@
 
 // std
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <yarp/dev/PolyDriver.h>
@@ -24,14 +25,14 @@
 #include <yarp/sig/Vector.h>
 #include <yarp/os/Timer.h>
 
-#include <iCub/ctrl/filters.h>
-
 #include <iDynTree/Core/VectorDynSize.h>
 #include <iDynTree/Core/Wrench.h>
 #include <iDynTree/Core/Twist.h>
 #include <iDynTree/Core/Transform.h>
 
 #include <WalkingControllers/RobotInterface/PIDHandler.h>
+#include <WalkingControllers/iDynTreeUtilities/FilterBank.h>
+
 namespace WalkingControllers
 {
     class RobotInterface
@@ -62,6 +63,9 @@ namespace WalkingControllers
 
         yarp::sig::Vector m_positionFeedbackDeg; /**< Current joint position [deg]. */
         yarp::sig::Vector m_velocityFeedbackDeg; /**< Current joint velocity [deg/s]. */
+        yarp::sig::Vector m_encoderTimestamps; /**< Timestamps of the encoders [s]. */
+        double m_encodersTimestamp; /**< Time of the joint measurement (mean of the encoders timestamps) [s]. */
+        double m_encodersAge{0}; /**< Age of the joint measurement when the feedbacks are read [s]. */
         iDynTree::VectorDynSize m_positionFeedbackRad; /**< Current joint position [rad]. */
         iDynTree::VectorDynSize m_velocityFeedbackRad; /**< Current joint velocity [rad/s]. */
 
@@ -71,10 +75,8 @@ namespace WalkingControllers
         iDynTree::VectorDynSize m_jointVelocitiesBounds; /**< Joint Velocity bounds [rad/s]. */
         iDynTree::VectorDynSize m_jointPositionsUpperBounds; /**< Joint Position upper bound [rad]. */
         iDynTree::VectorDynSize m_jointPositionsLowerBounds; /**< Joint Position lower bound [rad]. */
-        // yarp::sig::Vector m_positionFeedbackDegFiltered;
-        yarp::sig::Vector m_velocityFeedbackDegFiltered; /**< Vector containing the filtered joint velocity [deg/s]. */
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_positionFilter; /**< Joint position low pass filter .*/
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_velocityFilter; /**< Joint velocity low pass filter .*/
+        FirstOrderLowPassFilterBank m_filters; /**< Low pass filters of the joint velocities and of the wrenches. */
+        std::size_t m_velocitySignal; /**< Index of the joint velocities in the filter bank. */
         bool m_useVelocityFilter; /**< True if the joint velocity filter is used. */
 
         yarp::os::BufferedPort<yarp::sig::Vector> m_leftWrenchPort; /**< Left foot wrench port. */
@@ -85,10 +87,24 @@ namespace WalkingControllers
         yarp::sig::Vector m_rightWrenchInputFiltered; /**< YARP vector that contains right foot filtered wrench. */
         iDynTree::Wrench m_leftWrench; /**< iDynTree vector that contains left foot wrench. */
         iDynTree::Wrench m_rightWrench; /**< iDynTree vector that contains right foot wrench. */
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_leftWrenchFilter; /**< Left wrench low pass filter.*/
-        std::unique_ptr<iCub::ctrl::FirstOrderLowPassFilter> m_rightWrenchFilter; /**< Right wrench low pass filter.*/
+        std::size_t m_leftWrenchSignal; /**< Index of the left wrench in the filter bank. */
+        std::size_t m_rightWrenchSignal; /**< Index of the right wrench in the filter bank. */
         bool m_useWrenchFilter; /**< True if the wrench filter is used. */
 
+        yarp::sig::Vector m_leftWrenchSample; /**< Last sample received from the left foot wrench port. */
+        yarp::sig::Vector m_rightWrenchSample; /**< Last sample received from the right foot wrench port. */
+        yarp::sig::Vector m_leftWrenchPreviousSample; /**< Previous sample of the left foot wrench. */
+        yarp::sig::Vector m_rightWrenchPreviousSample; /**< Previous sample of the right foot wrench. */
+        double m_leftWrenchTimestamp{0}; /**< Timestamp of the last left foot wrench sample [s]. */
+        double m_rightWrenchTimestamp{0}; /**< Timestamp of the last right foot wrench sample [s]. */
+        double m_leftWrenchPreviousTimestamp{0}; /**< Timestamp of the previous left foot wrench sample [s]. */
+        double m_rightWrenchPreviousTimestamp{0}; /**< Timestamp of the previous right foot wrench sample [s]. */
+        double m_leftWrenchAge{0}; /**< Age of the left foot wrench sample w.r.t. the encoders [s]. */
+        double m_rightWrenchAge{0}; /**< Age of the right foot wrench sample w.r.t. the encoders [s]. */
+        bool m_alignWrenches{false}; /**< True if the wrenches are extrapolated to the time of the encoders. */
+        double m_wrenchMaxAge{0}; /**< Maximum age of the wrenches (if it is not positive the age is not checked) [s]. */
+        bool m_stopOnStaleWrench{true}; /**< True if a stale wrench is an error, otherwise a warning is raised. */
+
         double m_startingPositionControlTime;
         bool m_positionMoveSkipped;
 
@@ -100,6 +116,9 @@ namespace WalkingControllers
 
         int m_controlMode{-1}; /**< Current position control mode */
 
+        bool m_useSimulatedRobot; /**< True if the robot is simulated by the SimulatedRobot device. */
+        double m_realTimeFactor; /**< Ratio between the simulated time and the real time. */
+
         /**
          * Get the higher position error among all joints.
          * @param desiredJointPositionsRad desired joint position in radiants;
@@ -117,6 +136,30 @@ namespace WalkingControllers
          */
         bool switchToControlMode(const int& controlMode);
 
+        /**
+         * Get the timestamp of the last message read from a wrench port. If the envelope is not
+         * available the reception time is used.
+         * @param port the wrench port.
+         * @return the timestamp in seconds.
+         */
+        double getWrenchTimestamp(yarp::os::BufferedPort<yarp::sig::Vector>& port);
+
+        /**
+         * Align a wrench sample to the time of the encoders. If the alignment is enabled the wrench
+         * is linearly extrapolated using the previous sample.
+         * @param foot name of the foot (used for logging);
+         * @param sample last wrench sample;
+         * @param timestamp timestamp of the last sample;
+         * @param previousSample previous wrench sample;
+         * @param previousTimestamp timestamp of the previous sample;
+         * @param wrench the wrench at the time of the encoders;
+         * @param age age of the sample w.r.t. the encoders.
+         * @return false if the sample is stale and the stale wrenches are not tolerated.
+         */
+        bool alignWrench(const std::string& foot, const yarp::sig::Vector& sample, const double& timestamp,
+                         const yarp::sig::Vector& previousSample, const double& previousTimestamp,
+                         yarp::sig::Vector& wrench, double& age);
+
         bool setInteractionMode(yarp::dev::InteractionModeEnum interactionMode);
 
         bool setInteractionMode(std::vector<yarp::dev::InteractionModeEnum>& interactionModes);
@@ -219,6 +262,31 @@ namespace WalkingControllers
         const iDynTree::Wrench& getLeftWrench() const;
         const iDynTree::Wrench& getRightWrench() const;
 
+        /**
+         * Get the time of the joint measurement.
+         * @return the mean of the encoders timestamps in seconds
+         */
+        double getEncodersTimestamp() const;
+
+        /**
+         * Get the age of the joint measurement, i.e. the time elapsed between the encoders
+         * timestamp and the instant in which the feedbacks are read.
+         * @return the age in seconds
+         */
+        double getEncodersAge() const;
+
+        /**
+         * Get the age of the left foot wrench sample w.r.t. the encoders (before the alignment).
+         * @return the age in seconds (negative if the sample is newer than the encoders)
+         */
+        double getLeftWrenchAge() const;
+
+        /**
+         * Get the age of the right foot wrench sample w.r.t. the encoders (before the alignment).
+         * @return the age in seconds (negative if the sample is newer than the encoders)
+         */
+        double getRightWrenchAge() const;
+
         const std::vector<std::string>& getAxesList() const;
 
         int getActuatedDoFs();
@@ -254,6 +322,13 @@ namespace WalkingControllers
          */
         bool isExternalRobotBaseUsed();
 
+        /**
+         * Get the ratio between the time of the robot and the real time. It is different from one
+         * only if the robot is simulated by the SimulatedRobot device.
+         * @return the real time factor
+         */
+        double getRealTimeFactor() const;
+
     };
 };
 #endif
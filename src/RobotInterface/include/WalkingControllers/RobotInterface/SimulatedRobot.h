@@ -0,0 +1,237 @@
+/**
+ * @file SimulatedRobot.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2019 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2019
+ */
+
+#ifndef WALKING_CONTROLLERS_ROBOT_HELPER_SIMULATED_ROBOT_H
+#define WALKING_CONTROLLERS_ROBOT_HELPER_SIMULATED_ROBOT_H
+
+// std
+#include <mutex>
+#include <string>
+#include <vector>
+
+// YARP
+#include <yarp/dev/DeviceDriver.h>
+#include <yarp/dev/IEncodersTimed.h>
+#include <yarp/dev/IControlMode.h>
+#include <yarp/dev/IControlLimits.h>
+#include <yarp/dev/IPositionControl.h>
+#include <yarp/dev/IPositionDirect.h>
+#include <yarp/dev/IVelocityControl.h>
+#include <yarp/dev/IInteractionMode.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/sig/Vector.h>
+
+// iDynTree
+#include <iDynTree/Core/Position.h>
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/KinDynComputations.h>
+
+namespace WalkingControllers
+{
+    /**
+     * SimulatedRobot class. It is an in-process YARP device that replaces the
+     * remotecontrolboardremapper when a simulator is not available. The joints track the
+     * references ideally (each reference is reached in one sampling time) and the
+     * wrenches of the feet are computed with a linear inverted pendulum model: the total force
+     * balances the gravity and the CoM acceleration, the ZMP is shared between the feet in
+     * contact. The feet wrenches are published on the ports read by the force torque sensors
+     * (the same ports of wholeBodyDynamics), they are expressed in the feet frames.
+     */
+    class SimulatedRobot : public yarp::dev::DeviceDriver,
+                           public yarp::dev::IEncodersTimed,
+                           public yarp::dev::IPositionControl,
+                           public yarp::dev::IPositionDirect,
+                           public yarp::dev::IVelocityControl,
+                           public yarp::dev::IControlMode,
+                           public yarp::dev::IControlLimits,
+                           public yarp::dev::IInteractionMode
+    {
+        std::vector<std::string> m_axesList; /**< Vector containing the name of the controlled joints. */
+        int m_actuatedDOFs; /**< Number of the actuated DoFs. */
+        double m_samplingTime; /**< Time advanced at each reference [s]. */
+        double m_time; /**< Wall-clock time of the last update of the state [s]. */
+
+        iDynTree::KinDynComputations m_kinDyn; /**< Reduced model of the robot. */
+        iDynTree::FrameIndex m_leftFootFrame; /**< Index of the left foot frame. */
+        iDynTree::FrameIndex m_rightFootFrame; /**< Index of the right foot frame. */
+        double m_contactHeight; /**< A foot is in contact if its height is lower than this value [m]. */
+
+        iDynTree::VectorDynSize m_jointPositions; /**< Joint positions [rad]. */
+        iDynTree::VectorDynSize m_jointVelocities; /**< Joint velocities [rad/s]. */
+        iDynTree::VectorDynSize m_velocityReferences; /**< Joint velocity references [rad/s]. */
+        iDynTree::VectorDynSize m_speedReferences; /**< Joint speeds used by the position control [deg/s]. */
+        iDynTree::VectorDynSize m_positionLowerLimits; /**< Joint position lower limits [deg]. */
+        iDynTree::VectorDynSize m_positionUpperLimits; /**< Joint position upper limits [deg]. */
+        iDynTree::VectorDynSize m_velocityLimits; /**< Joint velocity limits [deg/s]. */
+        std::vector<int> m_controlModes; /**< Control modes of the joints. */
+        std::vector<yarp::dev::InteractionModeEnum> m_interactionModes; /**< Interaction modes of the joints. */
+
+        bool m_isLeftFootStance; /**< True if the left foot is the stance foot. */
+        iDynTree::Transform m_stanceFootToWorldTransform; /**< Pose of the stance foot (it does not slip). */
+        iDynTree::Position m_comPosition; /**< CoM position in the world frame. */
+        iDynTree::Position m_previousCoMPosition; /**< CoM position at the previous step. */
+        iDynTree::Position m_secondPreviousCoMPosition; /**< CoM position two steps before. */
+
+        yarp::os::BufferedPort<yarp::sig::Vector> m_leftWrenchPort; /**< Left foot wrench port. */
+        yarp::os::BufferedPort<yarp::sig::Vector> m_rightWrenchPort; /**< Right foot wrench port. */
+        yarp::sig::Vector m_leftWrench; /**< Left foot wrench expressed in the foot frame. */
+        yarp::sig::Vector m_rightWrench; /**< Right foot wrench expressed in the foot frame. */
+        yarp::os::Stamp m_wrenchStamp; /**< Envelope of the wrenches (it contains the time of the device). */
+
+        std::mutex m_mutex; /**< Mutex protecting the state of the robot. */
+
+        /**
+         * Move the joints and evaluate the wrenches of the feet.
+         * @param jointPositions new joint positions in radians (they are saturated);
+         * @param isStatic true if the robot is at rest in the new configuration (i.e. the
+         * references are reached by the position control).
+         * @return true in case of success and false otherwise.
+         */
+        bool updateState(const iDynTree::VectorDynSize& jointPositions, bool isStatic);
+
+        /**
+         * Evaluate the wrenches of the feet with the linear inverted pendulum model.
+         * @param isStatic true if the CoM acceleration is zero.
+         * @return true in case of success and false otherwise.
+         */
+        bool updateWrenches(bool isStatic);
+
+        /**
+         * Publish the wrenches of the feet. The envelope contains the time of the last update of
+         * the state, i.e. the timestamp of the encoders.
+         */
+        void publishWrenches();
+
+        /**
+         * Move a subset of the joints with the position control.
+         * @param n_joint number of joints;
+         * @param joints indices of the joints (if nullptr all the joints are moved);
+         * @param refs joint references in degrees;
+         * @param isRelative true if the references are relative to the current positions.
+         * @return true in case of success and false otherwise.
+         */
+        bool moveJoints(const int n_joint, const int* joints, const double* refs, bool isRelative);
+
+        /**
+         * Move a subset of the joints with the direct position control.
+         * @param n_joint number of joints;
+         * @param joints indices of the joints (if nullptr all the joints are moved);
+         * @param refs joint references in degrees.
+         * @return true in case of success and false otherwise.
+         */
+        bool setJointPositions(const int n_joint, const int* joints, const double* refs);
+
+        /**
+         * Move a subset of the joints with the velocity control.
+         * @param n_joint number of joints;
+         * @param joints indices of the joints (if nullptr all the joints are moved);
+         * @param spds joint velocity references in degrees per second.
+         * @return true in case of success and false otherwise.
+         */
+        bool setJointVelocities(const int n_joint, const int* joints, const double* spds);
+
+        /**
+         * Check the index of a joint.
+         * @param joint index of the joint.
+         * @return true if the index is valid.
+         */
+        bool isValidJoint(int joint) const;
+
+    public:
+
+        // DeviceDriver
+        bool open(yarp::os::Searchable& config) override;
+        bool close() override;
+
+        // IEncodersTimed (the wrenches of the feet are published when the encoders are read)
+        bool getAxes(int* ax) override;
+        bool resetEncoder(int j) override;
+        bool resetEncoders() override;
+        bool setEncoder(int j, double val) override;
+        bool setEncoders(const double* vals) override;
+        bool getEncoder(int j, double* v) override;
+        bool getEncoders(double* encs) override;
+        bool getEncoderSpeed(int j, double* sp) override;
+        bool getEncoderSpeeds(double* spds) override;
+        bool getEncoderAcceleration(int j, double* spds) override;
+        bool getEncoderAccelerations(double* accs) override;
+        bool getEncodersTimed(double* encs, double* time) override;
+        bool getEncoderTimed(int j, double* encs, double* time) override;
+
+        // IPositionControl (the targets are reached in one step)
+        bool positionMove(int j, double ref) override;
+        bool positionMove(const double* refs) override;
+        bool positionMove(const int n_joint, const int* joints, const double* refs) override;
+        bool relativeMove(int j, double delta) override;
+        bool relativeMove(const double* deltas) override;
+        bool relativeMove(const int n_joint, const int* joints, const double* deltas) override;
+        bool checkMotionDone(int j, bool* flag) override;
+        bool checkMotionDone(bool* flag) override;
+        bool checkMotionDone(const int n_joint, const int* joints, bool* flag) override;
+        bool setRefSpeed(int j, double sp) override;
+        bool setRefSpeeds(const double* spds) override;
+        bool setRefSpeeds(const int n_joint, const int* joints, const double* spds) override;
+        bool setRefAcceleration(int j, double acc) override;
+        bool setRefAccelerations(const double* accs) override;
+        bool setRefAccelerations(const int n_joint, const int* joints, const double* accs) override;
+        bool getRefSpeed(int j, double* ref) override;
+        bool getRefSpeeds(double* spds) override;
+        bool getRefSpeeds(const int n_joint, const int* joints, double* spds) override;
+        bool getRefAcceleration(int j, double* acc) override;
+        bool getRefAccelerations(double* accs) override;
+        bool getRefAccelerations(const int n_joint, const int* joints, double* accs) override;
+        bool stop(int j) override;
+        bool stop() override;
+        bool stop(const int n_joint, const int* joints) override;
+        bool getTargetPosition(const int joint, double* ref) override;
+        bool getTargetPositions(double* refs) override;
+        bool getTargetPositions(const int n_joint, const int* joints, double* refs) override;
+
+        // IPositionDirect
+        bool setPosition(int j, double ref) override;
+        bool setPositions(const int n_joint, const int* joints, const double* refs) override;
+        bool setPositions(const double* refs) override;
+        bool getRefPosition(const int joint, double* ref) override;
+        bool getRefPositions(double* refs) override;
+        bool getRefPositions(const int n_joint, const int* joints, double* refs) override;
+
+        // IVelocityControl (the references are integrated for one sampling time)
+        bool velocityMove(int j, double sp) override;
+        bool velocityMove(const double* sp) override;
+        bool velocityMove(const int n_joint, const int* joints, const double* spds) override;
+        bool getRefVelocity(const int joint, double* vel) override;
+        bool getRefVelocities(double* vels) override;
+        bool getRefVelocities(const int n_joint, const int* joints, double* vels) override;
+
+        // IControlMode
+        bool getControlMode(int j, int* mode) override;
+        bool getControlModes(int* modes) override;
+        bool getControlModes(const int n_joint, const int* joints, int* modes) override;
+        bool setControlMode(const int j, const int mode) override;
+        bool setControlModes(const int n_joint, const int* joints, int* modes) override;
+        bool setControlModes(int* modes) override;
+
+        // IControlLimits
+        bool setLimits(int axis, double min, double max) override;
+        bool getLimits(int axis, double* min, double* max) override;
+        bool setVelLimits(int axis, double min, double max) override;
+        bool getVelLimits(int axis, double* min, double* max) override;
+
+        // IInteractionMode
+        bool getInteractionMode(int axis, yarp::dev::InteractionModeEnum* mode) override;
+        bool getInteractionModes(int n_joints, int* joints, yarp::dev::InteractionModeEnum* modes) override;
+        bool getInteractionModes(yarp::dev::InteractionModeEnum* modes) override;
+        bool setInteractionMode(int axis, yarp::dev::InteractionModeEnum mode) override;
+        bool setInteractionModes(int n_joints, int* joints, yarp::dev::InteractionModeEnum* modes) override;
+        bool setInteractionModes(yarp::dev::InteractionModeEnum* modes) override;
+    };
+};
+
+#endif
@@ -1,8 +1,14 @@
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+
 #include <iDynTree/Core/Utils.h>
 #include <iDynTree/Core/EigenHelpers.h>
 #include <iDynTree/yarp/YARPConversions.h>
+#include <iDynTree/yarp/YARPEigenConversions.h>
 
 #include <WalkingControllers/RobotInterface/Helper.h>
+#include <WalkingControllers/RobotInterface/SimulatedRobot.h>
 #include <WalkingControllers/iDynTreeUtilities/Helper.h>
 #include <WalkingControllers/YarpUtilities/Helper.h>
 
@@ -62,11 +68,14 @@ bool RobotInterface::getFeedbacksRaw(unsigned int maxAttempts)
 
     bool okBaseEstimation = !m_useExternalRobotBase;
 
+    bool areWrenchesStale = false;
+
     unsigned int attempt = 0;
     do
     {
         if(!okPosition)
-            okPosition = m_encodersInterface->getEncoders(m_positionFeedbackDeg.data());
+            okPosition = m_encodersInterface->getEncodersTimed(m_positionFeedbackDeg.data(),
+                                                               m_encoderTimestamps.data());
 
         if(!okVelocity)
             okVelocity = m_encodersInterface->getEncoderSpeeds(m_velocityFeedbackDeg.data());
@@ -77,7 +86,10 @@ bool RobotInterface::getFeedbacksRaw(unsigned int maxAttempts)
             leftWrenchRaw = m_leftWrenchPort.read(false);
             if(leftWrenchRaw != NULL)
             {
-                m_leftWrenchInput = *leftWrenchRaw;
+                m_leftWrenchPreviousSample = m_leftWrenchSample;
+                m_leftWrenchPreviousTimestamp = m_leftWrenchTimestamp;
+                m_leftWrenchSample = *leftWrenchRaw;
+                m_leftWrenchTimestamp = getWrenchTimestamp(m_leftWrenchPort);
                 okLeftWrench = true;
             }
         }
@@ -88,7 +100,10 @@ bool RobotInterface::getFeedbacksRaw(unsigned int maxAttempts)
             rightWrenchRaw = m_rightWrenchPort.read(false);
             if(rightWrenchRaw != NULL)
             {
-                m_rightWrenchInput = *rightWrenchRaw;
+                m_rightWrenchPreviousSample = m_rightWrenchSample;
+                m_rightWrenchPreviousTimestamp = m_rightWrenchTimestamp;
+                m_rightWrenchSample = *rightWrenchRaw;
+                m_rightWrenchTimestamp = getWrenchTimestamp(m_rightWrenchPort);
                 okRightWrench = true;
             }
         }
@@ -113,6 +128,37 @@ bool RobotInterface::getFeedbacksRaw(unsigned int maxAttempts)
             }
         }
 
+        if(okPosition && okVelocity && okLeftWrench && okRightWrench && okBaseEstimation)
+        {
+            // the wrenches are referred to the time of the joint measurement
+            m_encodersTimestamp = iDynTree::toEigen(m_encoderTimestamps).mean();
+            m_encodersAge = yarp::os::Time::now() - m_encodersTimestamp;
+            bool isLeftWrenchFresh = alignWrench("left", m_leftWrenchSample, m_leftWrenchTimestamp,
+                                                 m_leftWrenchPreviousSample, m_leftWrenchPreviousTimestamp,
+                                                 m_leftWrenchInput, m_leftWrenchAge);
+            bool isRightWrenchFresh = alignWrench("right", m_rightWrenchSample, m_rightWrenchTimestamp,
+                                                  m_rightWrenchPreviousSample, m_rightWrenchPreviousTimestamp,
+                                                  m_rightWrenchInput, m_rightWrenchAge);
+
+            // a fresher sample is read in the next attempt: the wrench if it is older than the
+            // encoders, the encoders otherwise
+            areWrenchesStale = !isLeftWrenchFresh || !isRightWrenchFresh;
+            if(!isLeftWrenchFresh)
+            {
+                if(m_leftWrenchAge > 0)
+                    okLeftWrench = false;
+                else
+                    okPosition = okVelocity = false;
+            }
+            if(!isRightWrenchFresh)
+            {
+                if(m_rightWrenchAge > 0)
+                    okRightWrench = false;
+                else
+                    okPosition = okVelocity = false;
+            }
+        }
+
         if(okPosition && okVelocity && okLeftWrench && okRightWrench && okBaseEstimation)
         {
             for(unsigned j = 0 ; j < m_actuatedDOFs; j++)
@@ -153,9 +199,51 @@ bool RobotInterface::getFeedbacksRaw(unsigned int maxAttempts)
     if(!okBaseEstimation)
         yError() << "\t - Base estimation";
 
+    if(areWrenchesStale)
+        yError() << "\t - Fresh wrenches (the age of the left and right foot wrenches is" << m_leftWrenchAge
+                 << "s and" << m_rightWrenchAge << "s while the maximum age is" << m_wrenchMaxAge << "s)";
+
     return false;
 }
 
+double RobotInterface::getWrenchTimestamp(yarp::os::BufferedPort<yarp::sig::Vector>& port)
+{
+    yarp::os::Stamp stamp;
+    if(port.getEnvelope(stamp) && stamp.isValid())
+        return stamp.getTime();
+
+    return yarp::os::Time::now();
+}
+
+bool RobotInterface::alignWrench(const std::string& foot, const yarp::sig::Vector& sample, const double& timestamp,
+                                 const yarp::sig::Vector& previousSample, const double& previousTimestamp,
+                                 yarp::sig::Vector& wrench, double& age)
+{
+    age = m_encodersTimestamp - timestamp;
+    bool isStale = m_wrenchMaxAge > 0 && std::abs(age) > m_wrenchMaxAge;
+    if(isStale)
+    {
+        // the caller reads a fresher sample
+        if(m_stopOnStaleWrench)
+            return false;
+
+        yWarning() << "[RobotInterface::alignWrench] The age of the" << foot << "foot wrench is" << age
+                   << "s while the maximum age is" << m_wrenchMaxAge << "s.";
+    }
+
+    wrench = sample;
+
+    // a stale sample is not extrapolated
+    double samplesDistance = timestamp - previousTimestamp;
+    if(!m_alignWrenches || isStale || previousSample.size() != sample.size() || samplesDistance <= 1e-6)
+        return true;
+
+    iDynTree::toEigen(wrench) += (iDynTree::toEigen(sample) - iDynTree::toEigen(previousSample))
+        * age / samplesDistance;
+
+    return true;
+}
+
 bool RobotInterface::configureRobot(const yarp::os::Searchable& config)
 {
     // robot name: used to connect to the robot
@@ -257,7 +345,42 @@ bool RobotInterface::configureRobot(const yarp::os::Searchable& config)
     }
 
     // open the device
-    if(!m_robotDevice.open(options))
+    m_useSimulatedRobot = config.check("use_simulated_robot", yarp::os::Value("False")).asBool();
+    m_realTimeFactor = 1.0;
+    if(m_useSimulatedRobot)
+    {
+        m_realTimeFactor = config.check("simulated_robot_real_time_factor", yarp::os::Value(1.0)).asDouble();
+        if(m_realTimeFactor <= 0)
+        {
+            yError() << "[RobotInterface::configureRobot] The real time factor has to be positive.";
+            return false;
+        }
+
+        // the simulated robot is created in process instead of the remotecontrolboardremapper
+        yarp::os::Property simulatedRobotOptions;
+        YarpUtilities::addVectorOfStringToProperty(simulatedRobotOptions, "axesNames", m_axesList);
+        simulatedRobotOptions.put("sampling_time", sampligTime);
+        std::string model = config.check("model", yarp::os::Value("model.urdf")).asString();
+        simulatedRobotOptions.put("model",
+                                  yarp::os::ResourceFinder::getResourceFinderSingleton().findFileByName(model));
+        for(const std::string key : {"left_foot_frame", "right_foot_frame", "contact_height", "max_joint_velocity",
+                    "left_foot_wrench_port_name", "right_foot_wrench_port_name"})
+            if(config.check("simulated_robot_" + key))
+                simulatedRobotOptions.put(key, config.find("simulated_robot_" + key));
+
+        std::unique_ptr<SimulatedRobot> simulatedRobot = std::make_unique<SimulatedRobot>();
+        if(!simulatedRobot->open(simulatedRobotOptions))
+        {
+            yError() << "[RobotInterface::configureRobot] Could not open the simulated robot.";
+            return false;
+        }
+        if(!m_robotDevice.give(simulatedRobot.release(), true))
+        {
+            yError() << "[RobotInterface::configureRobot] Could not attach the simulated robot.";
+            return false;
+        }
+    }
+    else if(!m_robotDevice.open(options))
     {
         yError() << "[configureRobot] Could not open remotecontrolboardremapper object.";
         return false;
@@ -309,6 +432,7 @@ bool RobotInterface::configureRobot(const yarp::os::Searchable& config)
     // resize the buffers
     m_positionFeedbackDeg.resize(m_actuatedDOFs, 0.0);
     m_velocityFeedbackDeg.resize(m_actuatedDOFs, 0.0);
+    m_encoderTimestamps.resize(m_actuatedDOFs, 0.0);
     m_positionFeedbackRad.resize(m_actuatedDOFs);
     m_velocityFeedbackRad.resize(m_actuatedDOFs);
     m_desiredJointPositionRad.resize(m_actuatedDOFs);
@@ -317,11 +441,8 @@ bool RobotInterface::configureRobot(const yarp::os::Searchable& config)
     m_jointPositionsUpperBounds.resize(m_actuatedDOFs);
     m_jointPositionsLowerBounds.resize(m_actuatedDOFs);
 
-    // m_positionFeedbackDegFiltered.resize(m_actuatedDOFs);
-    // m_positionFeedbackDegFiltered.zero();
-
-    m_velocityFeedbackDegFiltered.resize(m_actuatedDOFs);
-    m_velocityFeedbackDegFiltered.zero();
+    // the joint velocities and the wrenches of the feet are stored in the same filter bank
+    m_filters.initialize(m_actuatedDOFs + 12);
 
     // check if the robot is alive
     bool okPosition = false;
@@ -357,12 +478,13 @@ bool RobotInterface::configureRobot(const yarp::os::Searchable& config)
         }
 
         // set filters
-        // m_positionFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(10, m_dT);
-        m_velocityFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(cutFrequency,
-                                                                                 sampligTime);
+        if(!m_filters.addSignal(m_actuatedDOFs, cutFrequency, sampligTime, m_velocitySignal))
+        {
+            yError() << "[configure] Unable to add the joint velocity to the filters.";
+            return false;
+        }
 
-        // m_positionFilter->init(m_positionFeedbackDeg);
-        m_velocityFilter->init(m_velocityFeedbackDeg);
+        m_filters.reset(m_velocitySignal, iDynTree::toEigen(m_velocityFeedbackDeg) * iDynTree::deg2rad(1.0));
     }
 
     // get the limits
@@ -491,6 +613,26 @@ bool RobotInterface::configureForceTorqueSensors(const yarp::os::Searchable& con
         return false;
     }
 
+    // the wrenches are aligned to the encoders with the timestamps of the port envelopes
+    std::string alignment = config.check("wrench_alignment", yarp::os::Value("none")).asString();
+    if(alignment != "none" && alignment != "extrapolate")
+    {
+        yError() << "[RobotInterface::configureForceTorqueSensors] The wrench alignment" << alignment
+                 << "is not supported. The available ones are: none and extrapolate.";
+        return false;
+    }
+    m_alignWrenches = alignment == "extrapolate";
+
+    m_wrenchMaxAge = config.check("wrench_max_age", yarp::os::Value(0.0)).asDouble();
+    std::string stalenessPolicy = config.check("wrench_staleness_policy", yarp::os::Value("error")).asString();
+    if(stalenessPolicy != "error" && stalenessPolicy != "warning")
+    {
+        yError() << "[RobotInterface::configureForceTorqueSensors] The staleness policy" << stalenessPolicy
+                 << "is not supported. The available ones are: error and warning.";
+        return false;
+    }
+    m_stopOnStaleWrench = stalenessPolicy == "error";
+
     m_useWrenchFilter = config.check("use_wrench_filter", yarp::os::Value("False")).asBool();
     if(m_useWrenchFilter)
     {
@@ -501,10 +643,14 @@ bool RobotInterface::configureForceTorqueSensors(const yarp::os::Searchable& con
             return false;
         }
 
-        m_leftWrenchFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(cutFrequency,
-                                                                                   sampligTime);
-        m_rightWrenchFilter = std::make_unique<iCub::ctrl::FirstOrderLowPassFilter>(cutFrequency,
-                                                                                    sampligTime);
+        m_leftWrenchInputFiltered.resize(6, 0.0);
+        m_rightWrenchInputFiltered.resize(6, 0.0);
+        if(!m_filters.addSignal(6, cutFrequency, sampligTime, m_leftWrenchSignal)
+           || !m_filters.addSignal(6, cutFrequency, sampligTime, m_rightWrenchSignal))
+        {
+            yError() << "[RobotInterface::configureForceTorqueSensors] Unable to add the wrenches to the filters.";
+            return false;
+        }
     }
     return true;
 }
@@ -512,6 +658,15 @@ bool RobotInterface::configureForceTorqueSensors(const yarp::os::Searchable& con
 bool RobotInterface::configurePIDHandler(const yarp::os::Bottle& config)
 {
     m_PIDHandler = std::make_unique<WalkingPIDHandler>();
+
+    // the joints of the simulated robot track the references ideally
+    if(m_useSimulatedRobot && !config.isNull())
+    {
+        yWarning() << "[RobotInterface::configurePIDHandler] The PIDs are ignored by the simulated robot.";
+        yarp::os::Bottle emptyConfig;
+        return m_PIDHandler->initialize(emptyConfig, m_robotDevice, m_remoteControlBoards);
+    }
+
     return m_PIDHandler->initialize(config, m_robotDevice, m_remoteControlBoards);
 }
 
@@ -525,12 +680,16 @@ bool RobotInterface::resetFilters()
     }
 
     if(m_useVelocityFilter)
-        m_velocityFilter->init(m_velocityFeedbackDeg);
+        m_filters.reset(m_velocitySignal, iDynTree::toEigen(m_velocityFeedbackRad));
 
     if(m_useWrenchFilter)
     {
-        m_leftWrenchFilter->init(m_leftWrenchInput);
-        m_rightWrenchFilter->init(m_rightWrenchInput);
+        if(!m_filters.reset(m_leftWrenchSignal, iDynTree::toEigen(m_leftWrenchInput))
+           || !m_filters.reset(m_rightWrenchSignal, iDynTree::toEigen(m_rightWrenchInput)))
+        {
+            yError() << "[RobotInterface::resetFilters] Unable to reset the wrench filters.";
+            return false;
+        }
     }
 
     return true;
@@ -544,17 +703,32 @@ bool RobotInterface::getFeedbacks(unsigned int maxAttempts)
         return false;
     }
 
+    // all the signals are filtered with a single update of the bank
     if(m_useVelocityFilter)
+        m_filters.setInput(m_velocitySignal, iDynTree::toEigen(m_velocityFeedbackRad));
+
+    if(m_useWrenchFilter)
     {
-        // filter the joint position and the velocity
-        m_velocityFeedbackDegFiltered = m_velocityFilter->filt(m_velocityFeedbackDeg);
-        for(unsigned j = 0; j < m_actuatedDOFs; ++j)
-            m_velocityFeedbackRad(j) = iDynTree::deg2rad(m_velocityFeedbackDegFiltered(j));
+        if(!m_filters.setInput(m_leftWrenchSignal, iDynTree::toEigen(m_leftWrenchInput))
+           || !m_filters.setInput(m_rightWrenchSignal, iDynTree::toEigen(m_rightWrenchInput)))
+        {
+            yError() << "[RobotInterface::getFeedbacks] Unable to set the wrenches.";
+            return false;
+        }
     }
+
+    if(!m_useVelocityFilter && !m_useWrenchFilter)
+        return true;
+
+    m_filters.filter();
+
+    if(m_useVelocityFilter)
+        m_filters.getOutput(m_velocitySignal, iDynTree::toEigen(m_velocityFeedbackRad));
+
     if(m_useWrenchFilter)
     {
-        m_leftWrenchInputFiltered = m_leftWrenchFilter->filt(m_leftWrenchInput);
-        m_rightWrenchInputFiltered = m_rightWrenchFilter->filt(m_rightWrenchInput);
+        m_filters.getOutput(m_leftWrenchSignal, iDynTree::toEigen(m_leftWrenchInputFiltered));
+        m_filters.getOutput(m_rightWrenchSignal, iDynTree::toEigen(m_rightWrenchInputFiltered));
 
         if(!iDynTree::toiDynTree(m_leftWrenchInputFiltered, m_leftWrench))
         {
@@ -867,6 +1041,26 @@ const iDynTree::Wrench& RobotInterface::getRightWrench() const
     return m_rightWrench;
 }
 
+double RobotInterface::getEncodersTimestamp() const
+{
+    return m_encodersTimestamp;
+}
+
+double RobotInterface::getEncodersAge() const
+{
+    return m_encodersAge;
+}
+
+double RobotInterface::getLeftWrenchAge() const
+{
+    return m_leftWrenchAge;
+}
+
+double RobotInterface::getRightWrenchAge() const
+{
+    return m_rightWrenchAge;
+}
+
 const iDynTree::VectorDynSize& RobotInterface::getVelocityLimits() const
 {
     return m_jointVelocitiesBounds;
@@ -917,6 +1111,11 @@ bool RobotInterface::isExternalRobotBaseUsed()
     return m_useExternalRobotBase;
 }
 
+double RobotInterface::getRealTimeFactor() const
+{
+    return m_realTimeFactor;
+}
+
 bool RobotInterface::loadCustomInteractionMode()
 {
     return setInteractionMode(m_jointInteractionMode);
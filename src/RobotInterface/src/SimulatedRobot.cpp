@@ -0,0 +1,826 @@
+/**
+ * @file SimulatedRobot.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2019 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2019
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+
+// YARP
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Core/Twist.h>
+#include <iDynTree/Core/Utils.h>
+#include <iDynTree/ModelIO/ModelLoader.h>
+#include <iDynTree/yarp/YARPEigenConversions.h>
+
+#include <WalkingControllers/RobotInterface/SimulatedRobot.h>
+#include <WalkingControllers/YarpUtilities/Helper.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    constexpr double gravityAcceleration = 9.81;
+}
+
+bool SimulatedRobot::open(yarp::os::Searchable& config)
+{
+    yarp::os::Value *axesListYarp;
+    if(!config.check("axesNames", axesListYarp))
+    {
+        yError() << "[SimulatedRobot::open] Unable to find axesNames into config file.";
+        return false;
+    }
+    if(!YarpUtilities::yarpListToStringVector(axesListYarp, m_axesList))
+    {
+        yError() << "[SimulatedRobot::open] Unable to convert yarp list into a vector of strings.";
+        return false;
+    }
+    m_actuatedDOFs = m_axesList.size();
+
+    if(!YarpUtilities::getNumberFromSearchable(config, "sampling_time", m_samplingTime))
+    {
+        yError() << "[SimulatedRobot::open] Unable to get the sampling time.";
+        return false;
+    }
+
+    // only the controlled joints are extracted from the URDF file
+    std::string model;
+    if(!YarpUtilities::getStringFromSearchable(config, "model", model))
+    {
+        yError() << "[SimulatedRobot::open] Unable to get the path of the model.";
+        return false;
+    }
+    iDynTree::ModelLoader loader;
+    if(!loader.loadReducedModelFromFile(model, m_axesList) || !m_kinDyn.loadRobotModel(loader.model()))
+    {
+        yError() << "[SimulatedRobot::open] Unable to load the model from " << model;
+        return false;
+    }
+
+    std::string leftFootFrame = config.check("left_foot_frame", yarp::os::Value("l_sole")).asString();
+    std::string rightFootFrame = config.check("right_foot_frame", yarp::os::Value("r_sole")).asString();
+    m_leftFootFrame = m_kinDyn.model().getFrameIndex(leftFootFrame);
+    m_rightFootFrame = m_kinDyn.model().getFrameIndex(rightFootFrame);
+    if(m_leftFootFrame == iDynTree::FRAME_INVALID_INDEX || m_rightFootFrame == iDynTree::FRAME_INVALID_INDEX)
+    {
+        yError() << "[SimulatedRobot::open] Unable to find the frames named: " << leftFootFrame
+                 << "and" << rightFootFrame;
+        return false;
+    }
+
+    m_contactHeight = config.check("contact_height", yarp::os::Value(0.005)).asDouble();
+    double velocityLimit = config.check("max_joint_velocity", yarp::os::Value(100.0)).asDouble();
+
+    // the limits of the joints are given by the model
+    m_positionLowerLimits.resize(m_actuatedDOFs);
+    m_positionUpperLimits.resize(m_actuatedDOFs);
+    m_velocityLimits.resize(m_actuatedDOFs);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+    {
+        iDynTree::IJointConstPtr joint = m_kinDyn.model().getJoint(m_kinDyn.model().getJointIndex(m_axesList[i]));
+        double minAngle = -M_PI, maxAngle = M_PI;
+        if(joint->hasPosLimits())
+            joint->getPosLimits(0, minAngle, maxAngle);
+
+        m_positionLowerLimits(i) = iDynTree::rad2deg(minAngle);
+        m_positionUpperLimits(i) = iDynTree::rad2deg(maxAngle);
+        m_velocityLimits(i) = velocityLimit;
+    }
+
+    m_jointPositions.resize(m_actuatedDOFs);
+    m_jointVelocities.resize(m_actuatedDOFs);
+    m_velocityReferences.resize(m_actuatedDOFs);
+    m_speedReferences.resize(m_actuatedDOFs);
+    m_jointVelocities.zero();
+    m_velocityReferences.zero();
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        m_speedReferences(i) = 10.0;
+    m_controlModes.assign(m_actuatedDOFs, VOCAB_CM_POSITION);
+    m_interactionModes.assign(m_actuatedDOFs, yarp::dev::InteractionModeEnum::VOCAB_IM_STIFF);
+
+    std::string portName;
+    if(!YarpUtilities::getStringFromSearchable(config, "left_foot_wrench_port_name", portName)
+       || !m_leftWrenchPort.open(portName))
+    {
+        yError() << "[SimulatedRobot::open] Unable to open the left foot wrench port.";
+        return false;
+    }
+    if(!YarpUtilities::getStringFromSearchable(config, "right_foot_wrench_port_name", portName)
+       || !m_rightWrenchPort.open(portName))
+    {
+        yError() << "[SimulatedRobot::open] Unable to open the right foot wrench port.";
+        return false;
+    }
+    m_leftWrench.resize(6, 0.0);
+    m_rightWrench.resize(6, 0.0);
+
+    // the robot starts at rest in the zero configuration, the left foot is placed in the origin
+    m_isLeftFootStance = true;
+    m_stanceFootToWorldTransform = iDynTree::Transform::Identity();
+    iDynTree::VectorDynSize jointPositions(m_actuatedDOFs);
+    jointPositions.zero();
+    if(!updateState(jointPositions, true))
+    {
+        yError() << "[SimulatedRobot::open] Unable to evaluate the initial state of the robot.";
+        return false;
+    }
+
+    return true;
+}
+
+bool SimulatedRobot::close()
+{
+    m_leftWrenchPort.close();
+    m_rightWrenchPort.close();
+    return true;
+}
+
+bool SimulatedRobot::updateState(const iDynTree::VectorDynSize& jointPositions, bool isStatic)
+{
+    for(int i = 0; i < m_actuatedDOFs; i++)
+    {
+        double position = iDynTree::deg2rad(std::min(std::max(iDynTree::rad2deg(jointPositions(i)),
+                                                              m_positionLowerLimits(i)),
+                                                     m_positionUpperLimits(i)));
+        m_jointVelocities(i) = isStatic ? 0.0 : (position - m_jointPositions(i)) / m_samplingTime;
+        m_jointPositions(i) = position;
+    }
+
+    // the state is stamped with the wall-clock time, so the age of the feedbacks does not
+    // depend on the real time factor
+    m_time = yarp::os::Time::now();
+
+    return updateWrenches(isStatic);
+}
+
+bool SimulatedRobot::updateWrenches(bool isStatic)
+{
+    // the kinematics is evaluated w.r.t. the base link, the world is attached to the stance foot
+    iDynTree::Vector3 gravity;
+    gravity.zero();
+    gravity(2) = -gravityAcceleration;
+    iDynTree::Twist baseVelocity;
+    baseVelocity.zero();
+    if(!m_kinDyn.setRobotState(iDynTree::Transform::Identity(), m_jointPositions, baseVelocity,
+                               m_jointVelocities, gravity))
+    {
+        yError() << "[SimulatedRobot::updateWrenches] Unable to set the state of the robot.";
+        return false;
+    }
+
+    iDynTree::Transform leftFootToBaseTransform = m_kinDyn.getWorldTransform(m_leftFootFrame);
+    iDynTree::Transform rightFootToBaseTransform = m_kinDyn.getWorldTransform(m_rightFootFrame);
+    iDynTree::Transform baseToWorldTransform = m_stanceFootToWorldTransform
+        * (m_isLeftFootStance ? leftFootToBaseTransform : rightFootToBaseTransform).inverse();
+    iDynTree::Transform leftFootToWorldTransform = baseToWorldTransform * leftFootToBaseTransform;
+    iDynTree::Transform rightFootToWorldTransform = baseToWorldTransform * rightFootToBaseTransform;
+
+    // the CoM acceleration is evaluated with finite differences
+    m_secondPreviousCoMPosition = m_previousCoMPosition;
+    m_previousCoMPosition = m_comPosition;
+    m_comPosition = baseToWorldTransform * m_kinDyn.getCenterOfMassPosition();
+    if(isStatic)
+    {
+        m_previousCoMPosition = m_comPosition;
+        m_secondPreviousCoMPosition = m_comPosition;
+    }
+    Eigen::Vector3d comAcceleration = (iDynTree::toEigen(m_comPosition) - 2 * iDynTree::toEigen(m_previousCoMPosition)
+                                       + iDynTree::toEigen(m_secondPreviousCoMPosition))
+        / (m_samplingTime * m_samplingTime);
+
+    // ZMP of the linear inverted pendulum, the ground is at the height of the stance foot
+    double groundHeight = m_stanceFootToWorldTransform.getPosition()(2);
+    Eigen::Vector2d zmp = iDynTree::toEigen(m_comPosition).head<2>()
+        - (m_comPosition(2) - groundHeight) / gravityAcceleration * comAcceleration.head<2>();
+
+    Eigen::Vector2d leftFootPosition = iDynTree::toEigen(leftFootToWorldTransform.getPosition()).head<2>();
+    Eigen::Vector2d rightFootPosition = iDynTree::toEigen(rightFootToWorldTransform.getPosition()).head<2>();
+    const iDynTree::Transform& swingFootToWorldTransform = m_isLeftFootStance ? rightFootToWorldTransform
+        : leftFootToWorldTransform;
+    bool isDoubleSupport = swingFootToWorldTransform.getPosition()(2) - groundHeight < m_contactHeight;
+
+    // share of the weight supported by the right foot, in double support it is given by the
+    // projection of the ZMP on the segment connecting the feet
+    double rightFootShare = m_isLeftFootStance ? 0.0 : 1.0;
+    Eigen::Vector2d feetDistance = rightFootPosition - leftFootPosition;
+    if(isDoubleSupport && feetDistance.squaredNorm() > 1e-6)
+        rightFootShare = std::min(std::max(feetDistance.dot(zmp - leftFootPosition) / feetDistance.squaredNorm(),
+                                           0.0), 1.0);
+
+    // the stance foot is changed when the ZMP is closer to the other foot
+    if(isDoubleSupport && (m_isLeftFootStance == (rightFootShare > 0.5)))
+    {
+        m_isLeftFootStance = !m_isLeftFootStance;
+        m_stanceFootToWorldTransform = m_isLeftFootStance ? leftFootToWorldTransform : rightFootToWorldTransform;
+    }
+
+    // the centers of pressure of the feet are shifted by the same offset so that their
+    // weighted average is the ZMP
+    Eigen::Vector2d copOffset = zmp - leftFootPosition - rightFootShare * feetDistance;
+    double mass = m_kinDyn.model().getTotalMass();
+    Eigen::Vector3d force(mass * comAcceleration(0), mass * comAcceleration(1), mass * gravityAcceleration);
+
+    auto computeFootWrench = [&](const iDynTree::Transform& footToWorldTransform, double share,
+                                 yarp::sig::Vector& wrench)
+    {
+        Eigen::Matrix3d rotation = iDynTree::toEigen(footToWorldTransform.getRotation());
+        Eigen::Vector3d footPosition = iDynTree::toEigen(footToWorldTransform.getPosition());
+        Eigen::Vector3d centerOfPressure = footPosition;
+        centerOfPressure.head<2>() += copOffset;
+        Eigen::Vector3d footForce = share * force;
+
+        iDynTree::toEigen(wrench).head<3>() = rotation.transpose() * footForce;
+        iDynTree::toEigen(wrench).tail<3>() = rotation.transpose() * (centerOfPressure - footPosition).cross(footForce);
+    };
+
+    computeFootWrench(leftFootToWorldTransform, 1 - rightFootShare, m_leftWrench);
+    computeFootWrench(rightFootToWorldTransform, rightFootShare, m_rightWrench);
+
+    return true;
+}
+
+void SimulatedRobot::publishWrenches()
+{
+    m_wrenchStamp.update(m_time);
+
+    yarp::sig::Vector& leftWrench = m_leftWrenchPort.prepare();
+    leftWrench = m_leftWrench;
+    m_leftWrenchPort.setEnvelope(m_wrenchStamp);
+    m_leftWrenchPort.write();
+
+    yarp::sig::Vector& rightWrench = m_rightWrenchPort.prepare();
+    rightWrench = m_rightWrench;
+    m_rightWrenchPort.setEnvelope(m_wrenchStamp);
+    m_rightWrenchPort.write();
+}
+
+bool SimulatedRobot::isValidJoint(int joint) const
+{
+    return joint >= 0 && joint < m_actuatedDOFs;
+}
+
+bool SimulatedRobot::moveJoints(const int n_joint, const int* joints, const double* refs, bool isRelative)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    iDynTree::VectorDynSize jointPositions = m_jointPositions;
+    for(int i = 0; i < n_joint; i++)
+    {
+        int joint = joints == nullptr ? i : joints[i];
+        if(!isValidJoint(joint))
+        {
+            yError() << "[SimulatedRobot::moveJoints] The joint index " << joint << "is not valid.";
+            return false;
+        }
+
+        jointPositions(joint) = iDynTree::deg2rad(refs[i]) + (isRelative ? jointPositions(joint) : 0.0);
+    }
+
+    // the targets are reached in one step and the robot is at rest
+    return updateState(jointPositions, true);
+}
+
+bool SimulatedRobot::setJointPositions(const int n_joint, const int* joints, const double* refs)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    iDynTree::VectorDynSize jointPositions = m_jointPositions;
+    for(int i = 0; i < n_joint; i++)
+    {
+        int joint = joints == nullptr ? i : joints[i];
+        if(!isValidJoint(joint))
+        {
+            yError() << "[SimulatedRobot::setJointPositions] The joint index " << joint << "is not valid.";
+            return false;
+        }
+
+        jointPositions(joint) = iDynTree::deg2rad(refs[i]);
+    }
+
+    return updateState(jointPositions, false);
+}
+
+bool SimulatedRobot::setJointVelocities(const int n_joint, const int* joints, const double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    for(int i = 0; i < n_joint; i++)
+    {
+        int joint = joints == nullptr ? i : joints[i];
+        if(!isValidJoint(joint))
+        {
+            yError() << "[SimulatedRobot::setJointVelocities] The joint index " << joint << "is not valid.";
+            return false;
+        }
+
+        double velocity = std::min(std::max(spds[i], -m_velocityLimits(joint)), m_velocityLimits(joint));
+        m_velocityReferences(joint) = iDynTree::deg2rad(velocity);
+    }
+
+    // the references are integrated for one sampling time
+    iDynTree::VectorDynSize jointPositions = m_jointPositions;
+    iDynTree::toEigen(jointPositions) += iDynTree::toEigen(m_velocityReferences) * m_samplingTime;
+    return updateState(jointPositions, false);
+}
+
+bool SimulatedRobot::getAxes(int* ax)
+{
+    *ax = m_actuatedDOFs;
+    return true;
+}
+
+bool SimulatedRobot::resetEncoder(int j)
+{
+    yError() << "[SimulatedRobot::resetEncoder] The encoders of the simulated robot cannot be reset.";
+    return false;
+}
+
+bool SimulatedRobot::resetEncoders()
+{
+    yError() << "[SimulatedRobot::resetEncoders] The encoders of the simulated robot cannot be reset.";
+    return false;
+}
+
+bool SimulatedRobot::setEncoder(int j, double val)
+{
+    yError() << "[SimulatedRobot::setEncoder] The encoders of the simulated robot cannot be set.";
+    return false;
+}
+
+bool SimulatedRobot::setEncoders(const double* vals)
+{
+    yError() << "[SimulatedRobot::setEncoders] The encoders of the simulated robot cannot be set.";
+    return false;
+}
+
+bool SimulatedRobot::getEncoder(int j, double* v)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(j))
+        return false;
+
+    *v = iDynTree::rad2deg(m_jointPositions(j));
+    return true;
+}
+
+bool SimulatedRobot::getEncoders(double* encs)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        encs[i] = iDynTree::rad2deg(m_jointPositions(i));
+
+    // the force torque sensors are sampled together with the encoders
+    publishWrenches();
+    return true;
+}
+
+bool SimulatedRobot::getEncoderSpeed(int j, double* sp)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(j))
+        return false;
+
+    *sp = iDynTree::rad2deg(m_jointVelocities(j));
+    return true;
+}
+
+bool SimulatedRobot::getEncoderSpeeds(double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        spds[i] = iDynTree::rad2deg(m_jointVelocities(i));
+    return true;
+}
+
+bool SimulatedRobot::getEncoderAcceleration(int j, double* spds)
+{
+    if(!isValidJoint(j))
+        return false;
+
+    *spds = 0.0;
+    return true;
+}
+
+bool SimulatedRobot::getEncoderAccelerations(double* accs)
+{
+    std::fill(accs, accs + m_actuatedDOFs, 0.0);
+    return true;
+}
+
+bool SimulatedRobot::getEncodersTimed(double* encs, double* time)
+{
+    if(!getEncoders(encs))
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::fill(time, time + m_actuatedDOFs, m_time);
+    return true;
+}
+
+bool SimulatedRobot::getEncoderTimed(int j, double* encs, double* time)
+{
+    if(!getEncoder(j, encs))
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    *time = m_time;
+    return true;
+}
+
+bool SimulatedRobot::positionMove(int j, double ref)
+{
+    return moveJoints(1, &j, &ref, false);
+}
+
+bool SimulatedRobot::positionMove(const double* refs)
+{
+    return moveJoints(m_actuatedDOFs, nullptr, refs, false);
+}
+
+bool SimulatedRobot::positionMove(const int n_joint, const int* joints, const double* refs)
+{
+    return moveJoints(n_joint, joints, refs, false);
+}
+
+bool SimulatedRobot::relativeMove(int j, double delta)
+{
+    return moveJoints(1, &j, &delta, true);
+}
+
+bool SimulatedRobot::relativeMove(const double* deltas)
+{
+    return moveJoints(m_actuatedDOFs, nullptr, deltas, true);
+}
+
+bool SimulatedRobot::relativeMove(const int n_joint, const int* joints, const double* deltas)
+{
+    return moveJoints(n_joint, joints, deltas, true);
+}
+
+bool SimulatedRobot::checkMotionDone(int j, bool* flag)
+{
+    *flag = true;
+    return isValidJoint(j);
+}
+
+bool SimulatedRobot::checkMotionDone(bool* flag)
+{
+    *flag = true;
+    return true;
+}
+
+bool SimulatedRobot::checkMotionDone(const int n_joint, const int* joints, bool* flag)
+{
+    *flag = true;
+    return true;
+}
+
+bool SimulatedRobot::setRefSpeed(int j, double sp)
+{
+    return setRefSpeeds(1, &j, &sp);
+}
+
+bool SimulatedRobot::setRefSpeeds(const double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        m_speedReferences(i) = spds[i];
+    return true;
+}
+
+bool SimulatedRobot::setRefSpeeds(const int n_joint, const int* joints, const double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        m_speedReferences(joints[i]) = spds[i];
+    }
+    return true;
+}
+
+bool SimulatedRobot::setRefAcceleration(int j, double acc)
+{
+    // the joints track the references ideally, the accelerations are not used
+    return isValidJoint(j);
+}
+
+bool SimulatedRobot::setRefAccelerations(const double* accs)
+{
+    return true;
+}
+
+bool SimulatedRobot::setRefAccelerations(const int n_joint, const int* joints, const double* accs)
+{
+    return true;
+}
+
+bool SimulatedRobot::getRefSpeed(int j, double* ref)
+{
+    return getRefSpeeds(1, &j, ref);
+}
+
+bool SimulatedRobot::getRefSpeeds(double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        spds[i] = m_speedReferences(i);
+    return true;
+}
+
+bool SimulatedRobot::getRefSpeeds(const int n_joint, const int* joints, double* spds)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        spds[i] = m_speedReferences(joints[i]);
+    }
+    return true;
+}
+
+bool SimulatedRobot::getRefAcceleration(int j, double* acc)
+{
+    *acc = 0.0;
+    return isValidJoint(j);
+}
+
+bool SimulatedRobot::getRefAccelerations(double* accs)
+{
+    std::fill(accs, accs + m_actuatedDOFs, 0.0);
+    return true;
+}
+
+bool SimulatedRobot::getRefAccelerations(const int n_joint, const int* joints, double* accs)
+{
+    std::fill(accs, accs + n_joint, 0.0);
+    return true;
+}
+
+bool SimulatedRobot::stop(int j)
+{
+    return stop(1, &j);
+}
+
+bool SimulatedRobot::stop()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_velocityReferences.zero();
+    return true;
+}
+
+bool SimulatedRobot::stop(const int n_joint, const int* joints)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        m_velocityReferences(joints[i]) = 0.0;
+    }
+    return true;
+}
+
+bool SimulatedRobot::getTargetPosition(const int joint, double* ref)
+{
+    return getEncoder(joint, ref);
+}
+
+bool SimulatedRobot::getTargetPositions(double* refs)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        refs[i] = iDynTree::rad2deg(m_jointPositions(i));
+    return true;
+}
+
+bool SimulatedRobot::getTargetPositions(const int n_joint, const int* joints, double* refs)
+{
+    for(int i = 0; i < n_joint; i++)
+        if(!getEncoder(joints[i], refs + i))
+            return false;
+    return true;
+}
+
+bool SimulatedRobot::setPosition(int j, double ref)
+{
+    return setJointPositions(1, &j, &ref);
+}
+
+bool SimulatedRobot::setPositions(const int n_joint, const int* joints, const double* refs)
+{
+    return setJointPositions(n_joint, joints, refs);
+}
+
+bool SimulatedRobot::setPositions(const double* refs)
+{
+    return setJointPositions(m_actuatedDOFs, nullptr, refs);
+}
+
+bool SimulatedRobot::getRefPosition(const int joint, double* ref)
+{
+    return getTargetPosition(joint, ref);
+}
+
+bool SimulatedRobot::getRefPositions(double* refs)
+{
+    return getTargetPositions(refs);
+}
+
+bool SimulatedRobot::getRefPositions(const int n_joint, const int* joints, double* refs)
+{
+    return getTargetPositions(n_joint, joints, refs);
+}
+
+bool SimulatedRobot::velocityMove(int j, double sp)
+{
+    return setJointVelocities(1, &j, &sp);
+}
+
+bool SimulatedRobot::velocityMove(const double* sp)
+{
+    return setJointVelocities(m_actuatedDOFs, nullptr, sp);
+}
+
+bool SimulatedRobot::velocityMove(const int n_joint, const int* joints, const double* spds)
+{
+    return setJointVelocities(n_joint, joints, spds);
+}
+
+bool SimulatedRobot::getRefVelocity(const int joint, double* vel)
+{
+    return getRefVelocities(1, &joint, vel);
+}
+
+bool SimulatedRobot::getRefVelocities(double* vels)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < m_actuatedDOFs; i++)
+        vels[i] = iDynTree::rad2deg(m_velocityReferences(i));
+    return true;
+}
+
+bool SimulatedRobot::getRefVelocities(const int n_joint, const int* joints, double* vels)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        vels[i] = iDynTree::rad2deg(m_velocityReferences(joints[i]));
+    }
+    return true;
+}
+
+bool SimulatedRobot::getControlMode(int j, int* mode)
+{
+    return getControlModes(1, &j, mode);
+}
+
+bool SimulatedRobot::getControlModes(int* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::copy(m_controlModes.begin(), m_controlModes.end(), modes);
+    return true;
+}
+
+bool SimulatedRobot::getControlModes(const int n_joint, const int* joints, int* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        modes[i] = m_controlModes[joints[i]];
+    }
+    return true;
+}
+
+bool SimulatedRobot::setControlMode(const int j, const int mode)
+{
+    int controlMode = mode;
+    return setControlModes(1, &j, &controlMode);
+}
+
+bool SimulatedRobot::setControlModes(const int n_joint, const int* joints, int* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        m_controlModes[joints[i]] = modes[i];
+        m_velocityReferences(joints[i]) = 0.0;
+    }
+    return true;
+}
+
+bool SimulatedRobot::setControlModes(int* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::copy(modes, modes + m_actuatedDOFs, m_controlModes.begin());
+    m_velocityReferences.zero();
+    return true;
+}
+
+bool SimulatedRobot::setLimits(int axis, double min, double max)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(axis) || min > max)
+        return false;
+
+    m_positionLowerLimits(axis) = min;
+    m_positionUpperLimits(axis) = max;
+    return true;
+}
+
+bool SimulatedRobot::getLimits(int axis, double* min, double* max)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(axis))
+        return false;
+
+    *min = m_positionLowerLimits(axis);
+    *max = m_positionUpperLimits(axis);
+    return true;
+}
+
+bool SimulatedRobot::setVelLimits(int axis, double min, double max)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(axis) || max < 0)
+        return false;
+
+    m_velocityLimits(axis) = max;
+    return true;
+}
+
+bool SimulatedRobot::getVelLimits(int axis, double* min, double* max)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if(!isValidJoint(axis))
+        return false;
+
+    *min = 0.0;
+    *max = m_velocityLimits(axis);
+    return true;
+}
+
+bool SimulatedRobot::getInteractionMode(int axis, yarp::dev::InteractionModeEnum* mode)
+{
+    return getInteractionModes(1, &axis, mode);
+}
+
+bool SimulatedRobot::getInteractionModes(int n_joints, int* joints, yarp::dev::InteractionModeEnum* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joints; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        modes[i] = m_interactionModes[joints[i]];
+    }
+    return true;
+}
+
+bool SimulatedRobot::getInteractionModes(yarp::dev::InteractionModeEnum* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::copy(m_interactionModes.begin(), m_interactionModes.end(), modes);
+    return true;
+}
+
+bool SimulatedRobot::setInteractionMode(int axis, yarp::dev::InteractionModeEnum mode)
+{
+    return setInteractionModes(1, &axis, &mode);
+}
+
+bool SimulatedRobot::setInteractionModes(int n_joints, int* joints, yarp::dev::InteractionModeEnum* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for(int i = 0; i < n_joints; i++)
+    {
+        if(!isValidJoint(joints[i]))
+            return false;
+        m_interactionModes[joints[i]] = modes[i];
+    }
+    return true;
+}
+
+bool SimulatedRobot::setInteractionModes(yarp::dev::InteractionModeEnum* modes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::copy(modes, modes + m_actuatedDOFs, m_interactionModes.begin());
+    return true;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file ConvexHullCache.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_SIMPLIFIED_MODEL_CONTROLLERS_CONVEX_HULL_CACHE_H
+#define WALKING_CONTROLLERS_SIMPLIFIED_MODEL_CONTROLLERS_CONVEX_HULL_CACHE_H
+
+// std
+#include <list>
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+// iDynTree
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/MatrixDynSize.h>
+#include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/ConvexHullHelpers.h>
+
+namespace WalkingControllers
+{
+
+    /**
+     * ConvexHullCache stores the last support polygons (A p <= b) evaluated by
+     * iDynTree::ConvexHullProjectionConstraint. Each polygon is expressed in the frame of the
+     * reference foot (the left foot in double support, the stance foot in single support) and it
+     * is identified by the contact mode and by the quantised relative pose of the feet.
+     * The constraints in the world frame are obtained applying the planar rigid motion of the
+     * reference foot. The least recently used polygon is dropped when the cache is full.
+     */
+    class ConvexHullCache
+    {
+        /**
+         * Key of a cached polygon.
+         */
+        struct Key
+        {
+            bool isDoubleSupport; /**< True if both feet are in contact. */
+            long x; /**< Quantised x position of the right foot w.r.t. the left foot. */
+            long y; /**< Quantised y position of the right foot w.r.t. the left foot. */
+            long yaw; /**< Quantised yaw angle of the right foot w.r.t. the left foot. */
+
+            bool operator==(const Key& other) const;
+        };
+
+        /**
+         * Cached polygon.
+         */
+        struct Entry
+        {
+            Key key; /**< Key of the polygon. */
+            Eigen::MatrixXd A; /**< Constraints matrix expressed in the reference foot frame. */
+            Eigen::VectorXd b; /**< Constraints vector expressed in the reference foot frame. */
+        };
+
+        std::list<Entry> m_entries; /**< Cached polygons. The most recently used is the first one. */
+        size_t m_capacity; /**< Maximum number of cached polygons. */
+
+        double m_positionResolution; /**< Quantisation step of the relative position (m). */
+        double m_angularResolution; /**< Quantisation step of the relative yaw angle (rad). */
+
+        iDynTree::Polygon m_footPolygon; /**< Polygon of the foot. */
+        iDynTree::ConvexHullProjectionConstraint m_convexHullComputer; /**< iDynTree convex hull helper. */
+
+        bool m_isInitialized{false}; /**< True if the cache is initialized. */
+
+        /**
+         * Evaluate the key of the polygon.
+         * @param isDoubleSupport true if both feet are in contact;
+         * @param leftFoot homogeneous transformation of the left foot;
+         * @param rightFoot homogeneous transformation of the right foot.
+         * @return the key.
+         */
+        Key evaluateKey(bool isDoubleSupport,
+                        const iDynTree::Transform& leftFoot,
+                        const iDynTree::Transform& rightFoot) const;
+
+        /**
+         * Get the polygon associated to a key. If the polygon is not cached it is evaluated.
+         * The returned entry becomes the most recently used.
+         * @param key key of the polygon;
+         * @return pointer to the entry (nullptr in case of failure).
+         */
+        const Entry* getEntry(const Key& key);
+
+        /**
+         * Build the polygon associated to a key.
+         * @param key key of the polygon;
+         * @param entry entry containing the polygon.
+         * @return true/false in case of success/failure.
+         */
+        bool buildConvexHull(const Key& key, Entry& entry);
+
+    public:
+
+        /**
+         * Initialize the cache.
+         * @param footPolygon polygon of the foot (expressed in the foot frame);
+         * @param capacity maximum number of cached polygons;
+         * @param positionResolution quantisation step of the relative position (m);
+         * @param angularResolution quantisation step of the relative yaw angle (rad).
+         * @return true/false in case of success/failure.
+         */
+        bool initialize(const iDynTree::Polygon& footPolygon, int capacity,
+                        double positionResolution, double angularResolution);
+
+        /**
+         * Get the support polygon constraints (A p <= b) expressed in the world frame.
+         * @param leftFoot homogeneous transformation of the left foot;
+         * @param rightFoot homogeneous transformation of the right foot;
+         * @param leftInContact true if the left foot is in contact;
+         * @param rightInContact true if the right foot is in contact;
+         * @param A constraints matrix;
+         * @param b constraints vector.
+         * @return true/false in case of success/failure.
+         */
+        bool getConstraints(const iDynTree::Transform& leftFoot,
+                            const iDynTree::Transform& rightFoot,
+                            bool leftInContact, bool rightInContact,
+                            iDynTree::MatrixDynSize& A, iDynTree::VectorDynSize& b);
+
+        /**
+         * Evaluate and store the polygon associated to a contact configuration without
+         * computing the constraints in the world frame. It is useful to evaluate the polygon
+         * of the next phase in advance.
+         * @param leftFoot homogeneous transformation of the left foot;
+         * @param rightFoot homogeneous transformation of the right foot;
+         * @param leftInContact true if the left foot is in contact;
+         * @param rightInContact true if the right foot is in contact.
+         * @return true/false in case of success/failure.
+         */
+        bool prefetch(const iDynTree::Transform& leftFoot,
+                      const iDynTree::Transform& rightFoot,
+                      bool leftInContact, bool rightInContact);
+
+        /**
+         * Clear the cache.
+         */
+        void clear();
+    };
+};
+
+#endif
@@ -26,9 +26,11 @@
 
 #include <unordered_map>
 #include <deque>
+#include <vector>
 
 // solver
 #include <WalkingControllers/SimplifiedModelControllers/MPCSolver.h>
+#include <WalkingControllers/SimplifiedModelControllers/ConvexHullCache.h>
 
 namespace WalkingControllers
 {
@@ -73,8 +75,34 @@ namespace WalkingControllers
         std::pair<bool, bool> m_feetStatus; /**< Current status of the feet. Left and Right. True is used
                                                if the foot is in contact. */
 
-        iDynTree::ConvexHullProjectionConstraint m_convexHullComputer; /**<iDynTree convex hull helper. */
-        std::vector<iDynTree::Polygon> m_feetPolygons; /**<Vector containing the polygon of each foot (left and right). */
+        ConvexHullCache m_convexHullCache; /**< Cache of the support polygons. */
+        iDynTree::MatrixDynSize m_convexHullMatrix; /**< Current convex hull constraints matrix (A p <= b). */
+        iDynTree::VectorDynSize m_convexHullVector; /**< Current convex hull constraints vector (A p <= b). */
+        bool m_isNextConvexHullEvaluated{false}; /**< True if the convex hull of the next phase is already in the cache. */
+
+        /**
+         * Support polygon constraints (A p <= b) of a contact phase of the planned trajectory.
+         * All the stages of the horizon that belong to the phase share the same constraints.
+         */
+        struct ConvexHullInterval
+        {
+            iDynTree::MatrixDynSize A; /**< Constraints matrix. */
+            iDynTree::VectorDynSize b; /**< Constraints vector. */
+        };
+
+        bool m_useHorizonConvexHull; /**< True if the convex hull constraint is applied to all the
+                                        inputs of the horizon. Otherwise only the first input is constrained. */
+        int m_maxNumberOfConvexHullEdges; /**< Number of constraints associated to each stage of the horizon.
+                                             Unused rows are padded with trivial constraints. */
+        std::vector<ConvexHullInterval> m_convexHullIntervals; /**< Support polygons of the planned phases
+                                                                  (the vector is never shrunk). */
+        size_t m_numberOfConvexHullIntervals{0}; /**< Number of phases of the current plan. */
+        size_t m_currentConvexHullInterval{0}; /**< Index of the current phase. */
+        bool m_isConvexHullPlanEvaluated{false}; /**< True if the polygons of the current plan are evaluated. */
+        std::vector<int> m_stageConvexHullIntervals; /**< Phase associated to each stage of the horizon
+                                                        (-1 if not assigned). */
+        iDynTree::MatrixDynSize m_horizonConvexHullMatrix; /**< Stacked constraints matrix of all the stages. */
+        iDynTree::VectorDynSize m_horizonConvexHullVector; /**< Stacked constraints vector of all the stages. */
 
         /**
          * Pointer to the current MPCSolver.
@@ -84,6 +112,13 @@ namespace WalkingControllers
 
         iDynTree::Vector2 m_output; /**< Vector containing the output of the controller. */
 
+        bool m_useTimeBudget; /**< True if the solver is stopped when the time budget expires. */
+        double m_maximumTimeBudget; /**< Maximum time that can be spent by the solver in one iteration (seconds). */
+        int m_maxIterations; /**< Maximum number of iterations of the solver. */
+        double m_timeBudget; /**< Time budget for the current iteration (seconds). */
+        double m_averageIterationTime{0.0}; /**< Estimate of the time required by a single iteration of the solver (seconds). */
+        bool m_isSolutionConverged{false}; /**< True if the last solution is converged. */
+
         /**
          * Initialize the quantities useful in the inequality constraints evaluation.
          * @param config yarp searchable configuration variable.
@@ -174,20 +209,55 @@ namespace WalkingControllers
         iDynTree::Triplets evaluateEqualConstraintsInputSubmatrix(const iDynTree::Triplets& inputDynamicsMatrix);
 
         /**
-         * Build the convex hull for double support phase.
-         * @param leftFootTransform structure containing the homogeneous transformation of the left foot;
-         * @param leftFootTransform structure containing the homogeneous transformation of the right foot;
+         * Evaluate in advance the convex hull of the next phase. In this way the convex hull
+         * is not computed when the phase changes.
+         * @param leftFoot deque containing the homogeneous transformation of the left foot;
+         * @param rightFoot deque containing the homogeneous transformation of the right foot;
+         * @param leftInContact deque containing information about the state of the left foot;
+         * @param rightInContact deque containing information about the state of the right foot.
          * @return true/false in case of success/failure.
          */
-        bool buildConvexHull(const iDynTree::Transform& leftFootTransform,
-                             const iDynTree::Transform& rightFootTransform);
+        bool prefetchNextConvexHull(const std::deque<iDynTree::Transform>& leftFoot,
+                                    const std::deque<iDynTree::Transform>& rightFoot,
+                                    const std::deque<bool>& leftInContact,
+                                    const std::deque<bool>& rightInContact);
 
         /**
-         * Build the convex hull for single support phase.
-         * @param footTransform structure containing the homogeneous transformation of the stance foot.
+         * Evaluate the support polygons of all the phases of the planned trajectory.
+         * @param leftFoot deque containing the homogeneous transformation of the left foot;
+         * @param rightFoot deque containing the homogeneous transformation of the right foot;
+         * @param leftInContact deque containing information about the state of the left foot;
+         * @param rightInContact deque containing information about the state of the right foot.
          * @return true/false in case of success/failure.
          */
-        bool buildConvexHull(const iDynTree::Transform& footTransformfoot);
+        bool evaluateConvexHullPlan(const std::deque<iDynTree::Transform>& leftFoot,
+                                    const std::deque<iDynTree::Transform>& rightFoot,
+                                    const std::deque<bool>& leftInContact,
+                                    const std::deque<bool>& rightInContact);
+
+        /**
+         * Set the convex hull constraint on all the inputs of the horizon. The solver is
+         * instantiated only once since the number of constraints does not depend on the phase.
+         * @param leftFoot deque containing the homogeneous transformation of the left foot;
+         * @param rightFoot deque containing the homogeneous transformation of the right foot;
+         * @param leftInContact deque containing information about the state of the left foot;
+         * @param rightInContact deque containing information about the state of the right foot;
+         * @param resetTrajectory true if a new trajectory is merged.
+         * @return true/false in case of success/failure.
+         */
+        bool setHorizonConvexHullConstraint(const std::deque<iDynTree::Transform>& leftFoot,
+                                            const std::deque<iDynTree::Transform>& rightFoot,
+                                            const std::deque<bool>& leftInContact,
+                                            const std::deque<bool>& rightInContact,
+                                            const bool& resetTrajectory);
+
+        /**
+         * Evaluate the signed distance between a point and the nearest edge of the current
+         * convex hull (positive inside the convex hull).
+         * @param point the point.
+         * @return the margin.
+         */
+        double evaluateConvexHullMargin(const iDynTree::Vector2& point) const;
 
     public:
 
@@ -200,7 +270,8 @@ namespace WalkingControllers
 
         /**
          * If the phase (DS or SS) is changed the new convex hull is evaluated and a new MPCSolver
-         * is initialize.
+         * is initialize. If the horizon convex hull is used (use_horizon_convex_hull) each input of the
+         * horizon is constrained to the support polygon of the phase it belongs to.
          * @param leftFoot deque containing the homogeneous transformation of the left foot during
          * the trajectory;
          * @param rightFoot deque containing the homogeneous transformation of the right foot during
@@ -208,13 +279,15 @@ namespace WalkingControllers
          * @param leftInContact deque containing information about the state of the left foot
          * (stance = true, swing = false);
          * @param rightInContact deque containing information about the state of the left foot
-         * (stance = true, swing = false).
+         * (stance = true, swing = false);
+         * @param resetTrajectory set equal to true if a new trajectory is merged.
          * @return true/false in case of success/failure.
          */
         bool setConvexHullConstraint(const std::deque<iDynTree::Transform>& leftFoot,
                                      const std::deque<iDynTree::Transform>& rightFoot,
                                      const std::deque<bool>& leftInContact,
-                                     const std::deque<bool>& rightInContact);
+                                     const std::deque<bool>& rightInContact,
+                                     const bool& resetTrajectory);
 
         /**
          * Set the feedback.
@@ -232,12 +305,36 @@ namespace WalkingControllers
         bool setReferenceSignal(const std::deque<iDynTree::Vector2>& referenceSignal,
                                 const bool& resetTrajectory);
 
+        /**
+         * Set the time left in the current control cycle. If the time budget is enabled
+         * (use_time_budget) the solver is stopped as soon as the minimum between the remaining
+         * time and the maximum time budget expires.
+         * @param remainingTime time left in the current control cycle (seconds).
+         */
+        void setTimeBudget(const double& remainingTime);
+
         /**
          * Solve the Optimization problem. If the MPCSolver is not set It will be initialized.
+         * If the time budget is enabled and the solver does not converge, the best iterate is
+         * used if it satisfies the convex hull constraint.
          * @return true/false in case of success/failure.
          */
         bool solve();
 
+        /**
+         * Check if the last output is given by a converged solution.
+         * @return true if the last solution is converged, false if the best iterate is used.
+         */
+        bool isSolutionConverged() const;
+
+        /**
+         * Set the controller output. This should be called when the input applied to the robot
+         * was evaluated by another controller, so that the input variation penalty
+         * of the next iteration is computed with respect to the applied input.
+         * @param output the input applied to the robot.
+         */
+        void setControllerOutput(const iDynTree::Vector2& output);
+
         /**
          * Get the output of the controller.
          * @return the vector containing the output the controller.
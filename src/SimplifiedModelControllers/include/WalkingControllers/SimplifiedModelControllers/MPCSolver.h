@@ -11,10 +11,17 @@
 
 // std
 #include <deque>
+#include <memory>
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
 
 // iDynTree
 #include <iDynTree/Core/SparseMatrix.h>
 #include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Core/EigenSparseHelpers.h>
 
 // osqp-eigen
 #include <OsqpEigen/OsqpEigen.h>
@@ -25,7 +32,11 @@ namespace WalkingControllers
 {
 
     /**
-     * MPCSolver class
+     * MPCSolver class. The state and the input of the DCM model are planar, hence the quantities
+     * related to a single stage of the horizon (e.g. the blocks of the gradient) are stored in
+     * fixed-size Eigen objects. The horizon is a runtime parameter.
+     * The class contains fixed-size Eigen members, please allocate it with
+     * std::allocate_shared and Eigen::aligned_allocator.
      */
     class MPCSolver
     {
@@ -41,28 +52,55 @@ namespace WalkingControllers
         Eigen::VectorXd m_upperBound; /**< Upper bound vector. */
         Eigen::VectorXd m_gradient; /**< Gradient vector. */
 
-        int m_stateSize; /**< Size of the state vector (2). */
-        int m_inputSize; /**< Size of the controlled input vector (2). */
+        /**
+         * Constraints matrix. The equality part depends only on the system dynamics and it is
+         * built only once in the constructor. Only the inequality part is updated.
+         */
+        Eigen::SparseMatrix<double> m_constraintsMatrix;
+        std::vector<c_int> m_inequalityConstraintsIndices; /**< Position of the inequality constraints matrix
+                                                              elements (row major) in the values array of
+                                                              the constraints matrix. */
+        Eigen::VectorXd m_inequalityConstraintsValues; /**< Buffer containing the values of the inequality
+                                                          constraints matrix (row major). */
+        Eigen::VectorXd m_changedConstraintsValues; /**< Buffer containing the changed values of the inequality
+                                                       constraints matrix. */
+        std::vector<c_int> m_changedConstraintsIndices; /**< Position of the changed values in the values array
+                                                           of the constraints matrix. */
+
+        Eigen::Matrix2d m_stateWeight; /**< Dense state weight matrix (Q). */
+        Eigen::Vector2d m_previousControllerOutput; /**< Controller output used to evaluate the gradient. */
+
+        bool m_isInequalityConstraintsVectorSet{false}; /**< True if the inequality part of the upper bound is set. */
+
         int m_controllerHorizon; /**< Controller horizon (in steps)*/
         int m_numberOfInequalityConstraints; /**< Number of inequality constraints*/
+        int m_numberOfConstrainedInputs; /**< Number of inputs (starting from the first one) subject to the inequality constraints. */
+
+        int m_maxIterations{4000}; /**< Maximum number of iterations allowed to the solver. */
+        double m_timeLimit{0.0}; /**< Maximum time allowed to the solver (seconds). 0 means no limit. */
 
     public:
 
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
         /**
          * Constructor.
-         * @param stateSize size of the state vector;
-         * @param inputSize size of the controlled input vector;
+         * @param controllerHorizon controller horizon (in steps);
+         * @param numberOfInequalityConstraints total number of inequality constraints;
          * @param equalConstraintsMatrix equal submatrix  of the constraints matrix;
          * @param gradientSubmatrix matrix used to evaluate the gradient vector
          * (\f$-\Theta^T \tilde{R} e_1\f$);
-         * @param stateWeightStackedMatrix \f$ \tilde{Q} = diag([Q, Q, ..., Q]) \f$.
+         * @param stateWeightStackedMatrix \f$ \tilde{Q} = diag([Q, Q, ..., Q]) \f$;
+         * @param numberOfConstrainedInputs number of inputs subject to the inequality constraints.
+         * The inequality constraints are equally split among the inputs, i.e. the i-th block of
+         * numberOfInequalityConstraints / numberOfConstrainedInputs rows acts on the i-th input.
          */
-        MPCSolver(const int& stateSize, const int& inputSize,
-                  const int& controllerHorizon,
+        MPCSolver(const int& controllerHorizon,
                   const int& numberOfInequalityConstraints,
                   const iDynTree::Triplets& equalConstraintsMatrix,
                   const iDynSparseMatrix& gradientSubmatrix,
-                  const iDynSparseMatrix& stateWeightStackedMatrix);
+                  const iDynSparseMatrix& stateWeightStackedMatrix,
+                  const int& numberOfConstrainedInputs = 1);
 
         /**
          * Set the hessian matrix.
@@ -75,8 +113,9 @@ namespace WalkingControllers
         /**
          * Set or update the linear constraints matrix.
          * If the solver is already set the linear constraints matrix is updated otherwise it is set for
-         * the first time.
-         * @param inequalityConstraintsMatrix  matrix of the inequalities constraints (Ax < b)
+         * the first time. Only the changed elements are passed to the solver.
+         * @param inequalityConstraintsMatrix  matrix of the inequalities constraints (Ax < b). The
+         * i-th block of rows acts on the i-th input.
          * @return true/false in case of success/failure.
          */
         bool setConstraintsMatrix(const iDynTree::MatrixDynSize& inequalityConstraintsMatrix);
@@ -88,7 +127,7 @@ namespace WalkingControllers
          * @return true/false in case of success/failure.
          */
         bool setBounds(const iDynTree::Vector2& currentState,
-                       const iDynTree::VectorDynSize& inequalityConstraintsVector);
+                               const iDynTree::VectorDynSize& inequalityConstraintsVector);
 
         /**
          * Set or update the gradient
@@ -99,8 +138,8 @@ namespace WalkingControllers
          * @return true/false in case of success/failure.
          */
         bool setGradient(const std::deque<iDynTree::Vector2>& refereceSignal,
-                         const iDynTree::Vector2& previousControllerOutput,
-                         const bool& resetTrajectory);
+                                 const iDynTree::Vector2& previousControllerOutput,
+                                 const bool& resetTrajectory);
 
         /**
          * Get the primal variable.
@@ -134,6 +173,34 @@ namespace WalkingControllers
          */
         bool solve();
 
+        /**
+         * Set the budget of the solver. The budget can be changed at every iteration.
+         * @param maxIterations maximum number of iterations;
+         * @param timeLimit maximum solve time (seconds). If it is equal to 0 no limit is considered.
+         * @return true/false in case of success/failure.
+         */
+        bool setSolverBudget(const int& maxIterations, const double& timeLimit);
+
+        /**
+         * Check if the last call of solve() stopped before convergence (i.e. the budget expired
+         * or the solution is inaccurate) but the last iterate is still available.
+         * @return true if the best iterate can be retrieved with getSolution().
+         */
+        bool isBestIterateAvailable();
+
+        /**
+         * Get the number of iterations performed in the last call of solve().
+         * @return the number of iterations.
+         */
+        int getNumberOfIterations();
+
+        /**
+         * Get the first input of the solution without copying the whole solution.
+         * @param input first input of the horizon.
+         * @return true/false in case of success/failure.
+         */
+        bool getFirstInput(iDynTree::Vector2& input);
+
         /**
          * Get the solver solution
          * @return the entire solution of the solver
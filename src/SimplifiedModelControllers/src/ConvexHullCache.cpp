@@ -0,0 +1,213 @@
+/**
+ * @file ConvexHullCache.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <cmath>
+#include <iterator>
+
+// YARP
+#include <yarp/os/LogStream.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Core/Direction.h>
+
+#include <WalkingControllers/SimplifiedModelControllers/ConvexHullCache.h>
+
+using namespace WalkingControllers;
+
+bool ConvexHullCache::Key::operator==(const Key& other) const
+{
+    return isDoubleSupport == other.isDoubleSupport
+        && x == other.x
+        && y == other.y
+        && yaw == other.yaw;
+}
+
+bool ConvexHullCache::initialize(const iDynTree::Polygon& footPolygon, int capacity,
+                                 double positionResolution, double angularResolution)
+{
+    if(capacity <= 0)
+    {
+        yError() << "[ConvexHullCache::initialize] The capacity of the cache has to be positive.";
+        return false;
+    }
+
+    if(positionResolution <= 0 || angularResolution <= 0)
+    {
+        yError() << "[ConvexHullCache::initialize] The resolutions have to be positive.";
+        return false;
+    }
+
+    m_footPolygon = footPolygon;
+    m_capacity = capacity;
+    m_positionResolution = positionResolution;
+    m_angularResolution = angularResolution;
+
+    clear();
+
+    m_isInitialized = true;
+    return true;
+}
+
+ConvexHullCache::Key ConvexHullCache::evaluateKey(bool isDoubleSupport,
+                                                  const iDynTree::Transform& leftFoot,
+                                                  const iDynTree::Transform& rightFoot) const
+{
+    Key key;
+    key.isDoubleSupport = isDoubleSupport;
+    key.x = 0;
+    key.y = 0;
+    key.yaw = 0;
+
+    // in single support the polygon expressed in the stance foot frame does not depend
+    // on the feet position
+    if(!isDoubleSupport)
+        return key;
+
+    iDynTree::Transform rightFootInLeftFoot = leftFoot.inverse() * rightFoot;
+    key.x = std::lround(rightFootInLeftFoot.getPosition()(0) / m_positionResolution);
+    key.y = std::lround(rightFootInLeftFoot.getPosition()(1) / m_positionResolution);
+    key.yaw = std::lround(rightFootInLeftFoot.getRotation().asRPY()(2) / m_angularResolution);
+
+    return key;
+}
+
+bool ConvexHullCache::buildConvexHull(const Key& key, Entry& entry)
+{
+    // initilialize axes direction
+    iDynTree::Direction xAxis, yAxis;
+    xAxis.zero();
+    xAxis(0) = 1;
+    yAxis.zero();
+    yAxis(1) = 1;
+
+    // initilize plane origin
+    iDynTree::Position planeOrigin;
+    planeOrigin.zero();
+
+    // the polygon is evaluated in the reference foot frame
+    std::vector<iDynTree::Transform> feetTransforms;
+    feetTransforms.push_back(iDynTree::Transform::Identity());
+
+    if(key.isDoubleSupport)
+    {
+        iDynTree::Position rightFootPosition(key.x * m_positionResolution,
+                                             key.y * m_positionResolution,
+                                             0.0);
+        feetTransforms.push_back(iDynTree::Transform(iDynTree::Rotation::RotZ(key.yaw * m_angularResolution),
+                                                     rightFootPosition));
+    }
+
+    std::vector<iDynTree::Polygon> feetPolygons(feetTransforms.size(), m_footPolygon);
+    if(!m_convexHullComputer.buildConvexHull(xAxis, yAxis, planeOrigin,
+                                             feetPolygons, feetTransforms))
+    {
+        yError() << "[ConvexHullCache::buildConvexHull] Unable to build the convex hull.";
+        return false;
+    }
+
+    entry.key = key;
+    entry.A = iDynTree::toEigen(m_convexHullComputer.A);
+    entry.b = iDynTree::toEigen(m_convexHullComputer.b);
+
+    return true;
+}
+
+const ConvexHullCache::Entry* ConvexHullCache::getEntry(const Key& key)
+{
+    for(auto entry = m_entries.begin(); entry != m_entries.end(); entry++)
+    {
+        if(entry->key == key)
+        {
+            // the entry becomes the most recently used
+            m_entries.splice(m_entries.begin(), m_entries, entry);
+            return &m_entries.front();
+        }
+    }
+
+    // the least recently used entry is reused in order to avoid memory allocation
+    if(m_entries.size() >= m_capacity)
+        m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+    else
+        m_entries.emplace_front();
+
+    if(!buildConvexHull(key, m_entries.front()))
+    {
+        m_entries.pop_front();
+        return nullptr;
+    }
+
+    return &m_entries.front();
+}
+
+bool ConvexHullCache::getConstraints(const iDynTree::Transform& leftFoot,
+                                     const iDynTree::Transform& rightFoot,
+                                     bool leftInContact, bool rightInContact,
+                                     iDynTree::MatrixDynSize& A, iDynTree::VectorDynSize& b)
+{
+    if(!m_isInitialized)
+    {
+        yError() << "[ConvexHullCache::getConstraints] The cache is not initialized.";
+        return false;
+    }
+
+    if(!leftInContact && !rightInContact)
+    {
+        yError() << "[ConvexHullCache::getConstraints] None foot is in contact.";
+        return false;
+    }
+
+    bool isDoubleSupport = leftInContact && rightInContact;
+    const Entry* entry = getEntry(evaluateKey(isDoubleSupport, leftFoot, rightFoot));
+    if(entry == nullptr)
+    {
+        yError() << "[ConvexHullCache::getConstraints] Unable to get the convex hull.";
+        return false;
+    }
+
+    // the polygon is moved from the reference foot frame to the world frame
+    const iDynTree::Transform& referenceFoot = leftInContact ? leftFoot : rightFoot;
+    double yaw = referenceFoot.getRotation().asRPY()(2);
+    Eigen::Matrix2d rotation;
+    rotation << std::cos(yaw), -std::sin(yaw),
+        std::sin(yaw), std::cos(yaw);
+    Eigen::Vector2d position = iDynTree::toEigen(referenceFoot.getPosition()).head<2>();
+
+    A.resize(entry->A.rows(), 2);
+    b.resize(entry->b.size());
+    iDynTree::toEigen(A).noalias() = entry->A * rotation.transpose();
+    iDynTree::toEigen(b) = entry->b;
+    iDynTree::toEigen(b).noalias() += iDynTree::toEigen(A) * position;
+
+    return true;
+}
+
+bool ConvexHullCache::prefetch(const iDynTree::Transform& leftFoot,
+                               const iDynTree::Transform& rightFoot,
+                               bool leftInContact, bool rightInContact)
+{
+    if(!m_isInitialized)
+    {
+        yError() << "[ConvexHullCache::prefetch] The cache is not initialized.";
+        return false;
+    }
+
+    if(!leftInContact && !rightInContact)
+    {
+        yError() << "[ConvexHullCache::prefetch] None foot is in contact.";
+        return false;
+    }
+
+    return getEntry(evaluateKey(leftInContact && rightInContact, leftFoot, rightFoot)) != nullptr;
+}
+
+void ConvexHullCache::clear()
+{
+    m_entries.clear();
+}
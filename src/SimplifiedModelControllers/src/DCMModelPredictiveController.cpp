@@ -12,10 +12,11 @@
 
 // yarp
 #include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
 
 // iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
 #include <iDynTree/Core/EigenSparseHelpers.h>
-#include <iDynTree/Core/Direction.h>
 
 #include <WalkingControllers/iDynTreeUtilities/Helper.h>
 #include <WalkingControllers/YarpUtilities/Helper.h>
@@ -242,6 +243,26 @@ bool WalkingController::initializeMatrices(const yarp::os::Searchable& config)
     // evaluate equal constraints matrix
     m_equalConstraintsMatrixTriplets = evaluateEqualConstraintsMatrix(stateDynamicsTriplets,
                                                                       inputDynamicsTriplets);
+
+    // get the solver budget
+    m_useTimeBudget = config.check("use_time_budget", yarp::os::Value(false)).asBool();
+    m_maximumTimeBudget = config.check("time_budget", yarp::os::Value(0.5 * dT)).asDouble();
+    m_maxIterations = config.check("max_iterations", yarp::os::Value(4000)).asInt();
+    if(m_maximumTimeBudget <= 0 || m_maxIterations <= 0)
+    {
+        yError() << "[initialize] The time budget and the maximum number of iterations have to be positive.";
+        return false;
+    }
+    m_timeBudget = m_maximumTimeBudget;
+
+#ifndef PROFILING
+    // osqp_update_time_limit() is available only if OSQP is compiled with PROFILING
+    if(m_useTimeBudget)
+        yWarning() << "[initialize] OSQP has been compiled without PROFILING, the time limit "
+                   << "of the solver is not available. The time budget will bound only the "
+                   << "number of iterations (using the estimated time of a single iteration).";
+#endif
+
     return true;
 }
 
@@ -301,13 +322,31 @@ bool WalkingController::initializeConstraints(const yarp::os::Searchable& config
                                                      std::abs(std::min(xlimit1, xlimit2)),
                                                      std::abs(std::max(ylimit1, ylimit2)),
                                                      std::abs(std::min(ylimit1, ylimit2)));
-    m_feetPolygons.resize(2);
-    m_feetPolygons[0] = foot;
-    m_feetPolygons[1] = foot;
 
     // set the tolerance of the convex hull
     m_convexHullTolerance = config.check("convex_hull_tolerance", yarp::os::Value(0.01)).asDouble();
 
+    // initialize the cache of the convex hull
+    int cacheSize = config.check("convex_hull_cache_size", yarp::os::Value(8)).asInt();
+    double positionResolution = config.check("convex_hull_cache_position_resolution",
+                                             yarp::os::Value(0.001)).asDouble();
+    double angularResolution = config.check("convex_hull_cache_angular_resolution",
+                                            yarp::os::Value(0.001)).asDouble();
+    if(!m_convexHullCache.initialize(foot, cacheSize, positionResolution, angularResolution))
+    {
+        yError() << "Unable to initialize the convex hull cache.";
+        return false;
+    }
+
+    // the convex hull of two rectangles has at most 8 edges
+    m_useHorizonConvexHull = config.check("use_horizon_convex_hull", yarp::os::Value(false)).asBool();
+    m_maxNumberOfConvexHullEdges = config.check("max_convex_hull_edges", yarp::os::Value(8)).asInt();
+    if(m_maxNumberOfConvexHullEdges <= 0)
+    {
+        yError() << "The maximum number of edges of the convex hull has to be positive.";
+        return false;
+    }
+
     return true;
 }
 
@@ -367,79 +406,266 @@ bool WalkingController::initialize(const yarp::os::Searchable& config)
 bool WalkingController::setConvexHullConstraint(const std::deque<iDynTree::Transform>& leftFoot,
                                                 const std::deque<iDynTree::Transform>& rightFoot,
                                                 const std::deque<bool>& leftInContact,
-                                                const std::deque<bool>& rightInContact)
+                                                const std::deque<bool>& rightInContact,
+                                                const bool& resetTrajectory)
 {
+    if(m_useHorizonConvexHull)
+        return setHorizonConvexHullConstraint(leftFoot, rightFoot, leftInContact, rightInContact,
+                                              resetTrajectory);
+
     auto feetStatus = std::make_pair(leftInContact.front(), rightInContact.front());
 
     // the status of the feet is the same of the previous iteration
-    // the convexHull is already evaluated: do nothing
+    // the convexHull is already evaluated: the convex hull of the next phase is evaluated
     if(m_feetStatus == feetStatus)
+    {
+        if(!m_isNextConvexHullEvaluated)
+        {
+            if(!prefetchNextConvexHull(leftFoot, rightFoot, leftInContact, rightInContact))
+            {
+                yError() << "[setConvexHullConstraint] Error while the next contraints are evaluated.";
+                return false;
+            }
+            m_isNextConvexHullEvaluated = true;
+        }
         return true;
+    }
 
     m_feetStatus = feetStatus;
+    m_isNextConvexHullEvaluated = false;
+
+    if(feetStatus == std::make_pair(false, false))
+    {
+        yError() << "[setConvexHullConstraint] None foot is in contact How is it possible?.";
+        return false;
+    }
 
     // evaluate the convex hull
-    if(feetStatus == std::make_pair(true, true))
+    if(!m_convexHullCache.getConstraints(leftFoot.front(), rightFoot.front(),
+                                         feetStatus.first, feetStatus.second,
+                                         m_convexHullMatrix, m_convexHullVector))
+    {
+        yError() << "[setConvexHullConstraint] Error while the contraints are evaluated.";
+        return false;
+    }
+
+    int numberOfConstraints = m_convexHullMatrix.rows();
+
+    // is it possible to reuse the old solver??
+    // the solver contains fixed-size Eigen objects hence it requires an aligned allocation
+    m_currentController = std::allocate_shared<MPCSolver>(Eigen::aligned_allocator<MPCSolver>(),
+                                                           m_controllerHorizon,
+                                                           numberOfConstraints,
+                                                           m_equalConstraintsMatrixTriplets,
+                                                           m_gradientSubmatrix,
+                                                           m_stateWeightMatrix);
+    // the hessian matrix is set only once
+    if(!m_currentController->setHessianMatrix(m_hessianMatrix))
     {
-        if(!buildConvexHull(leftFoot.front(), rightFoot.front()))
+        yError() << "[addNewController] Unable to set the hessian matrix.";
+        return false;
+    }
+
+    if(!m_currentController->setConstraintsMatrix(m_convexHullMatrix))
+    {
+        yError() << "[setConvexHullConstraint] Unable to add set constraints Matrix.";
+        return false;
+    }
+
+    return true;
+}
+
+bool WalkingController::prefetchNextConvexHull(const std::deque<iDynTree::Transform>& leftFoot,
+                                               const std::deque<iDynTree::Transform>& rightFoot,
+                                               const std::deque<bool>& leftInContact,
+                                               const std::deque<bool>& rightInContact)
+{
+    // find the beginning of the next phase
+    for(int i = 0; i < leftInContact.size(); i++)
+    {
+        if(leftInContact[i] != m_feetStatus.first || rightInContact[i] != m_feetStatus.second)
         {
-            yError() << "[setConvexHullConstraint] Error while the contraints are evaluated.";
-            return false;
+            // the flying phase is not considered
+            if(!leftInContact[i] && !rightInContact[i])
+                return true;
+
+            return m_convexHullCache.prefetch(leftFoot[i], rightFoot[i],
+                                              leftInContact[i], rightInContact[i]);
         }
     }
 
-    if(feetStatus == std::make_pair(true, false))
+    // the phase will not change
+    return true;
+}
+
+bool WalkingController::evaluateConvexHullPlan(const std::deque<iDynTree::Transform>& leftFoot,
+                                               const std::deque<iDynTree::Transform>& rightFoot,
+                                               const std::deque<bool>& leftInContact,
+                                               const std::deque<bool>& rightInContact)
+{
+    m_numberOfConvexHullIntervals = 0;
+    for(int i = 0; i < leftInContact.size(); i++)
     {
-        if(!buildConvexHull(leftFoot.front()))
+        // a new phase begins when the status of the feet changes
+        if(i != 0 && leftInContact[i] == leftInContact[i - 1]
+           && rightInContact[i] == rightInContact[i - 1])
+            continue;
+
+        if(!leftInContact[i] && !rightInContact[i])
         {
-            yError() << "[setConvexHullConstraint] Error while the contraints are evaluated.";
+            yError() << "[evaluateConvexHullPlan] None foot is in contact How is it possible?.";
             return false;
         }
-    }
 
-    if(feetStatus == std::make_pair(false, true))
-    {
-        if(!buildConvexHull(rightFoot.front()))
+        // the storage of the previous plans is reused
+        if(m_numberOfConvexHullIntervals == m_convexHullIntervals.size())
+            m_convexHullIntervals.emplace_back();
+
+        ConvexHullInterval& interval = m_convexHullIntervals[m_numberOfConvexHullIntervals];
+        if(!m_convexHullCache.getConstraints(leftFoot[i], rightFoot[i],
+                                             leftInContact[i], rightInContact[i],
+                                             interval.A, interval.b))
         {
-            yError() << "[setConvexHullConstraint] Error while the contraints are evaluated.";
+            yError() << "[evaluateConvexHullPlan] Error while the contraints are evaluated.";
             return false;
         }
+
+        if(interval.A.rows() > m_maxNumberOfConvexHullEdges)
+        {
+            yError() << "[evaluateConvexHullPlan] The convex hull has" << interval.A.rows()
+                     << "edges. Please increase max_convex_hull_edges.";
+            return false;
+        }
+
+        m_numberOfConvexHullIntervals++;
     }
 
-    if(feetStatus == std::make_pair(false, false))
+    if(m_numberOfConvexHullIntervals == 0)
     {
-        yError() << "[setConvexHullConstraint] None foot is in contact How is it possible?.";
+        yError() << "[evaluateConvexHullPlan] The trajectory is empty.";
         return false;
     }
 
-    int numberOfConstraints = m_convexHullComputer.A.rows();
+    m_currentConvexHullInterval = 0;
+    m_feetStatus = std::make_pair(leftInContact.front(), rightInContact.front());
 
-    // is it possible to reuse the old solver??
-    m_currentController = std::make_shared<MPCSolver>(m_stateSize, m_inputSize,
-                                                      m_controllerHorizon,
-                                                      numberOfConstraints,
-                                                      m_equalConstraintsMatrixTriplets,
-                                                      m_gradientSubmatrix,
-                                                      m_stateWeightMatrix);
-    // the hessian matrix is set only once
-    if(!m_currentController->setHessianMatrix(m_hessianMatrix))
+    // the stages have to be assigned again
+    std::fill(m_stageConvexHullIntervals.begin(), m_stageConvexHullIntervals.end(), -1);
+
+    return true;
+}
+
+bool WalkingController::setHorizonConvexHullConstraint(const std::deque<iDynTree::Transform>& leftFoot,
+                                                       const std::deque<iDynTree::Transform>& rightFoot,
+                                                       const std::deque<bool>& leftInContact,
+                                                       const std::deque<bool>& rightInContact,
+                                                       const bool& resetTrajectory)
+{
+    // the polygons are evaluated only once per plan
+    if(!m_isConvexHullPlanEvaluated || resetTrajectory)
     {
-        yError() << "[addNewController] Unable to set the hessian matrix.";
-        return false;
+        if(!evaluateConvexHullPlan(leftFoot, rightFoot, leftInContact, rightInContact))
+        {
+            yError() << "[setHorizonConvexHullConstraint] Unable to evaluate the convex hull of the plan.";
+            return false;
+        }
+        m_isConvexHullPlanEvaluated = true;
+    }
+    else
+    {
+        auto feetStatus = std::make_pair(leftInContact.front(), rightInContact.front());
+        if(m_feetStatus != feetStatus)
+        {
+            m_feetStatus = feetStatus;
+            if(m_currentConvexHullInterval + 1 < m_numberOfConvexHullIntervals)
+                m_currentConvexHullInterval++;
+        }
     }
 
-    if(!m_currentController->setConstraintsMatrix(m_convexHullComputer.A))
+    int numberOfConstraints = m_maxNumberOfConvexHullEdges * m_controllerHorizon;
+
+    // the number of constraints does not depend on the phase so the solver is instantiated once
+    if(m_currentController == nullptr)
     {
-        yError() << "[setConvexHullConstraint] Unable to add set constraints Matrix.";
+        m_currentController = std::allocate_shared<MPCSolver>(Eigen::aligned_allocator<MPCSolver>(),
+                                                               m_controllerHorizon,
+                                                               numberOfConstraints,
+                                                               m_equalConstraintsMatrixTriplets,
+                                                               m_gradientSubmatrix,
+                                                               m_stateWeightMatrix,
+                                                               m_controllerHorizon);
+        if(!m_currentController->setHessianMatrix(m_hessianMatrix))
+        {
+            yError() << "[setHorizonConvexHullConstraint] Unable to set the hessian matrix.";
+            return false;
+        }
+
+        m_stageConvexHullIntervals.assign(m_controllerHorizon, -1);
+        m_horizonConvexHullMatrix.resize(numberOfConstraints, m_inputSize);
+        m_horizonConvexHullMatrix.zero();
+        m_horizonConvexHullVector.resize(numberOfConstraints);
+    }
+
+    // assign each stage to a phase. Only the stages whose phase is changed are rewritten
+    size_t interval = m_currentConvexHullInterval;
+    for(int k = 0; k < m_controllerHorizon; k++)
+    {
+        // the last element of the trajectory is kept if the horizon exceeds it
+        int index = std::min(k, static_cast<int>(leftInContact.size()) - 1);
+        if(k != 0 && index == k && (leftInContact[index] != leftInContact[index - 1]
+                                    || rightInContact[index] != rightInContact[index - 1]))
+        {
+            if(interval + 1 < m_numberOfConvexHullIntervals)
+                interval++;
+        }
+
+        if(m_stageConvexHullIntervals[k] == static_cast<int>(interval))
+            continue;
+
+        m_stageConvexHullIntervals[k] = interval;
+
+        // the unused rows are padded with the trivial constraint 0 <= inf
+        const ConvexHullInterval& stageConvexHull = m_convexHullIntervals[interval];
+        for(int i = 0; i < m_maxNumberOfConvexHullEdges; i++)
+        {
+            int row = k * m_maxNumberOfConvexHullEdges + i;
+            bool isEdge = i < stageConvexHull.A.rows();
+            for(int j = 0; j < m_inputSize; j++)
+                m_horizonConvexHullMatrix(row, j) = isEdge ? stageConvexHull.A(i, j) : 0.0;
+            m_horizonConvexHullVector(row) = isEdge ? stageConvexHull.b(i) : OsqpEigen::INFTY;
+        }
+
+        // the polygon of the first stage is used to check the solution
+        if(k == 0)
+        {
+            m_convexHullMatrix = stageConvexHull.A;
+            m_convexHullVector = stageConvexHull.b;
+        }
+    }
+
+    if(!m_currentController->setConstraintsMatrix(m_horizonConvexHullMatrix))
+    {
+        yError() << "[setHorizonConvexHullConstraint] Unable to set the constraints matrix.";
         return false;
     }
 
     return true;
 }
 
+double WalkingController::evaluateConvexHullMargin(const iDynTree::Vector2& point) const
+{
+    auto A = iDynTree::toEigen(m_convexHullMatrix);
+    auto b = iDynTree::toEigen(m_convexHullVector);
+
+    return ((b - A * iDynTree::toEigen(point)).array() / A.rowwise().norm().array()).minCoeff();
+}
+
 bool WalkingController::setFeedback(const iDynTree::Vector2& currentState)
 {
-    return m_currentController->setBounds(currentState, m_convexHullComputer.b);
+    if(m_useHorizonConvexHull)
+        return m_currentController->setBounds(currentState, m_horizonConvexHullVector);
+
+    return m_currentController->setBounds(currentState, m_convexHullVector);
 }
 
 bool WalkingController::setReferenceSignal(const std::deque<iDynTree::Vector2>& referenceSignal,
@@ -448,51 +674,15 @@ bool WalkingController::setReferenceSignal(const std::deque<iDynTree::Vector2>&
     return m_currentController->setGradient(referenceSignal, m_output, resetTrajectory);
 }
 
-bool WalkingController::buildConvexHull(const iDynTree::Transform& leftFootTransform,
-                                        const iDynTree::Transform& rightFootTransform)
-{
-    // initilialize axes direction
-    iDynTree::Direction xAxis, yAxis;
-    xAxis.zero();
-    xAxis(0) = 1;
-    yAxis.zero();
-    yAxis(1) = 1;
-
-    // initilize plane origin
-    iDynTree::Position planeOrigin;
-    planeOrigin.zero();
-
-    std::vector<iDynTree::Transform> feetTransforms;
-    feetTransforms.push_back(leftFootTransform);
-    feetTransforms.push_back(rightFootTransform);
-
-    return m_convexHullComputer.buildConvexHull(xAxis, yAxis, planeOrigin,
-                                                m_feetPolygons, feetTransforms);
-}
-
-bool WalkingController::buildConvexHull(const iDynTree::Transform& footTransform)
+void WalkingController::setTimeBudget(const double& remainingTime)
 {
-    // initilialize axes direction
-    iDynTree::Direction xAxis, yAxis;
-    xAxis.zero();
-    xAxis(0) = 1;
-    yAxis.zero();
-    yAxis(1) = 1;
-
-    // initilize plane origin
-    iDynTree::Position planeOrigin;
-    planeOrigin.zero();
-
-    std::vector<iDynTree::Transform> feetTransforms;
-    feetTransforms.push_back(footTransform);
-
-    return m_convexHullComputer.buildConvexHull(xAxis, yAxis, planeOrigin,
-                                                std::vector<iDynTree::Polygon>(1, m_feetPolygons[0]),
-                                                feetTransforms);
+    m_timeBudget = std::min(remainingTime, m_maximumTimeBudget);
 }
 
 bool WalkingController::solve()
 {
+    m_isSolutionConverged = false;
+
     if(!m_currentController->isInitialized())
     {
         if(!m_currentController->initialize())
@@ -502,25 +692,79 @@ bool WalkingController::solve()
         }
     }
 
-    if(!m_currentController->solve())
+    if(m_useTimeBudget)
     {
-        yError() << "[solve] Unable to solve the problem.";
-        return false;
+        if(m_timeBudget <= 0)
+        {
+            yError() << "[solve] The time budget is already expired.";
+            return false;
+        }
+
+        // the number of iterations is bounded using the estimated time of a single iteration
+        int maxIterations = m_maxIterations;
+        if(m_averageIterationTime > 0)
+            maxIterations = std::max(1, std::min(m_maxIterations,
+                                                 static_cast<int>(m_timeBudget / m_averageIterationTime)));
+
+        if(!m_currentController->setSolverBudget(maxIterations, m_timeBudget))
+        {
+            yError() << "[solve] Unable to set the solver budget.";
+            return false;
+        }
     }
 
-    iDynTree::VectorDynSize solution = m_currentController->getSolution();
-    m_output(0) = solution(m_stateSize * (m_controllerHorizon + 1));
-    m_output(1) = solution(m_stateSize * (m_controllerHorizon + 1) + 1);
+    double initTime = yarp::os::Time::now();
+    m_isSolutionConverged = m_currentController->solve();
+    double solverTime = yarp::os::Time::now() - initTime;
+
+    // update the estimate of the time required by a single iteration
+    int iterations = m_currentController->getNumberOfIterations();
+    if(iterations > 0)
+    {
+        double iterationTime = solverTime / iterations;
+        if(m_averageIterationTime <= 0)
+            m_averageIterationTime = iterationTime;
+        else
+            m_averageIterationTime = 0.9 * m_averageIterationTime + 0.1 * iterationTime;
+    }
 
-    if(m_convexHullComputer.computeMargin(m_output) < -m_convexHullTolerance)
+    if(!m_isSolutionConverged)
+    {
+        if(!m_useTimeBudget || !m_currentController->isBestIterateAvailable())
+        {
+            yError() << "[solve] Unable to solve the problem.";
+            return false;
+        }
+    }
+
+    iDynTree::Vector2 output;
+    if(!m_currentController->getFirstInput(output))
+    {
+        yError() << "[solve] Unable to get the solution.";
+        return false;
+    }
+
+    if(evaluateConvexHullMargin(output) < -m_convexHullTolerance)
     {
         yError() << "[solve] The evaluated ZMP is outside the convexHull.";
         return false;
     }
 
+    m_output = output;
+
     return true;
 }
 
+bool WalkingController::isSolutionConverged() const
+{
+    return m_isSolutionConverged;
+}
+
+void WalkingController::setControllerOutput(const iDynTree::Vector2& output)
+{
+    m_output = output;
+}
+
 const iDynTree::Vector2& WalkingController::getControllerOutput() const
 {
     return m_output;
@@ -530,4 +774,6 @@ void WalkingController::reset()
 {
     // used to indicate the first step.
     m_feetStatus = std::make_pair<bool, bool>(false, false);
+    m_isNextConvexHullEvaluated = false;
+    m_isConvexHullPlanEvaluated = false;
 }
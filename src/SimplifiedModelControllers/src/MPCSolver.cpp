@@ -6,6 +6,9 @@
  * @date 2018
  */
 
+// std
+#include <iostream>
+
 // iDynTree
 #include <iDynTree/Core/EigenHelpers.h>
 #include <iDynTree/Core/EigenSparseHelpers.h>
@@ -15,16 +18,22 @@
 
 using namespace WalkingControllers;
 
-MPCSolver::MPCSolver(const int& stateSize, const int& inputSize,
-                     const int& controllerHorizon,
+namespace
+{
+    // the state (DCM) and the input (ZMP) of the controller are planar
+    constexpr int stateSize = 2;
+    constexpr int inputSize = 2;
+}
+
+MPCSolver::MPCSolver(const int& controllerHorizon,
                      const int& numberOfInequalityConstraints,
                      const iDynTree::Triplets& equalConstraintsMatrixTriplets,
                      const iDynSparseMatrix& gradientSubmatrix,
-                     const iDynSparseMatrix& stateWeightMatrix)
-    :m_stateSize(stateSize),
-     m_inputSize(inputSize),
-     m_controllerHorizon(controllerHorizon),
+                     const iDynSparseMatrix& stateWeightMatrix,
+                     const int& numberOfConstrainedInputs)
+    :m_controllerHorizon(controllerHorizon),
      m_numberOfInequalityConstraints(numberOfInequalityConstraints),
+     m_numberOfConstrainedInputs(numberOfConstrainedInputs),
      m_equalConstraintsMatrix(&equalConstraintsMatrixTriplets),
      m_gradientSubmatrix(&gradientSubmatrix),
      m_stateWeightMatrix(&stateWeightMatrix)
@@ -33,12 +42,12 @@ MPCSolver::MPCSolver(const int& stateSize, const int& inputSize,
     m_optimizerSolver = std::make_unique<OsqpEigen::Solver>();
 
     // set the number of variables
-    int numberOfVariables = m_stateSize * (m_controllerHorizon + 1) +
-        m_inputSize * m_controllerHorizon;
+    int numberOfVariables = stateSize * (m_controllerHorizon + 1) +
+        inputSize * m_controllerHorizon;
     m_optimizerSolver->data()->setNumberOfVariables(numberOfVariables);
 
     // set the number of constraints
-    int numberOfConstraints = m_stateSize * (m_controllerHorizon + 1) +
+    int numberOfConstraints = stateSize * (m_controllerHorizon + 1) +
         m_numberOfInequalityConstraints;
     m_optimizerSolver->data()->setNumberOfConstraints(numberOfConstraints);
 
@@ -47,9 +56,52 @@ MPCSolver::MPCSolver(const int& stateSize, const int& inputSize,
     m_lowerBound = Eigen::VectorXd::Zero(numberOfConstraints);
     m_upperBound = Eigen::VectorXd::Zero(numberOfConstraints);
 
-    for(int i = m_stateSize * (m_controllerHorizon + 1); i < numberOfConstraints; i++)
+    for(int i = stateSize * (m_controllerHorizon + 1); i < numberOfConstraints; i++)
         m_lowerBound(i) = - OsqpEigen::INFTY;
 
+    m_stateWeight = iDynTree::toEigen(*m_stateWeightMatrix);
+
+    // build the constraints matrix. The inequality part is a block diagonal matrix
+    // (initialized to zero) whose i-th block acts on the i-th input. Explicit zeros are
+    // stored in order to keep the sparsity pattern constant.
+    int inequalityConstraintsMatrixRowPos = stateSize * (m_controllerHorizon + 1);
+    int inequalityConstraintsMatrixColumnPos = stateSize * (m_controllerHorizon + 1);
+    int numberOfInequalityConstraintsPerInput = m_numberOfInequalityConstraints / m_numberOfConstrainedInputs;
+
+    std::vector<Eigen::Triplet<double>> constraintsTriplets;
+    for(const auto& triplet : *m_equalConstraintsMatrix)
+        constraintsTriplets.emplace_back(triplet.row, triplet.column, triplet.value);
+
+    for(int i = 0; i < m_numberOfInequalityConstraints; i++)
+        for(int j = 0; j < inputSize; j++)
+            constraintsTriplets.emplace_back(inequalityConstraintsMatrixRowPos + i,
+                                             inequalityConstraintsMatrixColumnPos
+                                             + (i / numberOfInequalityConstraintsPerInput) * inputSize + j,
+                                             0.0);
+
+    m_constraintsMatrix.resize(numberOfConstraints, numberOfVariables);
+    m_constraintsMatrix.setFromTriplets(constraintsTriplets.begin(), constraintsTriplets.end());
+    m_constraintsMatrix.makeCompressed();
+
+    // store the position of the inequality constraints elements in the values array
+    m_inequalityConstraintsIndices.resize(m_numberOfInequalityConstraints * inputSize);
+    for(int j = 0; j < m_numberOfConstrainedInputs * inputSize; j++)
+    {
+        int column = inequalityConstraintsMatrixColumnPos + j;
+        for(int k = m_constraintsMatrix.outerIndexPtr()[column];
+            k < m_constraintsMatrix.outerIndexPtr()[column + 1]; k++)
+        {
+            int row = m_constraintsMatrix.innerIndexPtr()[k] - inequalityConstraintsMatrixRowPos;
+            if(row >= 0)
+                m_inequalityConstraintsIndices[row * inputSize + j % inputSize] = k;
+        }
+    }
+    m_inequalityConstraintsValues = Eigen::VectorXd::Zero(m_numberOfInequalityConstraints * inputSize);
+    m_changedConstraintsValues.resize(m_numberOfInequalityConstraints * inputSize);
+    m_changedConstraintsIndices.resize(m_numberOfInequalityConstraints * inputSize);
+
+    m_previousControllerOutput.setZero();
+
     m_optimizerSolver->settings()->setVerbosity(false);
 }
 
@@ -77,34 +129,42 @@ bool MPCSolver::setHessianMatrix(const iDynSparseMatrix& hessian)
 
 bool MPCSolver::setConstraintsMatrix(const iDynTree::MatrixDynSize& inequalityConstraintsMatrix)
 {
-    // set the linear constraints matrix triplets
-    iDynTree::Triplets constraintsTriplets;
-    iDynTreeUtilities::Triplets::pushTriplets(*m_equalConstraintsMatrix, constraintsTriplets);
-
-    int inequalityConstraintsMatrixRowPos = m_stateSize * (m_controllerHorizon + 1);
-    int inequalityConstraintsMatrixColumnPos = m_stateSize * (m_controllerHorizon + 1);
-    constraintsTriplets.addSubMatrix(inequalityConstraintsMatrixRowPos,
-                                     inequalityConstraintsMatrixColumnPos,
-                                     inequalityConstraintsMatrix);
-
-    // convert triplets into a sparse matrix
-    int constraintsMatrixRows = m_stateSize * (m_controllerHorizon + 1) +
-        m_numberOfInequalityConstraints;
-    int constraintsMatrixCols = m_stateSize * (m_controllerHorizon + 1) +
-        m_inputSize * m_controllerHorizon;
-    iDynSparseMatrix constraintsMatrix(constraintsMatrixRows,
-                                       constraintsMatrixCols);
+    if(inequalityConstraintsMatrix.rows() != m_numberOfInequalityConstraints
+       || inequalityConstraintsMatrix.cols() != inputSize)
+    {
+        std::cerr << "[setLinearConstraintsMatrix] The size of the inequalityConstraintsMatrix has to equal: "
+                  << m_numberOfInequalityConstraints << " x " << inputSize << std::endl;
+        return false;
+    }
 
-    constraintsMatrix.setFromConstTriplets(constraintsTriplets);
+    // only the changed values of the inequality part are updated. The equality part is constant
+    int numberOfChangedValues = 0;
+    for(int i = 0; i < m_numberOfInequalityConstraints; i++)
+        for(int j = 0; j < inputSize; j++)
+        {
+            int index = i * inputSize + j;
+            if(m_inequalityConstraintsValues(index) == inequalityConstraintsMatrix(i, j))
+                continue;
+
+            m_inequalityConstraintsValues(index) = inequalityConstraintsMatrix(i, j);
+            m_constraintsMatrix.valuePtr()[m_inequalityConstraintsIndices[index]] =
+                inequalityConstraintsMatrix(i, j);
 
-    // convert iDynTree sparse matrix in eigen sparse matrix
-    // it is required by the osqp library
-    Eigen::SparseMatrix<double> constraintsMatrixEigen =
-        iDynTree::toEigen(constraintsMatrix);
+            m_changedConstraintsValues(numberOfChangedValues) = inequalityConstraintsMatrix(i, j);
+            m_changedConstraintsIndices[numberOfChangedValues] = m_inequalityConstraintsIndices[index];
+            numberOfChangedValues++;
+        }
 
     if(m_optimizerSolver->isInitialized())
     {
-        if(!m_optimizerSolver->updateLinearConstraintsMatrix(constraintsMatrixEigen))
+        if(numberOfChangedValues == 0)
+            return true;
+
+        // the sparsity pattern does not change, only the changed elements are updated
+        if(osqp_update_A(m_optimizerSolver->workspace().get(),
+                         m_changedConstraintsValues.data(),
+                         m_changedConstraintsIndices.data(),
+                         numberOfChangedValues) != 0)
         {
             std::cerr << "[setLinearConstraintsMatrix] Unable to update the constraints matrix."
                       << std::endl;
@@ -113,7 +173,7 @@ bool MPCSolver::setConstraintsMatrix(const iDynTree::MatrixDynSize& inequalityCo
     }
     else
     {
-        if(!m_optimizerSolver->data()->setLinearConstraintsMatrix(constraintsMatrixEigen))
+        if(!m_optimizerSolver->data()->setLinearConstraintsMatrix(m_constraintsMatrix))
         {
             std::cerr << "[setLinearConstraintsMatrix] Unable to set the constraints matrix."
                       << std::endl;
@@ -127,13 +187,6 @@ bool MPCSolver::setConstraintsMatrix(const iDynTree::MatrixDynSize& inequalityCo
 bool MPCSolver::setBounds(const iDynTree::Vector2& currentState,
                           const iDynTree::VectorDynSize& inequalityConstraintsVector)
 {
-    if(currentState.size() != m_stateSize)
-    {
-        std::cerr << "[setBounds] The size of the currentState vector has to equal: " << m_stateSize
-                  << std::endl;
-        return false;
-    }
-
     if(inequalityConstraintsVector.size() != m_numberOfInequalityConstraints)
     {
         std::cerr << "[setBounds] The size of the inequalityConstraintsVector has to equal: "
@@ -142,17 +195,19 @@ bool MPCSolver::setBounds(const iDynTree::Vector2& currentState,
     }
 
     // set the lower and the upper bounds
-    m_lowerBound(0) = -currentState(0);
-    m_lowerBound(1) = -currentState(1);
-    m_upperBound(0) = -currentState(0);
-    m_upperBound(1) = -currentState(1);
-
-    // update the inequality constraints vector
-    // note: it should be removed from here. It is not necessary to update the inequality constraint
-    // vector every iteration. It should be updated only when a change of phase
-    // (SS->DS or vice versa) occurs
-    for(int i = 0; i< m_numberOfInequalityConstraints; i++)
-        m_upperBound(m_stateSize * (m_controllerHorizon + 1) + i) = inequalityConstraintsVector(i);
+    m_lowerBound.head<stateSize>() = -iDynTree::toEigen(currentState);
+    m_upperBound.head<stateSize>() = -iDynTree::toEigen(currentState);
+
+    // the inequality constraints vector changes only when a change of phase
+    // (SS->DS or vice versa) enters the constrained inputs. It is rewritten only if it is
+    // different from the stored one
+    auto inequalityUpperBound = m_upperBound.tail(m_numberOfInequalityConstraints);
+    if(!m_isInequalityConstraintsVectorSet
+       || inequalityUpperBound != iDynTree::toEigen(inequalityConstraintsVector))
+    {
+        inequalityUpperBound = iDynTree::toEigen(inequalityConstraintsVector);
+        m_isInequalityConstraintsVectorSet = true;
+    }
 
     if(m_optimizerSolver->isInitialized())
     {
@@ -186,69 +241,69 @@ bool MPCSolver::setGradient(const std::deque<iDynTree::Vector2>& referenceSignal
                             const iDynTree::Vector2& previousControllerOutput,
                             const bool& resetTrajectory)
 {
+    int gradientStateSize = stateSize * (m_controllerHorizon + 1);
+    int gradientInputSize = inputSize * m_controllerHorizon;
+
+    bool isGradientChanged = false;
+    bool isFirstTime = !m_optimizerSolver->isInitialized() || resetTrajectory;
+
     // the solver is not initialized or the trajectory was reset.
-    if(!m_optimizerSolver->isInitialized() || resetTrajectory)
+    if(isFirstTime)
     {
-        // check if the size of the controller horizon is lower than the size of the reference signal
-        if(referenceSignal.size() >= m_controllerHorizon + 1)
+        // if the size of the reference signal is lower than the controller horizon
+        // we assume the reference signal becomes constant
+        for(int i = 0; i < (m_controllerHorizon + 1); i++)
         {
-            for(int i = 0; i < (m_controllerHorizon + 1); i++)
-            {
-                m_gradient.block<2,1>(i * m_stateSize, 0) = -iDynTree::toEigen(*m_stateWeightMatrix) *
-                    iDynTree::toEigen(referenceSignal[i]);
-            }
-        }
+            const iDynTree::Vector2& reference = i < referenceSignal.size() ?
+                referenceSignal[i] : referenceSignal.back();
 
-        // otherwise we assume the reference signal becomes constant
-        else
-        {
-            // the first part is the same as before
-            for(int i = 0; i < referenceSignal.size(); i++)
-            {
-                m_gradient.block<2,1>(i * m_stateSize, 0) = -iDynTree::toEigen(*m_stateWeightMatrix) *
-                    iDynTree::toEigen(referenceSignal[i]);
-            }
-            for(int i = referenceSignal.size(); i < (m_controllerHorizon + 1); i++)
-            {
-                m_gradient.block<2,1>(i * m_stateSize, 0) = -iDynTree::toEigen(*m_stateWeightMatrix) *
-                    iDynTree::toEigen(referenceSignal.back());
-            }
+            m_gradient.segment<stateSize>(i * stateSize).noalias() =
+                -m_stateWeight * iDynTree::toEigen(reference);
         }
+        isGradientChanged = true;
     }
     else
     {
-        // shift the element of the gradient in order to save time
+        // shift the element of the gradient in order to save time. The gradient
+        // changes only if the reference signal is not constant
         for(int i = 0; i < (m_controllerHorizon); i++)
         {
-            m_gradient.block<2,1>(i*m_stateSize, 0) = m_gradient.block<2,1>((i+1) * m_stateSize, 0);
+            auto currentBlock = m_gradient.segment<stateSize>(i * stateSize);
+            auto nextBlock = m_gradient.segment<stateSize>((i + 1) * stateSize);
+            if(currentBlock != nextBlock)
+            {
+                currentBlock = nextBlock;
+                isGradientChanged = true;
+            }
         }
 
-        if(referenceSignal.size() >= m_controllerHorizon + 1)
-        {
-            // evaluate only the new element of the gradient
-            m_gradient.block<2,1>(m_controllerHorizon * m_stateSize, 0) =
-                -iDynTree::toEigen(*m_stateWeightMatrix) *
-                iDynTree::toEigen(referenceSignal[m_controllerHorizon]);
-        }
-        else
+        // evaluate only the new element of the gradient. If the reference signal is shorter than
+        // the controller horizon the signal is assumed to be constant
+        const iDynTree::Vector2& reference = referenceSignal.size() >= m_controllerHorizon + 1 ?
+            referenceSignal[m_controllerHorizon] : referenceSignal.back();
+
+        Eigen::Vector2d lastBlock = -m_stateWeight * iDynTree::toEigen(reference);
+        if(m_gradient.segment<stateSize>(m_controllerHorizon * stateSize) != lastBlock)
         {
-            // evaluate only the new element of the gradient in this case the signal
-            // is assumed to be constant
-            m_gradient.block<2,1>(m_controllerHorizon * m_stateSize, 0) =
-                -iDynTree::toEigen(*m_stateWeightMatrix) *
-                iDynTree::toEigen(referenceSignal.back());
+            m_gradient.segment<stateSize>(m_controllerHorizon * stateSize) = lastBlock;
+            isGradientChanged = true;
         }
     }
 
-    int gradientStateSize = m_stateSize * (m_controllerHorizon + 1);
-    int gradientInputSize = m_inputSize * m_controllerHorizon;
-
-    m_gradient.block(gradientStateSize, 0, gradientInputSize, 1) =
-        iDynTree::toEigen(*m_gradientSubmatrix) * iDynTree::toEigen(previousControllerOutput);
+    // the input part of the gradient depends only on the previous controller output
+    if(isFirstTime
+       || iDynTree::toEigen(previousControllerOutput) != m_previousControllerOutput)
+    {
+        m_previousControllerOutput = iDynTree::toEigen(previousControllerOutput);
+        m_gradient.segment(gradientStateSize, gradientInputSize).noalias() =
+            iDynTree::toEigen(*m_gradientSubmatrix) * m_previousControllerOutput;
+        isGradientChanged = true;
+    }
 
     if(m_optimizerSolver->isInitialized())
     {
-        if(!m_optimizerSolver->updateGradient(m_gradient))
+        // push the gradient only if it is changed
+        if(isGradientChanged && !m_optimizerSolver->updateGradient(m_gradient))
         {
             std::cerr << "[setGradient] Unable to update the gradient."
                       << std::endl;
@@ -289,6 +344,66 @@ bool MPCSolver::setPrimalVariable(const Eigen::VectorXd& primalVariable)
     return m_optimizerSolver->setPrimalVariable(primalVariable);
 }
 
+bool MPCSolver::setSolverBudget(const int& maxIterations, const double& timeLimit)
+{
+    if(maxIterations <= 0 || timeLimit < 0)
+    {
+        std::cerr << "[setSolverBudget] The maximum number of iterations has to be positive "
+                  << "and the time limit has to be non negative."
+                  << std::endl;
+        return false;
+    }
+
+    m_maxIterations = maxIterations;
+    m_timeLimit = timeLimit;
+
+    if(!m_optimizerSolver->isInitialized())
+    {
+        m_optimizerSolver->settings()->setMaxIteraction(m_maxIterations);
+#ifdef PROFILING
+        m_optimizerSolver->settings()->setTimeLimit(m_timeLimit);
+#endif
+        return true;
+    }
+
+    if(osqp_update_max_iter(m_optimizerSolver->workspace().get(), m_maxIterations) != 0)
+    {
+        std::cerr << "[setSolverBudget] Unable to update the maximum number of iterations."
+                  << std::endl;
+        return false;
+    }
+
+#ifdef PROFILING
+    if(osqp_update_time_limit(m_optimizerSolver->workspace().get(), m_timeLimit) != 0)
+    {
+        std::cerr << "[setSolverBudget] Unable to update the time limit."
+                  << std::endl;
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+bool MPCSolver::isBestIterateAvailable()
+{
+    if(!m_optimizerSolver->isInitialized())
+        return false;
+
+    c_int status = m_optimizerSolver->workspace()->info->status_val;
+    return status == OSQP_SOLVED_INACCURATE
+        || status == OSQP_MAX_ITER_REACHED
+        || status == OSQP_TIME_LIMIT_REACHED;
+}
+
+int MPCSolver::getNumberOfIterations()
+{
+    if(!m_optimizerSolver->isInitialized())
+        return 0;
+
+    return m_optimizerSolver->workspace()->info->iter;
+}
+
 bool MPCSolver::isInitialized()
 {
     return m_optimizerSolver->isInitialized();
@@ -315,10 +430,26 @@ iDynTree::VectorDynSize MPCSolver::getSolution()
 {
     Eigen::VectorXd solutionEigen = m_optimizerSolver->getSolution();
 
-    int solutionSize = m_stateSize * (m_controllerHorizon + 1) +
-        m_inputSize * m_controllerHorizon;
+    int solutionSize = stateSize * (m_controllerHorizon + 1) +
+        inputSize * m_controllerHorizon;
     iDynTree::VectorDynSize solution(solutionSize);
     iDynTree::toEigen(solution) = solutionEigen;
 
     return solution;
 }
+
+bool MPCSolver::getFirstInput(iDynTree::Vector2& input)
+{
+    if(!m_optimizerSolver->isInitialized())
+    {
+        std::cerr << "[getFirstInput] The solver is not initilialize."
+                  << std::endl;
+        return false;
+    }
+
+    // the solution is not copied, only the first input is read
+    iDynTree::toEigen(input) =
+        m_optimizerSolver->getSolution().segment<inputSize>(stateSize * (m_controllerHorizon + 1));
+
+    return true;
+}
@@ -35,9 +35,12 @@
 #include <WalkingControllers/SimplifiedModelControllers/ZMPController.h>
 
 #include <WalkingControllers/WholeBodyControllers/InverseKinematics.h>
+#include <WalkingControllers/WholeBodyControllers/MultiStartInverseKinematics.h>
 #include <WalkingControllers/WholeBodyControllers/QPInverseKinematics.h>
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_KKT.h>
 #include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_osqp.h>
 #include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_qpOASES.h>
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematicsShadow.h>
 
 #include <WalkingControllers/KinDynWrapper/Wrapper.h>
 
@@ -63,13 +66,17 @@ namespace WalkingControllers
         enum class WalkingFSM {Idle, Configured, Preparing, Prepared, Walking, Paused, Stopped};
         WalkingFSM m_robotState{WalkingFSM::Idle}; /**< State  of the WalkingFSM. */
 
-        double m_dT; /**< RFModule period. */
+        double m_dT; /**< Sampling time of the controller. */
+        double m_period{0.016}; /**< RFModule period (it is shorter than m_dT if the simulated robot runs faster than real time). */
         double m_time; /**< Current time. */
         std::string m_robot; /**< Robot name. */
 
         bool m_useMPC; /**< True if the MPC controller is used. */
+        bool m_useMPCFallback; /**< True if the reactive controller is used when the MPC fails. */
         bool m_useQPIK; /**< True if the QP-IK is used. */
         bool m_useOSQP; /**< True if osqp is used to QP-IK problem. */
+        bool m_useKKTQPIK; /**< True if the QP-IK problem is solved with the dense null-space (KKT) solver. */
+        bool m_useQPIKShadowMode; /**< True if the QP-IK problems are solved also by the shadow solvers. */
         bool m_dumpData; /**< True if data are saved. */
 
         std::unique_ptr<RobotInterface> m_robotControlHelper; /**< Robot control helper. */
@@ -78,7 +85,9 @@ namespace WalkingControllers
         std::unique_ptr<WalkingDCMReactiveController> m_walkingDCMReactiveController; /**< Pointer to the walking DCM reactive controller object. */
         std::unique_ptr<WalkingZMPController> m_walkingZMPController; /**< Pointer to the walking ZMP controller object. */
         std::unique_ptr<WalkingIK> m_IKSolver; /**< Pointer to the inverse kinematics solver. */
+        std::unique_ptr<WalkingMultiStartIK> m_multiStartIKSolver; /**< Pointer to the multi-start inverse kinematics solver used by prepareRobot(). */
         std::unique_ptr<WalkingQPIK> m_QPIKSolver; /**< Pointer to the inverse kinematics solver. */
+        std::unique_ptr<WalkingQPIKShadow> m_QPIKShadow; /**< Pointer to the QP-IK shadow solvers. */
         std::unique_ptr<WalkingFK> m_FKSolver; /**< Pointer to the forward kinematics solver. */
         std::unique_ptr<StableDCMModel> m_stableDCMModel; /**< Pointer to the stable DCM dynamics. */
         std::unique_ptr<WalkingPIDHandler> m_PIDHandler; /**< Pointer to the PID handler object. */
@@ -119,6 +128,16 @@ namespace WalkingControllers
 
         yarp::os::Port m_rpcPort; /**< Remote Procedure Call port. */
         yarp::os::BufferedPort<yarp::sig::Vector> m_desiredUnyciclePositionPort; /**< Desired robot position port. */
+        yarp::os::BufferedPort<yarp::sig::Vector> m_feedbackAgesPort; /**< Feedback ages port (encoders, left and right foot wrenches) [s]. */
+        yarp::os::BufferedPort<yarp::sig::Vector> m_MPCStatisticsPort; /**< MPC statistics port (converged, best iterate, fallback). */
+
+        size_t m_MPCConvergedCounter{0}; /**< Number of cycles in which the MPC solution converged. */
+        size_t m_MPCBestIterateCounter{0}; /**< Number of cycles in which the best iterate of the MPC is used. */
+        size_t m_MPCFallbackCounter{0}; /**< Number of cycles in which the reactive controller replaced the MPC. */
+
+        yarp::os::BufferedPort<yarp::sig::Vector> m_QPIKStatisticsPort; /**< QP-IK statistics port (iterations, max iterations, predicted CoM error). */
+        int m_QPIKMaxIterations{0}; /**< Maximum number of iterations performed by the QP-IK solver. */
+        yarp::os::BufferedPort<yarp::sig::Vector> m_QPIKShadowStatisticsPort; /**< QP-IK shadow solvers statistics port. */
 
         bool m_newTrajectoryRequired; /**< if true a new trajectory will be merged soon. (after m_newTrajectoryMergeCounter - 2 cycles). */
         size_t m_newTrajectoryMergeCounter; /**< The new trajectory will be merged after m_newTrajectoryMergeCounter - 2 cycles. */
@@ -7,6 +7,8 @@
  */
 
 // std
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
 
@@ -15,7 +17,7 @@
 #include <yarp/os/BufferedPort.h>
 #include <yarp/sig/Vector.h>
 #include <yarp/os/LogStream.h>
-
+#include <yarp/os/Time.h>
 
 // iDynTree
 #include <iDynTree/Core/VectorFixSize.h>
@@ -105,7 +107,7 @@ bool WalkingModule::advanceReferenceSignals()
 double WalkingModule::getPeriod()
 {
     //  period of the module (seconds)
-    return m_dT;
+    return m_period;
 }
 
 bool WalkingModule::setRobotModel(const yarp::os::Searchable& rf)
@@ -129,8 +131,11 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
 {
     // module name (used as prefix for opened ports)
     m_useMPC = rf.check("use_mpc", yarp::os::Value(false)).asBool();
+    m_useMPCFallback = rf.check("use_mpc_fallback", yarp::os::Value(false)).asBool();
     m_useQPIK = rf.check("use_QP-IK", yarp::os::Value(false)).asBool();
     m_useOSQP = rf.check("use_osqp", yarp::os::Value(false)).asBool();
+    m_useKKTQPIK = rf.check("use_kkt_qpik", yarp::os::Value(false)).asBool();
+    m_useQPIKShadowMode = rf.check("use_qpik_shadow_mode", yarp::os::Value(false)).asBool();
     m_dumpData = rf.check("dump_data", yarp::os::Value(false)).asBool();
 
     yarp::os::Bottle& generalOptions = rf.findGroup("GENERAL");
@@ -146,11 +151,16 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
     m_robotControlHelper = std::make_unique<RobotInterface>();
     yarp::os::Bottle& robotControlHelperOptions = rf.findGroup("ROBOT_CONTROL");
     robotControlHelperOptions.append(generalOptions);
+    // the model is required by the simulated robot
+    yarp::os::Bottle& modelOption = robotControlHelperOptions.addList();
+    modelOption.addString("model");
+    modelOption.add(rf.check("model", yarp::os::Value("model.urdf")));
     if(!m_robotControlHelper->configureRobot(robotControlHelperOptions))
     {
         yError() << "[WalkingModule::configure] Unable to configure the robot.";
         return false;
     }
+    m_period = m_dT / m_robotControlHelper->getRealTimeFactor();
 
     yarp::os::Bottle& forceTorqueSensorsOptions = rf.findGroup("FT_SENSORS");
     forceTorqueSensorsOptions.append(generalOptions);
@@ -182,6 +192,13 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
         return false;
     }
 
+    std::string feedbackAgesPortName = "/" + getName() + "/feedbackAges:o";
+    if(!m_feedbackAgesPort.open(feedbackAgesPortName))
+    {
+        yError() << "[WalkingModule::configure] Could not open" << feedbackAgesPortName << " port.";
+        return false;
+    }
+
     // initialize the trajectory planner
     m_trajectoryGenerator = std::make_unique<TrajectoryGenerator>();
     yarp::os::Bottle& trajectoryPlannerOptions = rf.findGroup("TRAJECTORY_PLANNER");
@@ -203,20 +220,26 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
             yError() << "[WalkingModule::configure] Unable to initialize the controller.";
             return false;
         }
-    }
-    else
-    {
-        // initialize the MPC controller
-        m_walkingDCMReactiveController = std::make_unique<WalkingDCMReactiveController>();
-        yarp::os::Bottle& dcmControllerOptions = rf.findGroup("DCM_REACTIVE_CONTROLLER");
-        dcmControllerOptions.append(generalOptions);
-        if(!m_walkingDCMReactiveController->initialize(dcmControllerOptions))
+
+        std::string MPCStatisticsPortName = "/" + getName() + "/mpcStatistics:o";
+        if(!m_MPCStatisticsPort.open(MPCStatisticsPortName))
         {
-            yError() << "[WalkingModule::configure] Unable to initialize the controller.";
+            yError() << "[WalkingModule::configure] Could not open" << MPCStatisticsPortName << " port.";
             return false;
         }
     }
 
+    // initialize the reactive controller. It is always initialized since it is
+    // used as fallback when the MPC is not able to find a solution
+    m_walkingDCMReactiveController = std::make_unique<WalkingDCMReactiveController>();
+    yarp::os::Bottle& dcmReactiveControllerOptions = rf.findGroup("DCM_REACTIVE_CONTROLLER");
+    dcmReactiveControllerOptions.append(generalOptions);
+    if(!m_walkingDCMReactiveController->initialize(dcmReactiveControllerOptions))
+    {
+        yError() << "[WalkingModule::configure] Unable to initialize the controller.";
+        return false;
+    }
+
     // initialize the ZMP controller
     m_walkingZMPController = std::make_unique<WalkingZMPController>();
     yarp::os::Bottle& zmpControllerOptions = rf.findGroup("ZMP_CONTROLLER");
@@ -237,11 +260,25 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
         return false;
     }
 
+    // the initial posture can be evaluated by several IK instances running concurrently
+    if(inverseKinematicsSolverOptions.check("use_multi_start", yarp::os::Value(false)).asBool())
+    {
+        m_multiStartIKSolver = std::make_unique<WalkingMultiStartIK>();
+        if(!m_multiStartIKSolver->initialize(inverseKinematicsSolverOptions, m_loader.model(),
+                                             m_robotControlHelper->getAxesList()))
+        {
+            yError() << "[WalkingModule::configure] Failed to configure the multi-start ik solver";
+            return false;
+        }
+    }
+
     if(m_useQPIK)
     {
         yarp::os::Bottle& inverseKinematicsQPSolverOptions = rf.findGroup("INVERSE_KINEMATICS_QP_SOLVER");
         inverseKinematicsQPSolverOptions.append(generalOptions);
-        if(m_useOSQP)
+        if(m_useKKTQPIK)
+            m_QPIKSolver = std::make_unique<WalkingQPIK_KKT>();
+        else if(m_useOSQP)
             m_QPIKSolver = std::make_unique<WalkingQPIK_osqp>();
         else
             m_QPIKSolver = std::make_unique<WalkingQPIK_qpOASES>();
@@ -252,9 +289,35 @@ bool WalkingModule::configure(yarp::os::ResourceFinder& rf)
                                      m_robotControlHelper->getPositionUpperLimits(),
                                      m_robotControlHelper->getPositionLowerLimits()))
         {
-            yError() << "[WalkingModule::configure] Failed to configure the QP-IK solver (qpOASES)";
+            yError() << "[WalkingModule::configure] Failed to configure the QP-IK solver";
+            return false;
+        }
+
+        std::string QPIKStatisticsPortName = "/" + getName() + "/qpikStatistics:o";
+        if(!m_QPIKStatisticsPort.open(QPIKStatisticsPortName))
+        {
+            yError() << "[WalkingModule::configure] Could not open" << QPIKStatisticsPortName << " port.";
             return false;
         }
+
+        if(m_useQPIKShadowMode)
+        {
+            // the problems solved by the QP-IK are solved again by the shadow solvers in
+            // a separate thread
+            m_QPIKShadow = std::make_unique<WalkingQPIKShadow>();
+            if(!m_QPIKShadow->initialize(inverseKinematicsQPSolverOptions, *m_QPIKSolver))
+            {
+                yError() << "[WalkingModule::configure] Failed to configure the QP-IK shadow solvers";
+                return false;
+            }
+
+            std::string QPIKShadowStatisticsPortName = "/" + getName() + "/qpikShadowStatistics:o";
+            if(!m_QPIKShadowStatisticsPort.open(QPIKShadowStatisticsPortName))
+            {
+                yError() << "[WalkingModule::configure] Could not open" << QPIKShadowStatisticsPortName << " port.";
+                return false;
+            }
+        }
     }
 
     // initialize the forward kinematics solver
@@ -355,6 +418,16 @@ bool WalkingModule::close()
     // close the ports
     m_rpcPort.close();
     m_desiredUnyciclePositionPort.close();
+    m_feedbackAgesPort.close();
+    if(m_useMPC)
+        m_MPCStatisticsPort.close();
+    if(m_useQPIK)
+        m_QPIKStatisticsPort.close();
+    if(m_QPIKShadow)
+    {
+        m_QPIKShadow->close();
+        m_QPIKShadowStatisticsPort.close();
+    }
 
     // close the connection with robot
     if(!m_robotControlHelper->close())
@@ -366,8 +439,11 @@ bool WalkingModule::close()
     // clear all the pointer
     m_trajectoryGenerator.reset(nullptr);
     m_walkingController.reset(nullptr);
+    m_walkingDCMReactiveController.reset(nullptr);
     m_walkingZMPController.reset(nullptr);
     m_IKSolver.reset(nullptr);
+    m_multiStartIKSolver.reset(nullptr);
+    m_QPIKShadow.reset(nullptr);
     m_QPIKSolver.reset(nullptr);
     m_FKSolver.reset(nullptr);
     m_stableDCMModel.reset(nullptr);
@@ -380,9 +456,12 @@ bool WalkingModule::solveQPIK(const std::unique_ptr<WalkingQPIK>& solver, const
                               const iDynTree::Rotation& desiredNeckOrientation,
                               iDynTree::VectorDynSize &output)
 {
+    // only the quantities required by the active tasks are evaluated
+    const QPIKKinematicRequirements& requirements = solver->getKinematicRequirements();
+
     bool ok = true;
     solver->setPhase(m_isStancePhase.front());
-    ok &= solver->setRobotState(*m_FKSolver);
+    ok &= solver->setRobotState(*m_FKSolver, KinematicsState::Desired);
     solver->setDesiredNeckOrientation(desiredNeckOrientation.inverse());
 
     solver->setDesiredFeetTransformation(m_leftTrajectory.front(),
@@ -395,33 +474,41 @@ bool WalkingModule::solveQPIK(const std::unique_ptr<WalkingQPIK>& solver, const
     solver->setDesiredCoMPosition(desiredCoMPosition);
 
     // TODO probably the problem can be written locally w.r.t. the root or the base
-    solver->setDesiredHandsTransformation(m_FKSolver->getHeadToWorldTransform() * m_retargetingClient->leftHandTransform(),
-                                          m_FKSolver->getHeadToWorldTransform() * m_retargetingClient->rightHandTransform());
+    if(requirements.handsTransforms)
+    {
+        iDynTree::Transform headToWorldTransform = m_FKSolver->getHeadToWorldTransform(KinematicsState::Desired);
+        solver->setDesiredHandsTransformation(headToWorldTransform * m_retargetingClient->leftHandTransform(),
+                                              headToWorldTransform * m_retargetingClient->rightHandTransform());
+    }
 
-    ok &= solver->setDesiredRetargetingJoint(m_retargetingClient->jointValues());
+    if(requirements.retargetingJoints)
+        ok &= solver->setDesiredRetargetingJoint(m_retargetingClient->jointValues());
 
     // set jacobians
     iDynTree::MatrixDynSize jacobian, comJacobian;
     jacobian.resize(6, m_robotControlHelper->getActuatedDoFs() + 6);
     comJacobian.resize(3, m_robotControlHelper->getActuatedDoFs() + 6);
 
-    ok &= m_FKSolver->getLeftFootJacobian(jacobian);
+    ok &= m_FKSolver->getLeftFootJacobian(jacobian, KinematicsState::Desired);
     ok &= solver->setLeftFootJacobian(jacobian);
 
-    ok &= m_FKSolver->getRightFootJacobian(jacobian);
+    ok &= m_FKSolver->getRightFootJacobian(jacobian, KinematicsState::Desired);
     ok &= solver->setRightFootJacobian(jacobian);
 
-    ok &= m_FKSolver->getNeckJacobian(jacobian);
+    ok &= m_FKSolver->getNeckJacobian(jacobian, KinematicsState::Desired);
     ok &= solver->setNeckJacobian(jacobian);
 
-    ok &= m_FKSolver->getCoMJacobian(comJacobian);
+    ok &= m_FKSolver->getCoMJacobian(comJacobian, KinematicsState::Desired);
     solver->setCoMJacobian(comJacobian);
 
-    ok &= m_FKSolver->getLeftHandJacobian(jacobian);
-    ok &= solver->setLeftHandJacobian(jacobian);
+    if(requirements.handsJacobians)
+    {
+        ok &= m_FKSolver->getLeftHandJacobian(jacobian, KinematicsState::Desired);
+        ok &= solver->setLeftHandJacobian(jacobian);
 
-    ok &= m_FKSolver->getRightHandJacobian(jacobian);
-    ok &= solver->setRightHandJacobian(jacobian);
+        ok &= m_FKSolver->getRightHandJacobian(jacobian, KinematicsState::Desired);
+        ok &= solver->setRightHandJacobian(jacobian);
+    }
 
     if(!ok)
     {
@@ -429,14 +516,51 @@ bool WalkingModule::solveQPIK(const std::unique_ptr<WalkingQPIK>& solver, const
         return false;
     }
 
+    // the same clock of the shadow solvers is used, so the latencies can be compared
+    auto solverStartTime = std::chrono::steady_clock::now();
     if(!solver->solve())
     {
         yError() << "[WalkingModule::solveQPIK] Unable to solve the QP-IK problem.";
         return false;
     }
+    std::chrono::duration<double> solverTime = std::chrono::steady_clock::now() - solverStartTime;
 
     output = solver->getDesiredJointVelocities();
 
+    int iterations = solver->getNumberOfIterations();
+    m_QPIKMaxIterations = std::max(m_QPIKMaxIterations, iterations);
+
+    // the CoM reached by the integration step is predicted with the CoM jacobian, the forward
+    // kinematics is not evaluated again on the integrated state
+    iDynTree::Position predictedCoMPosition;
+    iDynTree::Vector3 predictedCoMVelocity;
+    if(!m_FKSolver->getPredictedCoM(output, m_dT, predictedCoMPosition, predictedCoMVelocity,
+                                    KinematicsState::Desired))
+    {
+        yError() << "[WalkingModule::solveQPIK] Unable to predict the CoM position.";
+        return false;
+    }
+
+    yarp::sig::Vector& statistics = m_QPIKStatisticsPort.prepare();
+    statistics.resize(3);
+    statistics(0) = iterations;
+    statistics(1) = m_QPIKMaxIterations;
+    statistics(2) = (iDynTree::toEigen(predictedCoMPosition) - iDynTree::toEigen(desiredCoMPosition)
+                     - iDynTree::toEigen(desiredCoMVelocity) * m_dT).norm();
+    m_QPIKStatisticsPort.write();
+
+    // the problem is only copied, the shadow solvers run in a separate thread
+    if(m_QPIKShadow)
+    {
+        m_QPIKShadow->pushProblem(*solver, solverTime.count());
+
+        yarp::sig::Vector& shadowStatistics = m_QPIKShadowStatisticsPort.prepare();
+        if(m_QPIKShadow->getStatistics(shadowStatistics))
+            m_QPIKShadowStatisticsPort.write();
+        else
+            m_QPIKShadowStatisticsPort.unprepare();
+    }
+
     return true;
 }
 
@@ -523,6 +647,7 @@ bool WalkingModule::updateModule()
 
         bool resetTrajectory = false;
 
+        double initTickTime = yarp::os::Time::now();
         m_profiler->setInitTime("Total");
 
         // check desired planner input
@@ -590,6 +715,13 @@ bool WalkingModule::updateModule()
             return false;
         }
 
+        yarp::sig::Vector& feedbackAges = m_feedbackAgesPort.prepare();
+        feedbackAges.resize(3);
+        feedbackAges(0) = m_robotControlHelper->getEncodersAge();
+        feedbackAges(1) = m_robotControlHelper->getLeftWrenchAge();
+        feedbackAges(2) = m_robotControlHelper->getRightWrenchAge();
+        m_feedbackAgesPort.write();
+
         // if the retargeting is not in the approaching phase we can set the stance/walking phase
         if(!m_retargetingClient->isApproachingPhase())
         {
@@ -620,12 +752,14 @@ bool WalkingModule::updateModule()
         }
 
         // DCM controller
+        bool useReactiveController = !m_useMPC;
         if(m_useMPC)
         {
             // Model predictive controller
             m_profiler->setInitTime("MPC");
             if(!m_walkingController->setConvexHullConstraint(m_leftTrajectory, m_rightTrajectory,
-                                                             m_leftInContact, m_rightInContact))
+                                                             m_leftInContact, m_rightInContact,
+                                                             resetTrajectory))
             {
                 yError() << "[WalkingModule::updateModule] unable to evaluate the convex hull.";
                 return false;
@@ -643,15 +777,41 @@ bool WalkingModule::updateModule()
                 return false;
             }
 
-            if(!m_walkingController->solve())
+            // the solver can use the time left in the current cycle
+            m_walkingController->setTimeBudget(m_dT - (yarp::os::Time::now() - initTickTime));
+
+            if(m_walkingController->solve())
             {
-                yError() << "[WalkingModule::updateModule] Unable to solve the problem.";
-                return false;
+                if(m_walkingController->isSolutionConverged())
+                    m_MPCConvergedCounter++;
+                else
+                    m_MPCBestIterateCounter++;
+            }
+            else
+            {
+                if(!m_useMPCFallback)
+                {
+                    yError() << "[WalkingModule::updateModule] Unable to solve the problem.";
+                    return false;
+                }
+
+                yWarning() << "[WalkingModule::updateModule] Unable to solve the MPC problem. "
+                           << "The reactive controller is used.";
+                useReactiveController = true;
+                m_MPCFallbackCounter++;
             }
 
             m_profiler->setEndTime("MPC");
+
+            yarp::sig::Vector& statistics = m_MPCStatisticsPort.prepare();
+            statistics.resize(3);
+            statistics(0) = m_MPCConvergedCounter;
+            statistics(1) = m_MPCBestIterateCounter;
+            statistics(2) = m_MPCFallbackCounter;
+            m_MPCStatisticsPort.write();
         }
-        else
+
+        if(useReactiveController)
         {
             m_walkingDCMReactiveController->setFeedback(m_FKSolver->getDCM());
             m_walkingDCMReactiveController->setReferenceSignal(m_DCMPositionDesired.front(),
@@ -662,6 +822,10 @@ bool WalkingModule::updateModule()
                 yError() << "[WalkingModule::updateModule] Unable to evaluate the DCM control output.";
                 return false;
             }
+
+            // the MPC has to know the input applied to the robot
+            if(m_useMPC)
+                m_walkingController->setControllerOutput(m_walkingDCMReactiveController->getControllerOutput());
         }
 
         // inner COM-ZMP controller
@@ -726,9 +890,10 @@ bool WalkingModule::updateModule()
             yarp::sig::Vector bufferVelocity(m_robotControlHelper->getActuatedDoFs());
             yarp::sig::Vector bufferPosition(m_robotControlHelper->getActuatedDoFs());
 
-            if(!m_FKSolver->setInternalRobotState(m_qDesired, m_dqDesired))
+            // the measured state set in updateFKSolver() is not overwritten
+            if(!m_FKSolver->setDesiredRobotState(m_qDesired, m_dqDesired))
             {
-                yError() << "[WalkingModule::updateModule] Unable to set the internal robot state.";
+                yError() << "[WalkingModule::updateModule] Unable to set the desired robot state.";
                 return false;
             }
 
@@ -744,14 +909,6 @@ bool WalkingModule::updateModule()
 
             bufferPosition = m_velocityIntegral->integrate(bufferVelocity);
             iDynTree::toiDynTree(bufferPosition, m_qDesired);
-
-            if(!m_FKSolver->setInternalRobotState(m_robotControlHelper->getJointPosition(),
-                                                  m_robotControlHelper->getJointVelocity()))
-            {
-                yError() << "[WalkingModule::updateModule] Unable to set the internal robot state.";
-                return false;
-            }
-
         }
         else
         {
@@ -983,10 +1140,38 @@ bool WalkingModule::prepareRobot(bool onTheFly)
             yError() << "[WalkingModule::prepareRobot] Error updating the inertia to world frame rotation.";
             return false;
         }
+
+        if(m_multiStartIKSolver && !m_multiStartIKSolver->updateIntertiaToWorldFrameRotation(modifiedInertial))
+        {
+            yError() << "[WalkingModule::prepareRobot] Error updating the inertia to world frame rotation.";
+            return false;
+        }
     }
 
-    if(!m_IKSolver->computeIK(m_leftTrajectory.front(), m_rightTrajectory.front(),
-                              desiredCoMPosition, m_qDesired))
+    if(m_multiStartIKSolver)
+    {
+        if(!m_multiStartIKSolver->setFullModelFeedBack(m_robotControlHelper->getJointPosition()))
+        {
+            yError() << "[WalkingModule::prepareRobot] Error while setting the feedback to the multi-start IK solver.";
+            return false;
+        }
+
+        if(!m_multiStartIKSolver->computeIK(m_leftTrajectory.front(), m_rightTrajectory.front(),
+                                            desiredCoMPosition, m_qDesired))
+        {
+            yError() << "[WalkingModule::prepareRobot] Inverse Kinematics failed while computing the initial position.";
+            return false;
+        }
+
+        // the walking IK starts from the initial position
+        if(!m_IKSolver->setInitialGuess(m_qDesired))
+        {
+            yError() << "[WalkingModule::prepareRobot] Error while setting the guess of the IK solver.";
+            return false;
+        }
+    }
+    else if(!m_IKSolver->computeIK(m_leftTrajectory.front(), m_rightTrajectory.front(),
+                                   desiredCoMPosition, m_qDesired))
     {
         yError() << "[WalkingModule::prepareRobot] Inverse Kinematics failed while computing the initial position.";
         return false;
@@ -1189,6 +1374,26 @@ bool WalkingModule::updateFKSolver()
         return false;
     }
 
+    // the stance foot is detected with the force torque sensors. The pose of the new stance foot
+    // is evaluated with the joints measured in this tick, then the state is set again only if the base switched
+    if(!m_robotControlHelper->isExternalRobotBaseUsed() && m_FKSolver->isLegOdometryUsed())
+    {
+        bool isBaseSwitched;
+        if(!m_FKSolver->updateLegOdometry(m_robotControlHelper->getLeftWrench(),
+                                          m_robotControlHelper->getRightWrench(), isBaseSwitched))
+        {
+            yError() << "[WalkingModule::updateFKSolver] Unable to update the leg odometry.";
+            return false;
+        }
+
+        if(isBaseSwitched && !m_FKSolver->setInternalRobotState(m_robotControlHelper->getJointPosition(),
+                                                                m_robotControlHelper->getJointVelocity()))
+        {
+            yError() << "[WalkingModule::updateFKSolver] Unable to set the robot state.";
+            return false;
+        }
+    }
+
     return true;
 }
 
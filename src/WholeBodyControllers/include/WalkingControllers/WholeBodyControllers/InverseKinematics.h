@@ -13,8 +13,12 @@
 // iDynTree
 #include <iDynTree/KinDynComputations.h>
 #include <iDynTree/InverseKinematics.h>
+#include <iDynTree/Core/MatrixDynSize.h>
 #include <string>
 
+// eigen
+#include <Eigen/Dense>
+
 namespace yarp {
     namespace os {
         class Searchable;
@@ -55,7 +59,8 @@ namespace WalkingControllers
 
         iDynTree::VectorDynSize m_jointRegularization, m_guess, m_feedback, m_qResult;
 
-        //DEBUG
+        // diagnostics. The checker is loaded only if use_diagnostics is true
+        bool m_useDiagnostics; /**< True if the errors of the solution are evaluated after each call of computeIK(). */
         iDynTree::KinDynComputations lchecker;
         iDynTree::VectorDynSize dummyVel;
         iDynTree::Twist dummyBaseVel;
@@ -65,11 +70,100 @@ namespace WalkingControllers
         double maxCpuTime;
 
         bool m_prepared;
+        bool m_isFeedbackUpdated; /**< True if the feedback has to be passed to the IPOPT problem. */
+        bool m_isJointRegularizationUpdated; /**< True if the joint regularization has to be passed to the IPOPT problem. */
 
         double m_additionalRotationWeight, m_jointRegularizationWeight;
 
+        // Levenberg-Marquardt solver
+        bool m_useLevenbergMarquardt; /**< True if the IK is solved with the Levenberg-Marquardt solver instead of IPOPT. */
+        int m_maxLMIterations; /**< Maximum number of iterations of the Levenberg-Marquardt solver. */
+        int m_numberOfLMIterations; /**< Number of iterations performed in the last call of computeIK(). */
+        double m_LMInitialDamping; /**< Damping used in the first iteration. */
+        double m_LMConstraintsTolerance; /**< Tolerance on the right foot and CoM errors. */
+        double m_LMStepTolerance; /**< The solver stops when the norm of the step is lower than this value. */
+        double m_LMConstraintsWeight; /**< Weight of the constraints error in the merit function. */
+
+        iDynTree::KinDynComputations m_LMKinDyn; /**< Kinematics used by the Levenberg-Marquardt solver. */
+        iDynTree::FrameIndex m_LMRightFootFrameIndex; /**< Index of the right foot frame. */
+        iDynTree::FrameIndex m_LMAdditionalFrameIndex; /**< Index of the additional frame. */
+        iDynTree::VectorDynSize m_LMJointVelocities; /**< Joint velocities (always zero). */
+        iDynTree::Twist m_LMBaseVelocity; /**< Base velocity (always zero). */
+        iDynTree::Vector3 m_LMGravity; /**< Gravity acceleration (not used). */
+        iDynTree::MatrixDynSize m_LMFrameJacobian; /**< Jacobian of a frame (6 x 6 + # of joints). */
+        iDynTree::MatrixDynSize m_LMCoMJacobian; /**< Jacobian of the CoM (3 x 6 + # of joints). */
+
+        iDynTree::VectorDynSize m_LMCandidate; /**< Candidate solution. */
+        Eigen::VectorXd m_jointsLowerLimits; /**< Lower limits of the joints. */
+        Eigen::VectorXd m_jointsUpperLimits; /**< Upper limits of the joints. */
+        Eigen::Matrix<double, 9, 1> m_constraintsError; /**< Right foot (position and orientation) and CoM errors. */
+        Eigen::Vector3d m_additionalRotationError; /**< Orientation error of the additional frame. */
+        Eigen::MatrixXd m_constraintsJacobian; /**< Jacobian of the right foot and of the CoM (joints columns only). */
+        Eigen::MatrixXd m_additionalRotationJacobian; /**< Angular jacobian of the additional frame (joints columns only). */
+        Eigen::MatrixXd m_KKTMatrix; /**< Matrix of the KKT system solved at each iteration. */
+        Eigen::VectorXd m_KKTVector; /**< Known vector of the KKT system. */
+        Eigen::VectorXd m_KKTSolution; /**< Solution of the KKT system (step and multipliers). */
+        Eigen::PartialPivLU<Eigen::MatrixXd> m_KKTSolver; /**< Decomposition of the KKT matrix. */
+
+        /**
+         * Build the IK problem. It is called only once, computeIK() updates only the values of
+         * the targets, the guess and the feedback.
+         * @return true/false in case of success/failure.
+         */
         bool prepareIK();
 
+        /**
+         * Build the IPOPT problem (targets, constraints and solver options). It is called by
+         * prepareIK() only if the Levenberg-Marquardt solver is not used.
+         * @return true/false in case of success/failure.
+         */
+        bool prepareIPOPT();
+
+        /**
+         * Evaluate and print the CoM and the right foot errors of the last solution. It is
+         * called only if use_diagnostics is true.
+         * @param desiredRightTransform desired transformation of the right foot (left foot frame);
+         * @param desiredCoMPosition desired position of the CoM (left foot frame).
+         */
+        void evaluateDiagnostics(const iDynTree::Transform& desiredRightTransform,
+                                 const iDynTree::Position& desiredCoMPosition);
+
+        /**
+         * Initialize the Levenberg-Marquardt solver. It is called by prepareIK().
+         * @return true/false in case of success/failure.
+         */
+        bool prepareLevenbergMarquardt();
+
+        /**
+         * Evaluate the errors and the merit function of the Levenberg-Marquardt solver.
+         * The kinematics is updated with the given joint positions.
+         * @param jointPositions joint positions;
+         * @param desiredRightTransform desired transformation of the right foot (left foot frame);
+         * @param desiredCoMPosition desired position of the CoM (left foot frame);
+         * @param desiredAdditionalRotation desired rotation of the additional frame (left foot frame);
+         * @param merit value of the merit function.
+         * @return true/false in case of success/failure.
+         */
+        bool evaluateLMErrors(const iDynTree::VectorDynSize& jointPositions,
+                              const iDynTree::Transform& desiredRightTransform,
+                              const iDynTree::Position& desiredCoMPosition,
+                              const iDynTree::Rotation& desiredAdditionalRotation,
+                              double& merit);
+
+        /**
+         * Solve the IK with a damped least-squares (Levenberg-Marquardt) method. The right foot
+         * and the CoM are treated as linearized equality constraints, the additional rotation and
+         * the joint regularization are costs. The joint limits are enforced by projecting the
+         * solution. m_guess is used as initial guess and the solution is stored in m_qResult.
+         * @param desiredRightTransform desired transformation of the right foot (left foot frame);
+         * @param desiredCoMPosition desired position of the CoM (left foot frame);
+         * @param desiredAdditionalRotation desired rotation of the additional frame (left foot frame).
+         * @return true/false in case of success/failure.
+         */
+        bool solveLevenbergMarquardt(const iDynTree::Transform& desiredRightTransform,
+                                     const iDynTree::Position& desiredCoMPosition,
+                                     const iDynTree::Rotation& desiredAdditionalRotation);
+
     public:
 
         /**
@@ -146,6 +240,13 @@ namespace WalkingControllers
         bool setDesiredJointsWeight(double weight);
 
         double desiredJointWeight();
+
+        /**
+         * Get the number of iterations performed by the Levenberg-Marquardt solver in the last
+         * call of computeIK().
+         * @return the number of iterations (0 if IPOPT is used).
+         */
+        int getNumberOfIterations() const;
     };
 };
 
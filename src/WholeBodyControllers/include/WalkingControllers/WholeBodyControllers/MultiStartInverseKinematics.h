@@ -0,0 +1,145 @@
+/**
+ * @file MultiStartInverseKinematics.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_MULTI_START_IK_H
+#define WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_MULTI_START_IK_H
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// iDynTree
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/Model/Model.h>
+
+#include <WalkingControllers/WholeBodyControllers/InverseKinematics.h>
+
+namespace WalkingControllers
+{
+
+    /**
+     * WalkingMultiStartIK class. Several WalkingIK instances solve the same problem concurrently
+     * starting from different initial guesses: the current posture, the desired joint
+     * configuration, the last solutions and random perturbations of the desired joint
+     * configuration. Each instance owns its own iDynTree::InverseKinematics object and runs in
+     * its own thread. The feasible solution closest to the desired joint configuration among the
+     * ones found within the time budget is returned. Please notice that the linear solver used
+     * by IPOPT has to be thread safe (one of the HSL solvers, e.g. ma27), the initialization fails
+     * with mumps unless the Levenberg-Marquardt solver is used.
+     */
+    class WalkingMultiStartIK
+    {
+        /**
+         * IK instance running in a worker thread.
+         */
+        struct Instance
+        {
+            std::unique_ptr<WalkingIK> solver; /**< Inverse kinematics solver. */
+            std::thread worker; /**< Thread where the solver runs. */
+
+            iDynTree::VectorDynSize guess; /**< Initial guess. */
+            iDynTree::VectorDynSize feedback; /**< Joint positions feedback. */
+            iDynTree::Transform leftTransform; /**< Desired left foot transformation. */
+            iDynTree::Transform rightTransform; /**< Desired right foot transformation. */
+            iDynTree::Position comPosition; /**< Desired CoM position. */
+            iDynTree::Rotation inertial_R_world; /**< Rotation between the inertial and the world frame. */
+            iDynTree::VectorDynSize solution; /**< Solution of the IK. */
+
+            std::size_t requestedGeneration{0}; /**< Last problem assigned to the instance. */
+            std::size_t solvedGeneration{0}; /**< Last problem solved by the instance. */
+            bool isBusy{false}; /**< True if the instance is solving a problem. */
+            bool isSolved{false}; /**< True if the last problem has been solved successfully. */
+        };
+
+        std::vector<Instance> m_instances; /**< IK instances. */
+        std::size_t m_generation{0}; /**< Identifier of the last problem. */
+        bool m_isClosing{false}; /**< True if the worker threads have to stop. */
+        std::mutex m_mutex; /**< Mutex protecting the instances. */
+        std::condition_variable m_startCondition; /**< Used to wake up the workers. */
+        std::condition_variable m_doneCondition; /**< Used to notify that an instance finished. */
+
+        double m_timeBudget; /**< Maximum wall-clock time spent in computeIK() (seconds). */
+        double m_perturbation; /**< Maximum perturbation of the random initial guesses (radians). */
+        std::size_t m_cacheSize; /**< Number of previous solutions used as initial guesses. */
+        std::deque<iDynTree::VectorDynSize> m_previousSolutions; /**< Previous solutions (the newest first). */
+        std::mt19937 m_randomGenerator; /**< Generator of the random perturbations. */
+
+        iDynTree::VectorDynSize m_feedback; /**< Joint positions feedback. */
+        iDynTree::Rotation m_inertial_R_world; /**< Rotation between the inertial and the world frame. */
+
+        /**
+         * Main loop of a worker thread.
+         * @param instance the IK instance owned by the worker.
+         */
+        void run(Instance& instance);
+
+    public:
+
+        /**
+         * Destructor.
+         */
+        ~WalkingMultiStartIK();
+
+        /**
+         * Initialize the IK instances and start the worker threads.
+         * @param ikOption the options for the IK;
+         * @param model model of the robot;
+         * @param jointList list of joints to be considered for the inverse kinematics.
+         * @return true/false in case of success/failure.
+         */
+        bool initialize(yarp::os::Searchable& ikOption, const iDynTree::Model& model,
+                        const std::vector<std::string>& jointList);
+
+        /**
+         * Set the joint positions feedback. It is used as initial guess by the first instance.
+         * @param feedback joint positions.
+         * @return true/false in case of success/failure.
+         */
+        bool setFullModelFeedBack(const iDynTree::VectorDynSize& feedback);
+
+        /**
+         * Update the rotation between the inertial and the world frame.
+         * @param inertial_R_worldFrame rotation between the inertial and the world frame.
+         * @return true/false in case of success/failure.
+         */
+        bool updateIntertiaToWorldFrameRotation(const iDynTree::Rotation& inertial_R_worldFrame);
+
+        /**
+         * Return true if the additional rotation target is used.
+         */
+        bool usingAdditionalRotationTarget();
+
+        /**
+         * Compute the inverse kinematics with all the available instances.
+         * @param leftTransform desired transformation of the left foot;
+         * @param rightTransform desired transformation of the right foot;
+         * @param comPosition desired position of the CoM;
+         * @param result best solution found within the time budget.
+         * @return true if at least one instance found a solution.
+         */
+        bool computeIK(const iDynTree::Transform& leftTransform,
+                       const iDynTree::Transform& rightTransform,
+                       const iDynTree::Position& comPosition,
+                       iDynTree::VectorDynSize& result);
+
+        /**
+         * Stop the worker threads.
+         */
+        void close();
+    };
+};
+
+#endif
@@ -25,6 +25,7 @@
 
 #include <WalkingControllers/iDynTreeUtilities/Helper.h>
 #include <WalkingControllers/KinDynWrapper/Wrapper.h>
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematicsAssembler.h>
 
 namespace WalkingControllers
 {
@@ -38,6 +39,43 @@ namespace WalkingControllers
                 sparse(startingRow + i, startingColumn + j) = dense(i, j);
     }
 
+    /**
+     * Kinematic quantities required by the tasks of the QP-IK problem. The quantities related
+     * to the feet, the neck and the CoM are always required.
+     */
+    struct QPIKKinematicRequirements
+    {
+        bool handsJacobians{false}; /**< True if the hands Jacobians are required. */
+        bool handsTransforms{false}; /**< True if the actual and the desired hands transformations are required. */
+        bool retargetingJoints{false}; /**< True if the desired joint retargeting positions are required. */
+    };
+
+    /**
+     * Snapshot of the QP-IK problem solved in a control cycle. The joint velocities bounds are
+     * equal to +/- infinity if they are not considered.
+     */
+    struct QPIKProblem
+    {
+        using MatrixXdRowMajor = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+        MatrixXdRowMajor hessian; /**< Hessian matrix (full). */
+        Eigen::VectorXd gradient; /**< Gradient vector. */
+        MatrixXdRowMajor constraintsMatrix; /**< Constraints matrix of the tasks (feet and CoM). */
+        Eigen::VectorXd lowerBound; /**< Lower bound of the tasks constraints. */
+        Eigen::VectorXd upperBound; /**< Upper bound of the tasks constraints. */
+        Eigen::VectorXd jointVelocitiesLowerBound; /**< Lower bound of the joint velocities. */
+        Eigen::VectorXd jointVelocitiesUpperBound; /**< Upper bound of the joint velocities. */
+        Eigen::VectorXd solution; /**< Solution found by the solver. */
+        double solverTime; /**< Time spent by the solver (seconds). */
+
+        /**
+         * Resize the problem.
+         * @param numberOfVariables number of variables (# of joints + 6);
+         * @param numberOfTasksConstraints number of constraints related to the tasks.
+         */
+        void resize(const int& numberOfVariables, const int& numberOfTasksConstraints);
+    };
+
     class WalkingQPIK
     {
     private:
@@ -45,6 +83,8 @@ namespace WalkingControllers
         enum class RetargetingType { handRetargeting, jointRetargeting, none };
         RetargetingType m_retargetingType;
 
+        QPIKKinematicRequirements m_kinematicRequirements; /**< Kinematic quantities required by the active tasks. */
+
         /**
          * Set the joint positions and velocities bounds
          * @param jointVelocitiesBounds  joint velocities bounds in [rad/s]
@@ -159,7 +199,10 @@ namespace WalkingControllers
         bool m_useCoMAsConstraint; /**< True if the CoM is added as a constraint. */
         bool m_useJointsLimitsConstraint; /**< True if the CoM is added as a constraint. */
 
+        std::unique_ptr<QPIKAssembler> m_assembler; /**< Kernels used to assemble the hessian and the gradient. */
         iDynTree::MatrixDynSize m_hessianDense; /**< Hessian matrix */
+        iDynTree::VectorDynSize m_constantHessianDiagonal; /**< Constant part of the diagonal of the hessian
+                                                              matrix (joint regularization). */
         iDynTree::VectorDynSize m_gradient; /**< Gradient vector */
         iDynSparseMatrix m_constraintsMatrixSparse; /**< Constraint matrix */
         iDynTree::VectorDynSize m_lowerBound; /**< Lower bound */
@@ -196,8 +239,10 @@ namespace WalkingControllers
 
         /**
          * Evaluate the Hessian matrix.
+         * @param upperTriangularOnly if true only the upper triangular part of the hessian
+         * matrix is evaluated.
          */
-        void evaluateHessianMatrix();
+        void evaluateHessianMatrix(const bool& upperTriangularOnly = false);
 
         /**
          * Evaluate the gradient vector.
@@ -229,6 +274,15 @@ namespace WalkingControllers
          */
         virtual void setJointVelocitiesBounds() = 0;
 
+        /**
+         * Get the joint velocities bounds evaluated in the last call of solve(). It is called only
+         * if the joint limits are considered.
+         * @param lowerBound lower bound of the joint velocities;
+         * @param upperBound upper bound of the joint velocities.
+         */
+        virtual void getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                              Eigen::Ref<Eigen::VectorXd> upperBound) const = 0;
+
     public:
         /**
          * Initialize the QP-IK problem.
@@ -246,12 +300,22 @@ namespace WalkingControllers
                         const iDynTree::VectorDynSize& minJointsPosition);
 
         /**
-         * Set the robot state.
+         * Get the kinematic quantities required by the active tasks. The requirements are set
+         * in initialize() and they do not change.
+         * @return the kinematic requirements.
+         */
+        const QPIKKinematicRequirements& getKinematicRequirements() const;
+
+        /**
+         * Set the robot state. Only the quantities required by the active tasks are retrieved.
          * @param kinDynWrapper wrapper required to retrieve information related to the forward
-         * kinematics
+         * kinematics;
+         * @param state state used to evaluate the kinematic quantities (the problem is usually
+         * linearized around the desired state).
          * @return true/false in case of success/failure.
          */
-        bool setRobotState(WalkingFK& kinDynWrapper);
+        bool setRobotState(WalkingFK& kinDynWrapper,
+                           const KinematicsState& state = KinematicsState::Desired);
 
         /**
          * Set the Jacobian of the CoM
@@ -372,6 +436,30 @@ namespace WalkingControllers
          */
         virtual bool solve() = 0;
 
+        /**
+         * Get the number of variables of the QP-IK problem.
+         * @return the number of variables (# of joints + 6).
+         */
+        int getNumberOfVariables() const;
+
+        /**
+         * Get the number of constraints related to the tasks (feet and CoM).
+         * @return the number of the tasks constraints.
+         */
+        int getNumberOfTasksConstraints() const;
+
+        /**
+         * Copy the problem solved in the last call of solve().
+         * @param problem snapshot of the problem. It has to be already resized.
+         */
+        void getProblem(QPIKProblem& problem) const;
+
+        /**
+         * Get the number of iterations performed by the solver in the last call of solve().
+         * @return the number of iterations.
+         */
+        virtual int getNumberOfIterations() const = 0;
+
         /**
          * Get the solution of the optimization problem (base velocity + joint velocities)
          * @return the solution of the optimization problem
@@ -400,6 +488,7 @@ namespace WalkingControllers
 
         /**
          * Get the hessian matrix
+         * @note the osqp backend evaluates only the upper triangular part of the matrix.
          * @return the hessian matrix
          */
         const iDynTree::MatrixDynSize& getHessianMatrix() const;
@@ -412,6 +501,8 @@ namespace WalkingControllers
 
         /**
          * Get the Constraint Matrix
+         * @note the solvers store the constraints matrix in their own buffers, so the returned
+         * matrix is not updated by WalkingQPIK_osqp, WalkingQPIK_qpOASES and WalkingQPIK_KKT
          * @return the constraint matrix
          */
         const iDynSparseMatrix& getConstraintMatrix() const;
@@ -0,0 +1,209 @@
+/**
+ * @file QPInverseKinematicsAssembler.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_ASSEMBLER_H
+#define WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_ASSEMBLER_H
+
+// std
+#include <memory>
+
+// eigen
+#include <Eigen/Dense>
+
+// iDynTree
+#include <iDynTree/Core/MatrixDynSize.h>
+#include <iDynTree/Core/VectorDynSize.h>
+
+namespace WalkingControllers
+{
+
+    /**
+     * QPIKAssembler class. Interface of the kernels used to assemble the hessian matrix and
+     * the gradient vector of the QP-IK problem. The cost of a task is
+     * \f$ 1/2 (J \nu - v)^T W (J \nu - v) \f$, where W is a diagonal weight matrix.
+     * Please use createQPIKAssembler() to instantiate the assembler.
+     */
+    class QPIKAssembler
+    {
+    public:
+
+        /**
+         * Destructor.
+         */
+        virtual ~QPIKAssembler() = default;
+
+        /**
+         * Get the number of variables of the QP-IK problem.
+         * @return the number of variables (# of joints + 6).
+         */
+        virtual int getNumberOfVariables() const = 0;
+
+        /**
+         * Set the upper triangular part of the hessian matrix equal to a diagonal matrix.
+         * @param hessian hessian matrix;
+         * @param diagonal diagonal of the matrix (# of variables).
+         */
+        virtual void setHessianDiagonal(iDynTree::MatrixDynSize& hessian,
+                                        const Eigen::Ref<const Eigen::VectorXd>& diagonal) = 0;
+
+        /**
+         * Add the hessian matrix of a task (\f$ J^T W J \f$) to the upper triangular part of the
+         * hessian matrix. The task is skipped if all the weights are equal to zero.
+         * @param hessian hessian matrix;
+         * @param jacobian jacobian of the task;
+         * @param weight diagonal of the weight matrix (the elements have to be non negative).
+         */
+        virtual void addTaskHessian(iDynTree::MatrixDynSize& hessian,
+                                    const iDynTree::MatrixDynSize& jacobian,
+                                    const Eigen::Ref<const Eigen::VectorXd>& weight) = 0;
+
+        /**
+         * Add a diagonal term to the block of the hessian matrix related to the joints.
+         * @param hessian hessian matrix;
+         * @param weight diagonal term (# of joints).
+         */
+        virtual void addJointsHessian(iDynTree::MatrixDynSize& hessian,
+                                      const Eigen::Ref<const Eigen::VectorXd>& weight) = 0;
+
+        /**
+         * Copy the upper triangular part of the hessian matrix in the lower triangular one.
+         * @param hessian hessian matrix.
+         */
+        virtual void completeHessian(iDynTree::MatrixDynSize& hessian) = 0;
+
+        /**
+         * Set the gradient vector equal to the one of a task (\f$ -J^T W v \f$).
+         * @param gradient gradient vector;
+         * @param jacobian jacobian of the task;
+         * @param weight diagonal of the weight matrix;
+         * @param desiredVelocity desired velocity of the task (v).
+         */
+        virtual void setTaskGradient(iDynTree::VectorDynSize& gradient,
+                                     const iDynTree::MatrixDynSize& jacobian,
+                                     const Eigen::Ref<const Eigen::VectorXd>& weight,
+                                     const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity) = 0;
+
+        /**
+         * Add the gradient vector of a task (\f$ -J^T W v \f$).
+         * @param gradient gradient vector;
+         * @param jacobian jacobian of the task;
+         * @param weight diagonal of the weight matrix;
+         * @param desiredVelocity desired velocity of the task (v).
+         */
+        virtual void addTaskGradient(iDynTree::VectorDynSize& gradient,
+                                     const iDynTree::MatrixDynSize& jacobian,
+                                     const Eigen::Ref<const Eigen::VectorXd>& weight,
+                                     const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity) = 0;
+    };
+
+    /**
+     * Implementation of the QPIKAssembler where the number of variables is known at compile time.
+     * The hessian, the gradient and the jacobians are accessed through fixed-size Eigen maps, so
+     * that the \f$ J^T W J \f$ products are unrolled and vectorized. The hessian of a task is
+     * accumulated on the upper triangular part only with a symmetric rank-k update. The tasks
+     * with 3 or 6 rows are also specialized on the number of rows. If NumberOfVariables is equal
+     * to Eigen::Dynamic the generic implementation is obtained.
+     */
+    template <int NumberOfVariables>
+    class FixedSizeQPIKAssembler : public QPIKAssembler
+    {
+        using HessianMap = Eigen::Map<Eigen::Matrix<double, NumberOfVariables, NumberOfVariables, Eigen::RowMajor>>;
+        using GradientMap = Eigen::Map<Eigen::Matrix<double, NumberOfVariables, 1>>;
+
+        template <int TaskSize>
+        using JacobianMap = Eigen::Map<const Eigen::Matrix<double, TaskSize, NumberOfVariables, Eigen::RowMajor>>;
+
+        template <int TaskSize>
+        using TaskVectorMap = Eigen::Map<const Eigen::Matrix<double, TaskSize, 1>>;
+
+        int m_numberOfVariables; /**< Number of variables of the QP-IK problem. */
+
+        /**
+         * Add the hessian matrix of a task with TaskSize rows to the upper triangular part of the
+         * hessian matrix.
+         * @param hessian hessian matrix;
+         * @param jacobian jacobian of the task;
+         * @param weight diagonal of the weight matrix.
+         */
+        template <int TaskSize>
+        void evaluateTaskHessian(iDynTree::MatrixDynSize& hessian,
+                                 const iDynTree::MatrixDynSize& jacobian,
+                                 const Eigen::Ref<const Eigen::VectorXd>& weight);
+
+        /**
+         * Evaluate the gradient vector of a task with TaskSize rows.
+         * @param gradient gradient vector;
+         * @param jacobian jacobian of the task;
+         * @param weight diagonal of the weight matrix;
+         * @param desiredVelocity desired velocity of the task;
+         * @param accumulate if true the gradient of the task is added to the gradient vector.
+         */
+        template <int TaskSize>
+        void evaluateTaskGradient(iDynTree::VectorDynSize& gradient,
+                                  const iDynTree::MatrixDynSize& jacobian,
+                                  const Eigen::Ref<const Eigen::VectorXd>& weight,
+                                  const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity,
+                                  const bool& accumulate);
+
+    public:
+
+        /**
+         * Constructor.
+         * @param numberOfVariables number of variables of the QP-IK problem. It has to be equal
+         * to NumberOfVariables if the latter is not Eigen::Dynamic.
+         */
+        FixedSizeQPIKAssembler(const int& numberOfVariables);
+
+        int getNumberOfVariables() const final;
+
+        void setHessianDiagonal(iDynTree::MatrixDynSize& hessian,
+                                const Eigen::Ref<const Eigen::VectorXd>& diagonal) final;
+
+        void addTaskHessian(iDynTree::MatrixDynSize& hessian,
+                            const iDynTree::MatrixDynSize& jacobian,
+                            const Eigen::Ref<const Eigen::VectorXd>& weight) final;
+
+        void addJointsHessian(iDynTree::MatrixDynSize& hessian,
+                              const Eigen::Ref<const Eigen::VectorXd>& weight) final;
+
+        void completeHessian(iDynTree::MatrixDynSize& hessian) final;
+
+        void setTaskGradient(iDynTree::VectorDynSize& gradient,
+                             const iDynTree::MatrixDynSize& jacobian,
+                             const Eigen::Ref<const Eigen::VectorXd>& weight,
+                             const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity) final;
+
+        void addTaskGradient(iDynTree::VectorDynSize& gradient,
+                             const iDynTree::MatrixDynSize& jacobian,
+                             const Eigen::Ref<const Eigen::VectorXd>& weight,
+                             const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity) final;
+    };
+
+    /**
+     * Instantiate the QPIKAssembler specialized for the given number of variables.
+     * The specializations are compiled for 29, 31, 35 and 38 variables (i.e. 23, 25, 29 and 32
+     * joints plus the 6 DoFs of the base). For the other sizes the generic implementation is
+     * returned.
+     * @param numberOfVariables number of variables of the QP-IK problem (# of joints + 6);
+     * @param useFixedSize if false the generic implementation is always returned.
+     * @return pointer to the assembler.
+     */
+    std::unique_ptr<QPIKAssembler> createQPIKAssembler(const int& numberOfVariables,
+                                                       const bool& useFixedSize = true);
+
+    // the specializations are compiled in QPInverseKinematicsAssembler.cpp
+    extern template class FixedSizeQPIKAssembler<29>;
+    extern template class FixedSizeQPIKAssembler<31>;
+    extern template class FixedSizeQPIKAssembler<35>;
+    extern template class FixedSizeQPIKAssembler<38>;
+    extern template class FixedSizeQPIKAssembler<Eigen::Dynamic>;
+};
+
+#include "QPInverseKinematicsAssembler.tpp"
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file QPInverseKinematicsAssembler.tpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <cassert>
+
+template <int NumberOfVariables>
+WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+FixedSizeQPIKAssembler(const int& numberOfVariables)
+    :m_numberOfVariables(numberOfVariables)
+{
+    assert(NumberOfVariables == Eigen::Dynamic || NumberOfVariables == numberOfVariables);
+}
+
+template <int NumberOfVariables>
+int WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+getNumberOfVariables() const
+{
+    return m_numberOfVariables;
+}
+
+template <int NumberOfVariables>
+template <int TaskSize>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+evaluateTaskHessian(iDynTree::MatrixDynSize& hessian,
+                    const iDynTree::MatrixDynSize& jacobian,
+                    const Eigen::Ref<const Eigen::VectorXd>& weight)
+{
+    // the iDynTree matrices are stored row major
+    HessianMap hessianMap(hessian.data(), m_numberOfVariables, m_numberOfVariables);
+    JacobianMap<TaskSize> jacobianMap(jacobian.data(), jacobian.rows(), m_numberOfVariables);
+    TaskVectorMap<TaskSize> weightMap(weight.data(), jacobian.rows());
+
+    // J^T W J = (J^T W^(1/2)) (J^T W^(1/2))^T
+    Eigen::Matrix<double, NumberOfVariables, TaskSize> weightedJacobianTransposed
+        = jacobianMap.transpose() * weightMap.cwiseSqrt().asDiagonal();
+
+    hessianMap.template selfadjointView<Eigen::Upper>().rankUpdate(weightedJacobianTransposed);
+}
+
+template <int NumberOfVariables>
+template <int TaskSize>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+evaluateTaskGradient(iDynTree::VectorDynSize& gradient,
+                     const iDynTree::MatrixDynSize& jacobian,
+                     const Eigen::Ref<const Eigen::VectorXd>& weight,
+                     const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity,
+                     const bool& accumulate)
+{
+    GradientMap gradientMap(gradient.data(), m_numberOfVariables);
+    JacobianMap<TaskSize> jacobianMap(jacobian.data(), jacobian.rows(), m_numberOfVariables);
+    TaskVectorMap<TaskSize> weightMap(weight.data(), jacobian.rows());
+    TaskVectorMap<TaskSize> desiredVelocityMap(desiredVelocity.data(), jacobian.rows());
+
+    Eigen::Matrix<double, TaskSize, 1> weightedVelocity = weightMap.cwiseProduct(desiredVelocityMap);
+
+    if(accumulate)
+        gradientMap.noalias() -= jacobianMap.transpose() * weightedVelocity;
+    else
+        gradientMap.noalias() = -jacobianMap.transpose() * weightedVelocity;
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+setHessianDiagonal(iDynTree::MatrixDynSize& hessian,
+                   const Eigen::Ref<const Eigen::VectorXd>& diagonal)
+{
+    HessianMap hessianMap(hessian.data(), m_numberOfVariables, m_numberOfVariables);
+    hessianMap.template triangularView<Eigen::StrictlyUpper>().setZero();
+    hessianMap.diagonal() = diagonal;
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+addTaskHessian(iDynTree::MatrixDynSize& hessian,
+               const iDynTree::MatrixDynSize& jacobian,
+               const Eigen::Ref<const Eigen::VectorXd>& weight)
+{
+    // a task with null weights does not contribute to the hessian matrix
+    if(weight.isZero(0))
+        return;
+
+    if(jacobian.rows() == 3)
+        evaluateTaskHessian<3>(hessian, jacobian, weight);
+    else if(jacobian.rows() == 6)
+        evaluateTaskHessian<6>(hessian, jacobian, weight);
+    else
+        evaluateTaskHessian<Eigen::Dynamic>(hessian, jacobian, weight);
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+addJointsHessian(iDynTree::MatrixDynSize& hessian,
+                 const Eigen::Ref<const Eigen::VectorXd>& weight)
+{
+    HessianMap hessianMap(hessian.data(), m_numberOfVariables, m_numberOfVariables);
+    hessianMap.diagonal().tail(m_numberOfVariables - 6) += weight;
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+completeHessian(iDynTree::MatrixDynSize& hessian)
+{
+    HessianMap hessianMap(hessian.data(), m_numberOfVariables, m_numberOfVariables);
+    hessianMap.template triangularView<Eigen::StrictlyLower>() = hessianMap.transpose();
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+setTaskGradient(iDynTree::VectorDynSize& gradient,
+                const iDynTree::MatrixDynSize& jacobian,
+                const Eigen::Ref<const Eigen::VectorXd>& weight,
+                const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity)
+{
+    if(jacobian.rows() == 3)
+        evaluateTaskGradient<3>(gradient, jacobian, weight, desiredVelocity, false);
+    else if(jacobian.rows() == 6)
+        evaluateTaskGradient<6>(gradient, jacobian, weight, desiredVelocity, false);
+    else
+        evaluateTaskGradient<Eigen::Dynamic>(gradient, jacobian, weight, desiredVelocity, false);
+}
+
+template <int NumberOfVariables>
+void WalkingControllers::FixedSizeQPIKAssembler<NumberOfVariables>::
+addTaskGradient(iDynTree::VectorDynSize& gradient,
+                const iDynTree::MatrixDynSize& jacobian,
+                const Eigen::Ref<const Eigen::VectorXd>& weight,
+                const Eigen::Ref<const Eigen::VectorXd>& desiredVelocity)
+{
+    if(jacobian.rows() == 3)
+        evaluateTaskGradient<3>(gradient, jacobian, weight, desiredVelocity, true);
+    else if(jacobian.rows() == 6)
+        evaluateTaskGradient<6>(gradient, jacobian, weight, desiredVelocity, true);
+    else
+        evaluateTaskGradient<Eigen::Dynamic>(gradient, jacobian, weight, desiredVelocity, true);
+}
@@ -0,0 +1,235 @@
+/**
+ * @file QPInverseKinematicsShadow.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_SHADOW_H
+#define WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_SHADOW_H
+
+// std
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+// YARP
+#include <yarp/os/Searchable.h>
+#include <yarp/sig/Vector.h>
+
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics.h>
+
+namespace WalkingControllers
+{
+
+    /**
+     * Bounded lock-free queue with a single producer and a single consumer. The elements are
+     * allocated once, the producer writes directly in the free slot and the consumer reads
+     * directly from the oldest one, so no memory is allocated while the queue is used.
+     */
+    template <typename T>
+    class SingleProducerSingleConsumerQueue
+    {
+        std::vector<T> m_elements; /**< Storage of the queue (one slot is always empty). */
+        std::atomic<std::size_t> m_head{0}; /**< Index of the oldest element (written by the consumer). */
+        std::atomic<std::size_t> m_tail{0}; /**< Index of the free slot (written by the producer). */
+
+    public:
+
+        /**
+         * Resize the queue. It must be called before the producer and the consumer are started.
+         * @param capacity maximum number of elements stored in the queue;
+         * @param element value used to initialize all the slots.
+         */
+        void resize(const std::size_t& capacity, const T& element)
+        {
+            m_elements.assign(capacity + 1, element);
+            m_head = 0;
+            m_tail = 0;
+        }
+
+        /**
+         * Get the free slot (producer side).
+         * @return pointer to the slot or nullptr if the queue is full.
+         */
+        T* back()
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if((tail + 1) % m_elements.size() == m_head.load(std::memory_order_acquire))
+                return nullptr;
+
+            return &m_elements[tail];
+        }
+
+        /**
+         * Make the slot returned by back() available to the consumer (producer side).
+         */
+        void push()
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            m_tail.store((tail + 1) % m_elements.size(), std::memory_order_release);
+        }
+
+        /**
+         * Get the oldest element (consumer side).
+         * @return pointer to the element or nullptr if the queue is empty.
+         */
+        T* front()
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            if(head == m_tail.load(std::memory_order_acquire))
+                return nullptr;
+
+            return &m_elements[head];
+        }
+
+        /**
+         * Release the element returned by front() (consumer side).
+         */
+        void pop()
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            m_head.store((head + 1) % m_elements.size(), std::memory_order_release);
+        }
+    };
+
+    /**
+     * Solver used to solve a QPIKProblem in the shadow mode.
+     */
+    class QPIKShadowSolver
+    {
+    public:
+
+        /**
+         * Destructor.
+         */
+        virtual ~QPIKShadowSolver() = default;
+
+        /**
+         * Initialize the solver.
+         * @param numberOfVariables number of variables (# of joints + 6);
+         * @param numberOfTasksConstraints number of constraints related to the tasks.
+         */
+        virtual void initialize(const int& numberOfVariables, const int& numberOfTasksConstraints) = 0;
+
+        /**
+         * Solve the problem.
+         * @param problem the problem;
+         * @param solution solution of the problem.
+         * @return true/false in case of success/failure.
+         */
+        virtual bool solve(const QPIKProblem& problem, Eigen::VectorXd& solution) = 0;
+    };
+
+    /**
+     * Instantiate a shadow solver.
+     * @param name name of the solver (osqp or qpOASES);
+     * @return pointer to the solver or nullptr if the name is not valid.
+     */
+    std::unique_ptr<QPIKShadowSolver> createQPIKShadowSolver(const std::string& name);
+
+    /**
+     * WalkingQPIKShadow class. The problems solved by the QP-IK used to control the robot are
+     * copied in a lock-free queue and solved again by other solvers in a worker thread. The
+     * latency of the solvers and the distance between their solutions and the one used to
+     * control the robot are collected in order to compare the solvers on the real problems
+     * without affecting the control loop.
+     */
+    class WalkingQPIKShadow
+    {
+        /**
+         * Statistics of a solver.
+         */
+        struct SolverStatistics
+        {
+            std::vector<double> latencies; /**< Last latencies of the solver (circular buffer). */
+            std::size_t numberOfSamples{0}; /**< Number of the collected latencies. */
+            double meanLatency{0}; /**< Mean latency. */
+            double maxLatency{0}; /**< Maximum latency. */
+            int numberOfFailures{0}; /**< Number of failures. */
+            double solutionError{0}; /**< Infinity norm of the difference between the last solutions. */
+            double maxSolutionError{0}; /**< Maximum of solutionError. */
+        };
+
+        SingleProducerSingleConsumerQueue<QPIKProblem> m_problems; /**< Queue of the problems. */
+        std::atomic<int> m_numberOfDroppedProblems{0}; /**< Number of problems not queued (queue full). */
+
+        std::vector<std::string> m_solversName; /**< Name of the shadow solvers. */
+        std::vector<std::unique_ptr<QPIKShadowSolver>> m_solvers; /**< Shadow solvers. */
+        Eigen::VectorXd m_shadowSolution; /**< Solution of a shadow solver. */
+
+        std::vector<SolverStatistics> m_statistics; /**< Statistics (primary solver and then shadow solvers). */
+        std::vector<double> m_sortedLatencies; /**< Buffer used to evaluate the percentiles. */
+        yarp::sig::Vector m_statisticsVector; /**< Statistics stored as a vector. */
+        std::mutex m_statisticsMutex; /**< Mutex protecting m_statisticsVector. */
+
+        std::thread m_worker; /**< Thread where the shadow solvers run. */
+        std::atomic<bool> m_isRunning{false}; /**< True if the worker thread is running. */
+
+        /**
+         * Main loop of the worker thread.
+         */
+        void run();
+
+        /**
+         * Add a new latency to the statistics.
+         * @param statistics statistics of the solver;
+         * @param latency latency of the solver (seconds).
+         */
+        void addLatency(SolverStatistics& statistics, const double& latency);
+
+        /**
+         * Store the statistics in m_statisticsVector.
+         */
+        void updateStatisticsVector();
+
+    public:
+
+        /**
+         * Destructor.
+         */
+        ~WalkingQPIKShadow();
+
+        /**
+         * Initialize the shadow solvers and start the worker thread.
+         * @param config configuration parameters;
+         * @param primarySolver solver used to control the robot.
+         * @return true/false in case of success/failure.
+         */
+        bool initialize(const yarp::os::Searchable& config, const WalkingQPIK& primarySolver);
+
+        /**
+         * Copy the problem solved by the primary solver in the queue. If the queue is full the
+         * problem is dropped.
+         * @param primarySolver solver used to control the robot;
+         * @param solverTime time spent by the primary solver (seconds).
+         * @return true if the problem is queued.
+         */
+        bool pushProblem(const WalkingQPIK& primarySolver, const double& solverTime);
+
+        /**
+         * Get the statistics. The vector contains the number of the dropped problems and then,
+         * for the primary solver and for each shadow solver, the mean, the 50th percentile,
+         * the 99th percentile and the maximum of the latency (seconds), the number of failures,
+         * the last and the maximum infinity norm of the difference between the solution of the
+         * solver and the one of the primary solver.
+         * @param statistics vector containing the statistics.
+         * @return false if the statistics are being updated by the worker thread.
+         */
+        bool getStatistics(yarp::sig::Vector& statistics);
+
+        /**
+         * Stop the worker thread.
+         */
+        void close();
+    };
+};
+
+#endif
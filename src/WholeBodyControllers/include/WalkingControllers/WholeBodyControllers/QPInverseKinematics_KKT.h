@@ -0,0 +1,122 @@
+/**
+ * @file QPInverseKinematics_KKT.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#ifndef WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_KKT_H
+#define WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_KKT_H
+
+// std
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics.h>
+
+namespace WalkingControllers
+{
+
+    /**
+     * QP-IK solved with a dense null-space method. The feet (and the CoM) tasks are equality
+     * constraints, so the problem is solved in closed form by projecting the cost in the null
+     * space of the constraints. The joint velocity bounds are handled with a primal-dual
+     * active-set loop where the active bounds are added as equality constraints. The active set
+     * is kept between two consecutive calls of solve() (warm start). If the loop does not converge
+     * (or a bound cannot be added to the working set) the solution is saturated to the bounds.
+     */
+    class WalkingQPIK_KKT : public WalkingQPIK
+    {
+        /**
+         * Status of the bound of a joint velocity.
+         */
+        enum class BoundStatus {inactive, lower, upper};
+
+        iDynTree::VectorDynSize m_minJointLimit; /**< Lower bound of the joint velocities. */
+        iDynTree::VectorDynSize m_maxJointLimit; /**< Upper bound of the joint velocities. */
+        std::vector<BoundStatus> m_jointBoundsStatus; /**< Status of the joint velocity bounds (active set). */
+
+        int m_numberOfTasksConstraints; /**< Number of constraints related to the tasks (feet and CoM). */
+        int m_maxActiveSetIterations; /**< Maximum number of iterations of the active-set loop. */
+        int m_numberOfActiveSetIterations{0}; /**< Number of iterations of the active-set loop in the last call of solve(). */
+        int m_numberOfActiveConstraints{0}; /**< Number of equality constraints (tasks and active bounds) of the last iterate. */
+
+        Eigen::MatrixXd m_constraintsMatrixDense; /**< Matrix of the equality constraints (tasks and active bounds). */
+        Eigen::VectorXd m_constraintsVector; /**< Right hand side of the equality constraints. */
+
+        Eigen::HouseholderQR<Eigen::MatrixXd> m_constraintsQR; /**< QR decomposition of the transposed constraints matrix. */
+        Eigen::MatrixXd m_orthogonalMatrix; /**< Q matrix of the QR decomposition. */
+        Eigen::MatrixXd m_nullSpaceHessian; /**< Hessian matrix projected in the null space of the constraints. */
+        Eigen::MatrixXd m_hessianTimesNullSpace; /**< Product between the hessian and the null space basis. */
+        Eigen::LLT<Eigen::MatrixXd> m_nullSpaceHessianLLT; /**< Cholesky decomposition of the projected hessian. */
+
+        Eigen::VectorXd m_rangeSpaceSolution; /**< Component of the solution in the range space of the constraints. */
+        Eigen::VectorXd m_nullSpaceSolution; /**< Component of the solution in the null space of the constraints. */
+        Eigen::VectorXd m_costGradient; /**< Gradient of the cost evaluated at the solution. */
+        Eigen::VectorXd m_multipliers; /**< Lagrange multipliers of the equality constraints. */
+
+        /**
+         * Set joints velocity bounds
+         * @return true/false in case of success/failure.
+         */
+        virtual void setJointVelocitiesBounds() final;
+
+        /**
+         * Get the joint velocities bounds evaluated in the last call of solve().
+         * @param lowerBound lower bound of the joint velocities;
+         * @param upperBound upper bound of the joint velocities.
+         */
+        virtual void getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                              Eigen::Ref<Eigen::VectorXd> upperBound) const final;
+
+        /**
+         * Solve the problem considering the tasks and the active bounds as equality constraints.
+         * The solution and the Lagrange multipliers are stored in m_solution and in m_multipliers.
+         * @return true/false in case of success/failure.
+         */
+        bool solveEqualityConstrainedProblem();
+
+        /**
+         * Update the active set according to the last solution. The bounds that are linearly
+         * dependent on the active constraints are not added to the working set.
+         * @param isOptimal is true if the active set does not change.
+         */
+        void updateActiveSet(bool& isOptimal);
+
+    protected:
+
+        /**
+         * Initialize the solver
+         */
+        virtual void instantiateSolver() final;
+
+        /**
+         * Set the number of constraints (it may change according to the solver used)
+         */
+        virtual void setNumberOfConstraints() final;
+
+        /**
+         * Initialize matrices that depends on the solver used
+         */
+        virtual void initializeSolverSpecificMatrices() final;
+
+    public:
+
+        /**
+         * Solve the optimization problem.
+         * @return true/false in case of success/failure.
+         */
+        virtual bool solve() final;
+
+        /**
+         * Get the number of iterations of the active-set loop performed in the last call of solve().
+         * @return the number of iterations.
+         */
+        virtual int getNumberOfIterations() const final;
+    };
+};
+
+#endif
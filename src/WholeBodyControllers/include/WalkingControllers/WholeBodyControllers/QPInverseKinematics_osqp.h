@@ -20,12 +20,46 @@ namespace WalkingControllers
     {
         std::unique_ptr<OsqpEigen::Solver> m_optimizerSolver; /**< Optimization solver. */
 
+        /**
+         * Upper triangular part of the hessian matrix. The sparsity pattern (dense upper triangle)
+         * is set in initializeSolverSpecificMatrices() and only the values are updated.
+         */
+        Eigen::SparseMatrix<double> m_hessianUpperTriangular;
+
+        /**
+         * Constraints matrix. The rows related to the tasks (feet and CoM) are dense while the
+         * rows related to the joint limits contain the identity matrix. The sparsity pattern is
+         * set in initializeSolverSpecificMatrices() and only the values are updated.
+         */
+        Eigen::SparseMatrix<double> m_constraintsMatrix;
+
+        int m_numberOfTasksConstraints; /**< Number of constraints related to the tasks (feet and CoM). */
+
+        /**
+         * Copy the upper triangular part of the dense hessian matrix in the values array of
+         * the sparse hessian matrix.
+         */
+        void updateHessianValues();
+
+        /**
+         * Copy the Jacobians of the tasks in the values array of the sparse constraints matrix.
+         */
+        void updateConstraintsMatrixValues();
+
         /**
          * Set joints velocity bounds
          * @return true/false in case of success/failure.
          */
         virtual void setJointVelocitiesBounds() final;
 
+        /**
+         * Get the joint velocities bounds evaluated in the last call of solve().
+         * @param lowerBound lower bound of the joint velocities;
+         * @param upperBound upper bound of the joint velocities.
+         */
+        virtual void getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                              Eigen::Ref<Eigen::VectorXd> upperBound) const final;
+
         /**
          * Initialize the solver
          */
@@ -59,6 +93,12 @@ namespace WalkingControllers
          * @return true/false in case of success/failure.
          */
         virtual bool solve() final;
+
+        /**
+         * Get the number of ADMM iterations performed in the last call of solve().
+         * @return the number of iterations.
+         */
+        virtual int getNumberOfIterations() const final;
     };
 };
 
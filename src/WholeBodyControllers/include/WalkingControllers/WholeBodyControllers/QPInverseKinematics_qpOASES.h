@@ -9,6 +9,9 @@
 #ifndef WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_QPOASES_H
 #define WALKING_CONTROLLERS_WHOLE_BODY_CONTROLLERS_CONTROLLERS_QP_IK_QPOASES_H
 
+// eigen
+#include <Eigen/Dense>
+
 #include <qpOASES.hpp>
 
 #include <WalkingControllers/WholeBodyControllers/QPInverseKinematics.h>
@@ -19,17 +22,44 @@ namespace WalkingControllers
     {
         std::unique_ptr<qpOASES::SQProblem> m_optimizer{nullptr}; /**< Optimization solver. */
 
+        /**
+         * Constraints matrix stored row major as required by qpOASES. The rows are written
+         * directly from the Jacobians of the tasks.
+         */
+        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> m_constraintsMatrixDense;
+
         iDynTree::VectorDynSize  m_minJointLimit;
         iDynTree::VectorDynSize  m_maxJointLimit;
 
+        qpOASES::Bounds m_guessedBounds; /**< Working set of the bounds used to initialize the solver again. */
+        qpOASES::Constraints m_guessedConstraints; /**< Working set of the constraints used to initialize the solver again. */
+
+        int m_maxNumberOfWorkingSetRecalculations{100}; /**< Maximum number of working set recalculations (nWSR). */
+        int m_numberOfWorkingSetRecalculations{0}; /**< Number of working set recalculations of the last call of solve(). */
+
         bool m_isFirstTime;
 
+        /**
+         * Initialize the solver. The working set of the previous solution is used as initial guess.
+         * @param useGuessedWorkingSet if true m_guessedBounds and m_guessedConstraints are used.
+         * @return true/false in case of success/failure.
+         */
+        bool initializeSolver(const bool& useGuessedWorkingSet);
+
         /**
          * Set joints velocity bounds
          * @return true/false in case of success/failure.
          */
         virtual void setJointVelocitiesBounds() final;
 
+        /**
+         * Get the joint velocities bounds evaluated in the last call of solve().
+         * @param lowerBound lower bound of the joint velocities;
+         * @param upperBound upper bound of the joint velocities.
+         */
+        virtual void getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                              Eigen::Ref<Eigen::VectorXd> upperBound) const final;
+
     protected:
 
         /**
@@ -50,10 +80,18 @@ namespace WalkingControllers
     public:
 
         /**
-         * Solve the optimization problem.
+         * Solve the optimization problem. The solver is hotstarted from the working set of the
+         * previous solution. If the hotstart fails the solver is initialized again from the last
+         * working set.
          * @return true/false in case of success/failure.
          */
         virtual bool solve() final;
+
+        /**
+         * Get the number of working set recalculations (nWSR) performed in the last call of solve().
+         * @return the number of iterations.
+         */
+        virtual int getNumberOfIterations() const final;
     };
 };
 #endif
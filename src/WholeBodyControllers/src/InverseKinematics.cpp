@@ -23,6 +23,10 @@
 #include <iDynTree/yarp/YARPConfigurationsLoader.h>
 #include <iDynTree/KinDynComputations.h>
 
+// std
+#include <algorithm>
+#include <limits>
+
 // Eigen
 #include <Eigen/Core>
 
@@ -35,9 +39,14 @@ WalkingIK::WalkingIK()
     , m_lFootFrame("l_sole")
     , m_rFootFrame("r_sole")
     , m_inertial_R_world(iDynTree::Rotation::Identity())
+    , m_useDiagnostics(false)
     , m_prepared(false)
+    , m_isFeedbackUpdated(true)
+    , m_isJointRegularizationUpdated(true)
     , m_additionalRotationWeight(1.0)
     , m_jointRegularizationWeight(0.5)
+    , m_useLevenbergMarquardt(false)
+    , m_numberOfLMIterations(0)
 {}
 
 WalkingIK::~WalkingIK()
@@ -55,6 +64,15 @@ bool WalkingIK::initialize(yarp::os::Searchable& ikOption, const iDynTree::Model
     std::string rFootFrame = ikOption.check("right_foot_frame", yarp::os::Value("r_sole")).asString();
     std::string solverName = ikOption.check("solver_name", yarp::os::Value("mumps")).asString();
     m_additionalFrame = ikOption.check("additional_frame", yarp::os::Value("")).asString();
+    m_useDiagnostics = ikOption.check("use_diagnostics", yarp::os::Value(false)).asBool();
+
+    // Levenberg-Marquardt solver
+    m_useLevenbergMarquardt = ikOption.check("use_levenberg_marquardt", yarp::os::Value(false)).asBool();
+    m_maxLMIterations = ikOption.check("lm_max_iterations", yarp::os::Value(50)).asInt();
+    m_LMInitialDamping = ikOption.check("lm_initial_damping", yarp::os::Value(1e-3)).asDouble();
+    m_LMConstraintsTolerance = ikOption.check("lm_constraints_tolerance", yarp::os::Value(1e-4)).asDouble();
+    m_LMStepTolerance = ikOption.check("lm_step_tolerance", yarp::os::Value(1e-6)).asDouble();
+    m_LMConstraintsWeight = ikOption.check("lm_constraints_weight", yarp::os::Value(1e4)).asDouble();
     if(m_additionalFrame.size()!=0)
     {
         if(!iDynTree::parseRotationMatrix(ikOption, "additional_rotation", m_additionalRotation))
@@ -156,9 +174,13 @@ bool WalkingIK::initialize(yarp::os::Searchable& ikOption, const iDynTree::Model
         return false;
     }
 
-    m_ik.setMaxCPUTime(maxCpuTime);
-    m_ik.setVerbosity(solverVerbosity);
-    m_ik.setLinearSolverName(solverName);
+    // IPOPT is not used by the Levenberg-Marquardt solver
+    if(!m_useLevenbergMarquardt)
+    {
+        m_ik.setMaxCPUTime(maxCpuTime);
+        m_ik.setVerbosity(solverVerbosity);
+        m_ik.setLinearSolverName(solverName);
+    }
 
     if (m_verbose)
     {
@@ -197,10 +219,14 @@ bool WalkingIK::setFootFrame(const std::string& foot, const std::string& footFra
 {
     if (foot == "left")
     {
+        if (m_lFootFrame == footFrame && m_prepared)
+            return true;
         m_lFootFrame = footFrame;
     }
     else if (foot == "right")
     {
+        if (m_rFootFrame == footFrame && m_prepared)
+            return true;
         m_rFootFrame = footFrame;
     }
     else
@@ -234,6 +260,7 @@ bool WalkingIK::setFullModelFeedBack(const iDynTree::VectorDynSize& feedback)
         return false;
     }
     m_feedback = feedback;
+    m_isFeedbackUpdated = true;
     return true;
 }
 
@@ -246,6 +273,46 @@ bool WalkingIK::prepareIK()
         return false;
     }
 
+    m_baseTransform = m_ik.fullModel().getFrameTransform( m_ik.fullModel().getFrameIndex(m_lFootFrame) ).inverse();
+
+    // the IPOPT problem is not built when the Levenberg-Marquardt solver is used
+    if(!m_useLevenbergMarquardt && !prepareIPOPT())
+    {
+        yError() << "WalkingIK: Unable to prepare the IPOPT problem.";
+        return false;
+    }
+
+    // the checker is used only to evaluate the diagnostics
+    if(m_useDiagnostics)
+    {
+        iDynTree::LinkIndex baseDebug = m_ik.reducedModel().getFrameLink(m_ik.reducedModel().getFrameIndex(m_lFootFrame));
+        lchecker.loadRobotModel(m_ik.reducedModel());
+        if(!lchecker.setFloatingBase(m_ik.reducedModel().getLinkName(baseDebug)))
+            return false;
+
+        dummyVel.resize(static_cast<unsigned int>(m_ik.reducedModel().getNrOfDOFs()));
+        dummyVel.zero();
+        dummyBaseVel.zero();
+        dummygrav.zero();
+    }
+
+    // the problem has been cleared so the feedback and the regularization have to be set again
+    m_isFeedbackUpdated = true;
+    m_isJointRegularizationUpdated = true;
+
+    if(m_useLevenbergMarquardt && !prepareLevenbergMarquardt())
+    {
+        yError() << "WalkingIK: Unable to prepare the Levenberg-Marquardt solver.";
+        return false;
+    }
+
+    m_prepared = true;
+
+    return true;
+}
+
+bool WalkingIK::prepareIPOPT()
+{
     m_ik.clearProblem();
 
     m_ik.setMaxCPUTime(maxCpuTime);
@@ -255,9 +322,6 @@ bool WalkingIK::prepareIK()
     m_ik.setDefaultTargetResolutionMode(iDynTree::InverseKinematicsTreatTargetAsConstraintFull);
 
     iDynTree::LinkIndex base = m_ik.fullModel().getFrameLink(m_ik.fullModel().getFrameIndex(m_lFootFrame));
-
-    m_baseTransform = m_ik.fullModel().getFrameTransform( m_ik.fullModel().getFrameIndex(m_lFootFrame) ).inverse();
-
     if(!m_ik.setFloatingBaseOnFrameNamed(m_ik.fullModel().getLinkName(base)))
     {
         yError() << "WalkingIK: Invalid frame selected for the left foot: "<< m_lFootFrame;
@@ -290,18 +354,213 @@ bool WalkingIK::prepareIK()
     m_ik.setConstraintsTolerance(1e-4);
     m_ik.setCOMAsConstraintTolerance(1e-4);
 
-    ///DEBUG
-    iDynTree::LinkIndex baseDebug = m_ik.reducedModel().getFrameLink(m_ik.reducedModel().getFrameIndex(m_lFootFrame));
-    lchecker.loadRobotModel(m_ik.reducedModel());
-    if(!lchecker.setFloatingBase(m_ik.reducedModel().getLinkName(baseDebug)))
+    return true;
+}
+
+bool WalkingIK::prepareLevenbergMarquardt()
+{
+    const iDynTree::Model& model = m_ik.reducedModel();
+    unsigned int dofs = static_cast<unsigned int>(model.getNrOfDOFs());
+
+    // the floating base is attached to the left foot, as in the IPOPT problem
+    if(!m_LMKinDyn.loadRobotModel(model))
+    {
+        yError() << "WalkingIK: Unable to load the model in the Levenberg-Marquardt solver.";
         return false;
+    }
 
-    dummyVel.resize(static_cast<unsigned int>(m_ik.reducedModel().getNrOfDOFs()));
-    dummyVel.zero();
-    dummyBaseVel.zero();
-    dummygrav.zero();
+    iDynTree::LinkIndex base = model.getFrameLink(model.getFrameIndex(m_lFootFrame));
+    if(!m_LMKinDyn.setFloatingBase(model.getLinkName(base)))
+    {
+        yError() << "WalkingIK: Invalid frame selected for the left foot: "<< m_lFootFrame;
+        return false;
+    }
+    m_LMKinDyn.setFrameVelocityRepresentation(iDynTree::MIXED_REPRESENTATION);
 
-    m_prepared = true;
+    m_LMRightFootFrameIndex = model.getFrameIndex(m_rFootFrame);
+    if(m_LMRightFootFrameIndex == iDynTree::FRAME_INVALID_INDEX)
+    {
+        yError() << "WalkingIK: Invalid frame selected for the right foot: "<< m_rFootFrame;
+        return false;
+    }
+
+    if(m_additionalFrame.size() != 0)
+    {
+        m_LMAdditionalFrameIndex = model.getFrameIndex(m_additionalFrame);
+        if(m_LMAdditionalFrameIndex == iDynTree::FRAME_INVALID_INDEX)
+        {
+            yError() << "WalkingIK: Invalid additional frame: "<< m_additionalFrame;
+            return false;
+        }
+    }
+
+    m_jointsLowerLimits = Eigen::VectorXd::Constant(dofs, -std::numeric_limits<double>::infinity());
+    m_jointsUpperLimits = Eigen::VectorXd::Constant(dofs, std::numeric_limits<double>::infinity());
+    for(iDynTree::JointIndex jointIdx = 0; jointIdx < static_cast<int>(model.getNrOfJoints()); ++jointIdx)
+    {
+        iDynTree::IJointConstPtr joint = model.getJoint(jointIdx);
+        if(joint->getNrOfDOFs() != 1 || !joint->hasPosLimits())
+            continue;
+
+        double jointMin, jointMax;
+        if(!joint->getPosLimits(0, jointMin, jointMax))
+            continue;
+
+        m_jointsLowerLimits(joint->getDOFsOffset()) = jointMin;
+        m_jointsUpperLimits(joint->getDOFsOffset()) = jointMax;
+    }
+
+    m_LMJointVelocities.resize(dofs);
+    m_LMJointVelocities.zero();
+    m_LMBaseVelocity.zero();
+    m_LMGravity.zero();
+
+    m_LMFrameJacobian.resize(6, dofs + 6);
+    m_LMCoMJacobian.resize(3, dofs + 6);
+    m_LMCandidate.resize(dofs);
+
+    m_constraintsJacobian.resize(9, dofs);
+    m_additionalRotationJacobian.resize(3, dofs);
+
+    // the bottom right block of the KKT matrix is always zero
+    m_KKTMatrix = Eigen::MatrixXd::Zero(dofs + 9, dofs + 9);
+    m_KKTVector.resize(dofs + 9);
+    m_KKTSolution.resize(dofs + 9);
+    m_KKTSolver = Eigen::PartialPivLU<Eigen::MatrixXd>(dofs + 9);
+
+    return true;
+}
+
+bool WalkingIK::evaluateLMErrors(const iDynTree::VectorDynSize& jointPositions,
+                                 const iDynTree::Transform& desiredRightTransform,
+                                 const iDynTree::Position& desiredCoMPosition,
+                                 const iDynTree::Rotation& desiredAdditionalRotation,
+                                 double& merit)
+{
+    if(!m_LMKinDyn.setRobotState(m_baseTransform, jointPositions, m_LMBaseVelocity,
+                                 m_LMJointVelocities, m_LMGravity))
+    {
+        yError() << "WalkingIK: Unable to set the state in the Levenberg-Marquardt solver.";
+        return false;
+    }
+
+    // the orientation errors are expressed in the left foot frame
+    iDynTree::Transform rightTransform = m_LMKinDyn.getWorldTransform(m_LMRightFootFrameIndex);
+    iDynTree::Position rightPositionError = desiredRightTransform.getPosition() - rightTransform.getPosition();
+    iDynTree::AngularMotionVector3 rightRotationError = (desiredRightTransform.getRotation()
+                                                         * rightTransform.getRotation().inverse()).log();
+    iDynTree::Position comError = desiredCoMPosition - m_LMKinDyn.getCenterOfMassPosition();
+
+    m_constraintsError.head<3>() = iDynTree::toEigen(rightPositionError);
+    m_constraintsError.segment<3>(3) = iDynTree::toEigen(rightRotationError);
+    m_constraintsError.tail<3>() = iDynTree::toEigen(comError);
+
+    merit = 0.5 * m_LMConstraintsWeight * m_constraintsError.squaredNorm()
+        + 0.5 * m_jointRegularizationWeight
+        * (iDynTree::toEigen(jointPositions) - iDynTree::toEigen(m_jointRegularization)).squaredNorm();
+
+    if(m_additionalFrame.size() != 0)
+    {
+        iDynTree::AngularMotionVector3 additionalRotationError = (desiredAdditionalRotation
+                                                                  * m_LMKinDyn.getWorldTransform(m_LMAdditionalFrameIndex).getRotation().inverse()).log();
+        m_additionalRotationError = iDynTree::toEigen(additionalRotationError);
+        merit += 0.5 * m_additionalRotationWeight * m_additionalRotationError.squaredNorm();
+    }
+
+    return true;
+}
+
+bool WalkingIK::solveLevenbergMarquardt(const iDynTree::Transform& desiredRightTransform,
+                                        const iDynTree::Position& desiredCoMPosition,
+                                        const iDynTree::Rotation& desiredAdditionalRotation)
+{
+    int dofs = m_qResult.size();
+    auto solution(iDynTree::toEigen(m_qResult));
+    auto candidate(iDynTree::toEigen(m_LMCandidate));
+    auto jointRegularization(iDynTree::toEigen(m_jointRegularization));
+
+    // the initial guess is projected on the joint limits
+    solution = iDynTree::toEigen(m_guess).cwiseMax(m_jointsLowerLimits).cwiseMin(m_jointsUpperLimits);
+
+    double merit;
+    if(!evaluateLMErrors(m_qResult, desiredRightTransform, desiredCoMPosition,
+                         desiredAdditionalRotation, merit))
+        return false;
+
+    double damping = m_LMInitialDamping;
+    auto hessian = m_KKTMatrix.topLeftCorner(dofs, dofs);
+    auto gradient = m_KKTVector.head(dofs);
+    auto step = m_KKTSolution.head(dofs);
+
+    m_numberOfLMIterations = 0;
+    while(m_numberOfLMIterations < m_maxLMIterations)
+    {
+        m_numberOfLMIterations++;
+
+        // the kinematics has been updated with the current solution by evaluateLMErrors()
+        m_LMKinDyn.getFrameFreeFloatingJacobian(m_LMRightFootFrameIndex, m_LMFrameJacobian);
+        m_constraintsJacobian.topRows<6>() = iDynTree::toEigen(m_LMFrameJacobian).rightCols(dofs);
+        m_LMKinDyn.getCenterOfMassJacobian(m_LMCoMJacobian);
+        m_constraintsJacobian.bottomRows<3>() = iDynTree::toEigen(m_LMCoMJacobian).rightCols(dofs);
+
+        // min 1/2 |J_a dq - e_a|^2_w + 1/2 w_j |q + dq - q_des|^2 + 1/2 damping |dq|^2
+        // s.t. J_c dq = e_c
+        hessian.setIdentity();
+        hessian *= m_jointRegularizationWeight + damping;
+        gradient = -m_jointRegularizationWeight * (solution - jointRegularization);
+
+        if(m_additionalFrame.size() != 0)
+        {
+            m_LMKinDyn.getFrameFreeFloatingJacobian(m_LMAdditionalFrameIndex, m_LMFrameJacobian);
+            m_additionalRotationJacobian = iDynTree::toEigen(m_LMFrameJacobian).bottomRightCorner(3, dofs);
+            hessian.noalias() += m_additionalRotationWeight * m_additionalRotationJacobian.transpose()
+                * m_additionalRotationJacobian;
+            gradient.noalias() += m_additionalRotationWeight * m_additionalRotationJacobian.transpose()
+                * m_additionalRotationError;
+        }
+
+        m_KKTMatrix.topRightCorner(dofs, 9) = m_constraintsJacobian.transpose();
+        m_KKTMatrix.bottomLeftCorner(9, dofs) = m_constraintsJacobian;
+        m_KKTVector.tail<9>() = m_constraintsError;
+
+        m_KKTSolver.compute(m_KKTMatrix);
+        m_KKTSolution = m_KKTSolver.solve(m_KKTVector);
+
+        candidate = (solution + step).cwiseMax(m_jointsLowerLimits).cwiseMin(m_jointsUpperLimits);
+
+        double candidateMerit;
+        if(!evaluateLMErrors(m_LMCandidate, desiredRightTransform, desiredCoMPosition,
+                             desiredAdditionalRotation, candidateMerit))
+            return false;
+
+        double stepNorm = (candidate - solution).lpNorm<Eigen::Infinity>();
+        if(candidateMerit < merit)
+        {
+            solution = candidate;
+            merit = candidateMerit;
+            damping = std::max(damping * 0.1, 1e-9);
+        }
+        else
+        {
+            // the step is rejected and the kinematics is evaluated again in the current solution
+            damping *= 10;
+            if(!evaluateLMErrors(m_qResult, desiredRightTransform, desiredCoMPosition,
+                                 desiredAdditionalRotation, merit))
+                return false;
+        }
+
+        if(stepNorm < m_LMStepTolerance)
+            break;
+    }
+
+    // m_constraintsError is related to the current solution
+    if(m_constraintsError.lpNorm<Eigen::Infinity>() > m_LMConstraintsTolerance)
+    {
+        yError() << "WalkingIK: The Levenberg-Marquardt solver did not satisfy the constraints in "
+                 << m_numberOfLMIterations << " iterations. Error: "
+                 << m_constraintsError.lpNorm<Eigen::Infinity>();
+        return false;
+    }
 
     return true;
 }
@@ -339,6 +598,7 @@ bool WalkingIK::setDesiredJointConfiguration(const iDynTree::VectorDynSize& desi
     }
 
     m_jointRegularization = desiredJointConfiguration;
+    m_isJointRegularizationUpdated = true;
 
     return true;
 }
@@ -366,11 +626,9 @@ bool WalkingIK::computeIK(const iDynTree::Transform& leftTransform, const iDynTr
         yInfo() << desiredRightTransform.toString();
     }
 
-    m_ik.updateTarget(m_rFootFrame, desiredRightTransform);
-
-    if(m_additionalFrame.size() != 0){
-        m_ik.updateRotationTarget(m_additionalFrame, leftTransform.getRotation().inverse() * m_inertial_R_world.inverse() * m_additionalRotation, m_additionalRotationWeight);
-    }
+    iDynTree::Rotation desiredAdditionalRotation = iDynTree::Rotation::Identity();
+    if(m_additionalFrame.size() != 0)
+        desiredAdditionalRotation = leftTransform.getRotation().inverse() * m_inertial_R_world.inverse() * m_additionalRotation;
 
     desiredCoMPosition = leftTransform.inverse() * comPosition;
     if (m_verbose) {
@@ -380,12 +638,42 @@ bool WalkingIK::computeIK(const iDynTree::Transform& leftTransform, const iDynTr
         yInfo() << desiredCoMPosition.toString();
     }
 
+    if(m_useLevenbergMarquardt)
+    {
+        if(!solveLevenbergMarquardt(desiredRightTransform, desiredCoMPosition, desiredAdditionalRotation))
+        {
+            yError() << "WalkingIK: Failed in finding a solution.";
+            return false;
+        }
+
+        if (m_verbose)
+            yInfo() << "Levenberg-Marquardt iterations: " << m_numberOfLMIterations;
+
+        if(m_useDiagnostics)
+            evaluateDiagnostics(desiredRightTransform, desiredCoMPosition);
+
+        result = m_qResult;
+        m_guess = m_qResult;
+
+        return true;
+    }
+
+    m_ik.updateTarget(m_rFootFrame, desiredRightTransform);
+
+    if(m_additionalFrame.size() != 0){
+        m_ik.updateRotationTarget(m_additionalFrame, desiredAdditionalRotation, m_additionalRotationWeight);
+    }
+
     m_ik.setCOMTarget(desiredCoMPosition, 100.0);
 
-    ok = m_ik.setCurrentRobotConfiguration(m_baseTransform,m_feedback);
-    if(!ok){
-        yError() << "WalkingIK: Error while setting the feedback.";
-        return false;
+    // the feedback and the regularization are passed to the problem only when they change
+    if(m_isFeedbackUpdated){
+        ok = m_ik.setCurrentRobotConfiguration(m_baseTransform,m_feedback);
+        if(!ok){
+            yError() << "WalkingIK: Error while setting the feedback.";
+            return false;
+        }
+        m_isFeedbackUpdated = false;
     }
 
     ok = m_ik.setReducedInitialCondition(&m_baseTransform, &m_guess);
@@ -394,10 +682,13 @@ bool WalkingIK::computeIK(const iDynTree::Transform& leftTransform, const iDynTr
         return false;
     }
 
-    ok = m_ik.setDesiredReducedJointConfiguration(m_jointRegularization, m_jointRegularizationWeight);
-    if(!ok){
-        yError() << "WalkingIK: Error while setting the desired joint configuration.";
-        return false;
+    if(m_isJointRegularizationUpdated){
+        ok = m_ik.setDesiredReducedJointConfiguration(m_jointRegularization, m_jointRegularizationWeight);
+        if(!ok){
+            yError() << "WalkingIK: Error while setting the desired joint configuration.";
+            return false;
+        }
+        m_isJointRegularizationUpdated = false;
     }
 
     ok = m_ik.solve();
@@ -409,15 +700,8 @@ bool WalkingIK::computeIK(const iDynTree::Transform& leftTransform, const iDynTr
 
     m_ik.getReducedSolution(baseTransform, m_qResult);
 
-    lchecker.setRobotState(m_baseTransform, m_qResult, dummyBaseVel, dummyVel,dummygrav);
-
-    iDynTree::Position comError = desiredCoMPosition - lchecker.getCenterOfMassPosition();
-    iDynTree::Position footError = desiredRightTransform.getPosition() - lchecker.getRelativeTransform(m_lFootFrame, m_rFootFrame).getPosition();
-
-    if (m_verbose) {
-        yInfo() << "CoM error position: "<< comError.toString();
-        yInfo() << "Foot position error: "<<footError.toString();
-    }
+    if(m_useDiagnostics)
+        evaluateDiagnostics(desiredRightTransform, desiredCoMPosition);
 
     result = m_qResult;
     m_guess = m_qResult;
@@ -425,6 +709,18 @@ bool WalkingIK::computeIK(const iDynTree::Transform& leftTransform, const iDynTr
     return true;
 }
 
+void WalkingIK::evaluateDiagnostics(const iDynTree::Transform& desiredRightTransform,
+                                    const iDynTree::Position& desiredCoMPosition)
+{
+    lchecker.setRobotState(m_baseTransform, m_qResult, dummyBaseVel, dummyVel,dummygrav);
+
+    iDynTree::Position comError = desiredCoMPosition - lchecker.getCenterOfMassPosition();
+    iDynTree::Position footError = desiredRightTransform.getPosition() - lchecker.getRelativeTransform(m_lFootFrame, m_rFootFrame).getPosition();
+
+    yInfo() << "CoM error position: "<< comError.toString();
+    yInfo() << "Foot position error: "<<footError.toString();
+}
+
 const std::string WalkingIK::getLeftFootFrame() const
 {
     return m_lFootFrame;
@@ -467,6 +763,7 @@ bool WalkingIK::setDesiredJointsWeight(double weight)
         return false;
     }
     m_jointRegularizationWeight = weight;
+    m_isJointRegularizationUpdated = true;
     return true;
 }
 
@@ -474,3 +771,11 @@ double WalkingIK::desiredJointWeight()
 {
     return m_jointRegularizationWeight;
 }
+
+int WalkingIK::getNumberOfIterations() const
+{
+    if(!m_useLevenbergMarquardt)
+        return 0;
+
+    return m_numberOfLMIterations;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file MultiStartInverseKinematics.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+// YARP
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Searchable.h>
+#include <yarp/os/Value.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+
+#include <WalkingControllers/WholeBodyControllers/MultiStartInverseKinematics.h>
+
+using namespace WalkingControllers;
+
+WalkingMultiStartIK::~WalkingMultiStartIK()
+{
+    close();
+}
+
+bool WalkingMultiStartIK::initialize(yarp::os::Searchable& ikOption, const iDynTree::Model& model,
+                                     const std::vector<std::string>& jointList)
+{
+    if(!m_instances.empty())
+    {
+        yError() << "[WalkingMultiStartIK::initialize] The solver is already initialized.";
+        return false;
+    }
+
+    int numberOfInstances = ikOption.check("multi_start_instances", yarp::os::Value(4)).asInt();
+    m_timeBudget = ikOption.check("multi_start_time_budget", yarp::os::Value(5.0)).asDouble();
+    m_perturbation = ikOption.check("multi_start_perturbation", yarp::os::Value(0.1)).asDouble();
+    int cacheSize = ikOption.check("multi_start_cache_size", yarp::os::Value(3)).asInt();
+    if(numberOfInstances <= 0 || cacheSize < 0 || m_timeBudget <= 0)
+    {
+        yError() << "[WalkingMultiStartIK::initialize] The number of instances and the time budget "
+                 << "have to be positive and the cache size cannot be negative.";
+        return false;
+    }
+    m_cacheSize = cacheSize;
+
+    // the IPOPT interface of mumps is not thread safe while the HSL solvers are
+    const std::vector<std::string> threadSafeSolvers{"ma27", "ma57", "ma77", "ma86", "ma97"};
+    std::string solverName = ikOption.check("solver_name", yarp::os::Value("mumps")).asString();
+    if(!ikOption.check("use_levenberg_marquardt", yarp::os::Value(false)).asBool()
+       && std::find(threadSafeSolvers.begin(), threadSafeSolvers.end(), solverName) == threadSafeSolvers.end())
+    {
+        yError() << "[WalkingMultiStartIK::initialize] The IK instances run concurrently and the"
+                 << solverName << "linear solver is not thread safe. Please use a HSL solver (e.g. ma27) "
+                 << "or the Levenberg-Marquardt solver.";
+        return false;
+    }
+
+    // the instances are never moved once the threads are started
+    m_instances = std::vector<Instance>(numberOfInstances);
+    for(auto& instance : m_instances)
+    {
+        instance.solver = std::make_unique<WalkingIK>();
+        if(!instance.solver->initialize(ikOption, model, jointList))
+        {
+            yError() << "[WalkingMultiStartIK::initialize] Unable to initialize an IK instance.";
+            m_instances.clear();
+            return false;
+        }
+    }
+
+    m_feedback.resize(model.getNrOfDOFs());
+    m_feedback.zero();
+    m_inertial_R_world = iDynTree::Rotation::Identity();
+    m_previousSolutions.clear();
+    m_randomGenerator.seed(0);
+
+    m_isClosing = false;
+    for(auto& instance : m_instances)
+        instance.worker = std::thread(&WalkingMultiStartIK::run, this, std::ref(instance));
+
+    return true;
+}
+
+bool WalkingMultiStartIK::setFullModelFeedBack(const iDynTree::VectorDynSize& feedback)
+{
+    if(m_instances.empty() || feedback.size() != m_feedback.size())
+    {
+        yError() << "[WalkingMultiStartIK::setFullModelFeedBack] The solver is not initialized or "
+                 << "the size of the feedback is wrong.";
+        return false;
+    }
+
+    m_feedback = feedback;
+    return true;
+}
+
+bool WalkingMultiStartIK::updateIntertiaToWorldFrameRotation(const iDynTree::Rotation& inertial_R_worldFrame)
+{
+    if(!usingAdditionalRotationTarget())
+    {
+        yError() << "[WalkingMultiStartIK::updateIntertiaToWorldFrameRotation] Cannot update the inertia "
+                 << "to world frame rotation if no additional frame is provided.";
+        return false;
+    }
+
+    m_inertial_R_world = inertial_R_worldFrame;
+    return true;
+}
+
+bool WalkingMultiStartIK::usingAdditionalRotationTarget()
+{
+    if(m_instances.empty())
+        return false;
+
+    return m_instances.front().solver->usingAdditionalRotationTarget();
+}
+
+void WalkingMultiStartIK::run(Instance& instance)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        m_startCondition.wait(lock, [&]{return m_isClosing
+                    || instance.requestedGeneration != instance.solvedGeneration;});
+        if(m_isClosing)
+            return;
+
+        // the data of the instance are not modified by computeIK() while it is busy
+        instance.isBusy = true;
+        std::size_t generation = instance.requestedGeneration;
+        lock.unlock();
+
+        bool ok = instance.solver->setFullModelFeedBack(instance.feedback);
+        if(ok && instance.solver->usingAdditionalRotationTarget())
+            ok = instance.solver->updateIntertiaToWorldFrameRotation(instance.inertial_R_world);
+        ok = ok && instance.solver->setInitialGuess(instance.guess);
+        ok = ok && instance.solver->computeIK(instance.leftTransform, instance.rightTransform,
+                                              instance.comPosition, instance.solution);
+
+        lock.lock();
+        instance.isBusy = false;
+        instance.isSolved = ok;
+        instance.solvedGeneration = generation;
+        m_doneCondition.notify_all();
+    }
+}
+
+bool WalkingMultiStartIK::computeIK(const iDynTree::Transform& leftTransform,
+                                    const iDynTree::Transform& rightTransform,
+                                    const iDynTree::Position& comPosition,
+                                    iDynTree::VectorDynSize& result)
+{
+    if(m_instances.empty())
+    {
+        yError() << "[WalkingMultiStartIK::computeIK] The solver is not initialized.";
+        return false;
+    }
+
+    const iDynTree::VectorDynSize& desiredJointConfiguration
+        = m_instances.front().solver->desiredJointConfiguration();
+
+    // initial guesses: current posture, desired joint configuration, previous solutions and
+    // random perturbations of the desired joint configuration
+    std::vector<iDynTree::VectorDynSize> guesses;
+    guesses.push_back(m_feedback);
+    guesses.push_back(desiredJointConfiguration);
+    for(const auto& solution : m_previousSolutions)
+        guesses.push_back(solution);
+
+    std::uniform_real_distribution<double> distribution(-m_perturbation, m_perturbation);
+    while(guesses.size() < m_instances.size())
+    {
+        iDynTree::VectorDynSize guess = desiredJointConfiguration;
+        for(unsigned int i = 0; i < guess.size(); i++)
+            guess(i) += distribution(m_randomGenerator);
+        guesses.push_back(guess);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // the instances still busy with a previous problem are not used
+    m_generation++;
+    std::size_t guessIndex = 0;
+    std::size_t numberOfRequests = 0;
+    for(auto& instance : m_instances)
+    {
+        if(instance.isBusy || instance.requestedGeneration != instance.solvedGeneration)
+            continue;
+
+        instance.guess = guesses[guessIndex++];
+        instance.feedback = m_feedback;
+        instance.leftTransform = leftTransform;
+        instance.rightTransform = rightTransform;
+        instance.comPosition = comPosition;
+        instance.inertial_R_world = m_inertial_R_world;
+        instance.requestedGeneration = m_generation;
+        numberOfRequests++;
+    }
+
+    if(numberOfRequests == 0)
+    {
+        yError() << "[WalkingMultiStartIK::computeIK] All the IK instances are still busy.";
+        return false;
+    }
+
+    m_startCondition.notify_all();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(m_timeBudget);
+    m_doneCondition.wait_until(lock, deadline, [&]{
+            for(const auto& instance : m_instances)
+                if(instance.requestedGeneration == m_generation && instance.solvedGeneration != m_generation)
+                    return false;
+            return true;});
+
+    // the feasible solution closest to the desired joint configuration is chosen
+    const Instance* bestInstance = nullptr;
+    double bestCost = std::numeric_limits<double>::infinity();
+    std::size_t numberOfSolutions = 0;
+    for(const auto& instance : m_instances)
+    {
+        if(instance.solvedGeneration != m_generation || !instance.isSolved)
+            continue;
+
+        numberOfSolutions++;
+        double cost = (iDynTree::toEigen(instance.solution)
+                       - iDynTree::toEigen(desiredJointConfiguration)).squaredNorm();
+        if(cost < bestCost)
+        {
+            bestCost = cost;
+            bestInstance = &instance;
+        }
+    }
+
+    if(bestInstance == nullptr)
+    {
+        yError() << "[WalkingMultiStartIK::computeIK] No IK instance found a solution within "
+                 << m_timeBudget << " seconds.";
+        return false;
+    }
+
+    yInfo() << "[WalkingMultiStartIK::computeIK]" << numberOfSolutions << "of" << numberOfRequests
+            << "IK instances found a solution.";
+
+    result = bestInstance->solution;
+
+    if(m_cacheSize > 0)
+    {
+        m_previousSolutions.push_front(result);
+        if(m_previousSolutions.size() > m_cacheSize)
+            m_previousSolutions.pop_back();
+    }
+
+    return true;
+}
+
+void WalkingMultiStartIK::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isClosing = true;
+    }
+    m_startCondition.notify_all();
+
+    for(auto& instance : m_instances)
+        if(instance.worker.joinable())
+            instance.worker.join();
+
+    m_instances.clear();
+}
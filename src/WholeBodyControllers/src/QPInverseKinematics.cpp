@@ -13,6 +13,7 @@
 
 // std
 #include <cmath>
+#include <limits>
 
 // YARP
 #include <yarp/os/LogStream.h>
@@ -63,6 +64,11 @@ bool WalkingQPIK::initialize(const yarp::os::Searchable &config,
     else
         m_retargetingType = RetargetingType::none;
 
+    // only the kinematic quantities used by the active tasks have to be evaluated
+    m_kinematicRequirements.handsJacobians = m_retargetingType == RetargetingType::handRetargeting;
+    m_kinematicRequirements.handsTransforms = m_retargetingType == RetargetingType::handRetargeting;
+    m_kinematicRequirements.retargetingJoints = m_retargetingType == RetargetingType::jointRetargeting;
+
     m_useJointsLimitsConstraint = config.check("use_joint_limits_constraint", yarp::os::Value(false)).asBool();
 
     // TODO in the future the number of constraints should be added inside
@@ -72,6 +78,9 @@ bool WalkingQPIK::initialize(const yarp::os::Searchable &config,
     // 6 (position + attitude) degree of freedom related to the base.
     m_numberOfVariables = m_actuatedDOFs + 6;
 
+    // the kernels specialized for the number of variables are used if available
+    bool useFixedSizeAssembler = config.check("use_fixed_size_assembler", yarp::os::Value(true)).asBool();
+    m_assembler = createQPIKAssembler(m_numberOfVariables, useFixedSizeAssembler);
 
     // the number of constraints is equal to the number of joints plus
     // 12 (position + attitude) of the left and right feet
@@ -179,6 +188,9 @@ bool WalkingQPIK::initializeMatrices(const yarp::os::Searchable& config)
         return false;
     }
 
+    m_constantHessianDiagonal.resize(m_numberOfVariables);
+    m_constantHessianDiagonal.zero();
+
      // if the joint retargeting is enabled the weights of the cost function are time-variant.
     if (m_retargetingType != RetargetingType::jointRetargeting)
     {
@@ -200,6 +212,9 @@ bool WalkingQPIK::initializeMatrices(const yarp::os::Searchable& config)
         // jointRegularizationGains are constant. For this reason we can compute their product
         m_jointRegularizationGainsTimeWeights.resize(m_actuatedDOFs);
         iDynTree::toEigen(m_jointRegularizationGainsTimeWeights) = iDynTree::toEigen(m_jointRegularizationWeights).cwiseProduct(iDynTree::toEigen(m_jointRegularizationGains));
+
+        // the block of the hessian related to the joint regularization is constant as well
+        iDynTree::toEigen(m_constantHessianDiagonal).tail(m_actuatedDOFs) = iDynTree::toEigen(m_jointRegularizationWeights);
     }
 
     if(!YarpUtilities::getNumberFromSearchable(config, "k_posFoot", m_kPosFoot))
@@ -385,17 +400,24 @@ bool WalkingQPIK::initializeJointRetargeting(const yarp::os::Searchable& config)
     return true;
 }
 
-bool WalkingQPIK::setRobotState(WalkingFK& kinDynWrapper)
+const QPIKKinematicRequirements& WalkingQPIK::getKinematicRequirements() const
 {
+    return m_kinematicRequirements;
+}
 
-    m_leftHandToWorldTransform = kinDynWrapper.getLeftHandToWorldTransform();
-    m_rightHandToWorldTransform = kinDynWrapper.getRightHandToWorldTransform();
+bool WalkingQPIK::setRobotState(WalkingFK& kinDynWrapper, const KinematicsState& state)
+{
+    if(m_kinematicRequirements.handsTransforms)
+    {
+        m_leftHandToWorldTransform = kinDynWrapper.getLeftHandToWorldTransform(state);
+        m_rightHandToWorldTransform = kinDynWrapper.getRightHandToWorldTransform(state);
+    }
 
-    m_jointPosition = kinDynWrapper.getJointPos();
-    m_leftFootToWorldTransform = kinDynWrapper.getLeftFootToWorldTransform();
-    m_rightFootToWorldTransform = kinDynWrapper.getRightFootToWorldTransform();
-    m_neckOrientation = kinDynWrapper.getNeckOrientation();
-    m_comPosition = kinDynWrapper.getCoMPosition();
+    m_jointPosition = kinDynWrapper.getJointPos(state);
+    m_leftFootToWorldTransform = kinDynWrapper.getLeftFootToWorldTransform(state);
+    m_rightFootToWorldTransform = kinDynWrapper.getRightFootToWorldTransform(state);
+    m_neckOrientation = kinDynWrapper.getNeckOrientation(state);
+    m_comPosition = kinDynWrapper.getCoMPosition(state);
 
     return true;
 }
@@ -620,57 +642,53 @@ void WalkingQPIK::setDesiredCoMPosition(const iDynTree::Position& desiredComPosi
     m_desiredComPosition = desiredComPosition;
 }
 
-void WalkingQPIK::evaluateHessianMatrix()
+void WalkingQPIK::evaluateHessianMatrix(const bool& upperTriangularOnly)
 {
     // in that case the hessian matrix is related only to neck orientation and to
-    // the joint angle
-    auto hessianDense(iDynTree::toEigen(m_hessianDense));
+    // the joint angle. Only the upper triangular part is assembled. The constant diagonal
+    // related to the joint regularization is precomputed
+    m_assembler->setHessianDiagonal(m_hessianDense, iDynTree::toEigen(m_constantHessianDiagonal));
 
     // if the joint retargeting is enable the weights of the cost function are time variant
     if (m_retargetingType != RetargetingType::jointRetargeting)
     {
-        hessianDense = iDynTree::toEigen(m_neckJacobian).transpose() * m_neckWeight * iDynTree::toEigen(m_neckJacobian);
-        hessianDense.bottomRightCorner(m_actuatedDOFs, m_actuatedDOFs) += iDynTree::toEigen(m_jointRegularizationWeights).asDiagonal();
+        const Eigen::Vector3d neckWeight = Eigen::Vector3d::Constant(m_neckWeight);
+        m_assembler->addTaskHessian(m_hessianDense, m_neckJacobian, neckWeight);
     }
     else
     {
-        hessianDense = iDynTree::toEigen(m_neckJacobian).transpose() *
-            m_torsoWeightSmoother->getPos()(0) *
-            iDynTree::toEigen(m_neckJacobian);
-        hessianDense.bottomRightCorner(m_actuatedDOFs, m_actuatedDOFs) +=
-            (iDynTree::toEigen(m_jointRegularizationWeightSmoother->getPos()) +
-             iDynTree::toEigen(m_jointRetargetingWeightSmoother->getPos())).asDiagonal();
+        const Eigen::Vector3d neckWeight = Eigen::Vector3d::Constant(m_torsoWeightSmoother->getPos()(0));
+        m_assembler->addTaskHessian(m_hessianDense, m_neckJacobian, neckWeight);
+
+        const auto& jointRegularizationWeight = m_jointRegularizationWeightSmoother->getPos();
+        const auto& jointRetargetingWeight = m_jointRetargetingWeightSmoother->getPos();
+        m_assembler->addJointsHessian(m_hessianDense, iDynTree::toEigen(jointRegularizationWeight));
+        m_assembler->addJointsHessian(m_hessianDense, iDynTree::toEigen(jointRetargetingWeight));
     }
 
     if(m_retargetingType == RetargetingType::handRetargeting)
     {
         // think about the possibility to project in the null space the joint regularization
-        hessianDense +=  iDynTree::toEigen(m_leftHandJacobian).transpose()
-            * iDynTree::toEigen(m_handWeightSmoother->getPos()).asDiagonal()
-            * iDynTree::toEigen(m_leftHandJacobian)
-            + iDynTree::toEigen(m_rightHandJacobian).transpose()
-            * iDynTree::toEigen(m_handWeightSmoother->getPos()).asDiagonal()
-            * iDynTree::toEigen(m_rightHandJacobian);
+        const auto& handWeight = m_handWeightSmoother->getPos();
+        m_assembler->addTaskHessian(m_hessianDense, m_leftHandJacobian, iDynTree::toEigen(handWeight));
+        m_assembler->addTaskHessian(m_hessianDense, m_rightHandJacobian, iDynTree::toEigen(handWeight));
     }
 
     if(!m_useCoMAsConstraint)
-    {
-        hessianDense += iDynTree::toEigen(m_comJacobian).transpose() *
-            iDynTree::toEigen(m_comWeight).asDiagonal() * iDynTree::toEigen(m_comJacobian);
-    }
+        m_assembler->addTaskHessian(m_hessianDense, m_comJacobian, iDynTree::toEigen(m_comWeight));
+
+    if(!upperTriangularOnly)
+        m_assembler->completeHessian(m_hessianDense);
 }
 
 void WalkingQPIK::evaluateGradientVector()
 {
     auto gradient(iDynTree::toEigen(m_gradient));
 
-    auto neckJacobian(iDynTree::toEigen(m_neckJacobian));
-
     auto jointRegularizationGains(iDynTree::toEigen(m_jointRegularizationGains));
     auto jointPosition(iDynTree::toEigen(m_jointPosition));
     auto regularizationTerm(iDynTree::toEigen(m_regularizationTerm));
 
-    auto comJacobian(iDynTree::toEigen(m_comJacobian));
     auto comWeight(iDynTree::toEigen(m_comWeight));
     auto comPosition(iDynTree::toEigen(m_comPosition));
     auto desiredComPosition(iDynTree::toEigen(m_desiredComPosition));
@@ -678,11 +696,13 @@ void WalkingQPIK::evaluateGradientVector()
 
     // Neck orientation
     iDynTree::Matrix3x3 errorNeckAttitude = iDynTreeUtilities::Rotation::skewSymmetric(m_neckOrientation * m_desiredNeckOrientation.inverse());
+    const Eigen::Vector3d neckVelocity = -m_kNeck * iDynTree::unskew(iDynTree::toEigen(errorNeckAttitude));
     if(m_retargetingType != RetargetingType::jointRetargeting)
     {
         auto jointRegularizationGainsTimeWeights(iDynTree::toEigen(m_jointRegularizationGainsTimeWeights));
 
-        gradient = -neckJacobian.transpose() * m_neckWeight * (-m_kNeck * iDynTree::unskew(iDynTree::toEigen(errorNeckAttitude)));
+        const Eigen::Vector3d neckWeight = Eigen::Vector3d::Constant(m_neckWeight);
+        m_assembler->setTaskGradient(m_gradient, m_neckJacobian, neckWeight, neckVelocity);
 
         // g = Weight * K_p * (regularizationTerm - jointPosition)
         // Weight  and K_p are two diagonal matrices so their product can be also evaluated multiplying component-wise
@@ -694,8 +714,8 @@ void WalkingQPIK::evaluateGradientVector()
         auto jointRetargetingGains(iDynTree::toEigen(m_jointRetargetingGains));
         auto jointRetargetingValues(iDynTree::toEigen(m_retargetingJointValue));
 
-        gradient = -neckJacobian.transpose() * m_torsoWeightSmoother->getPos()(0)
-            * (-m_kNeck * iDynTree::unskew(iDynTree::toEigen(errorNeckAttitude)));
+        const Eigen::Vector3d neckWeight = Eigen::Vector3d::Constant(m_torsoWeightSmoother->getPos()(0));
+        m_assembler->setTaskGradient(m_gradient, m_neckJacobian, neckWeight, neckVelocity);
 
         // g = Weight * K_p * (regularizationTerm - jointPosition)
         // Weight  and K_p are two diagonal matrices so their product can be also evaluated multiplying component-wise
@@ -762,16 +782,17 @@ void WalkingQPIK::evaluateGradientVector()
         rightHandCorrectionAngularVel = saturationLambda(rightHandCorrectionAngularVel, m_maxHandAngularVelocity);
 
 
-        gradient += - iDynTree::toEigen(m_leftHandJacobian).transpose()
-            * iDynTree::toEigen(m_handWeightSmoother->getPos()).asDiagonal() * (-iDynTree::toEigen(m_leftHandCorrection))
-            - iDynTree::toEigen(m_rightHandJacobian).transpose()
-            * iDynTree::toEigen(m_handWeightSmoother->getPos()).asDiagonal() * (-iDynTree::toEigen(m_rightHandCorrection));
+        const auto& handWeight = m_handWeightSmoother->getPos();
+        const Eigen::Matrix<double, 6, 1> leftHandVelocity = -iDynTree::toEigen(m_leftHandCorrection);
+        const Eigen::Matrix<double, 6, 1> rightHandVelocity = -iDynTree::toEigen(m_rightHandCorrection);
+        m_assembler->addTaskGradient(m_gradient, m_leftHandJacobian, iDynTree::toEigen(handWeight), leftHandVelocity);
+        m_assembler->addTaskGradient(m_gradient, m_rightHandJacobian, iDynTree::toEigen(handWeight), rightHandVelocity);
     }
 
     if(!m_useCoMAsConstraint)
     {
-        gradient += -comJacobian.transpose() * comWeight.asDiagonal() *
-            (desiredComVelocity - m_kCom * (comPosition - desiredComPosition));
+        const Eigen::Vector3d comVelocity = desiredComVelocity - m_kCom * (comPosition - desiredComPosition);
+        m_assembler->addTaskGradient(m_gradient, m_comJacobian, comWeight, comVelocity);
     }
 }
 
@@ -842,6 +863,61 @@ void WalkingQPIK::evaluateBounds()
     setJointVelocitiesBounds();
 }
 
+void QPIKProblem::resize(const int& numberOfVariables, const int& numberOfTasksConstraints)
+{
+    hessian.resize(numberOfVariables, numberOfVariables);
+    gradient.resize(numberOfVariables);
+    constraintsMatrix.resize(numberOfTasksConstraints, numberOfVariables);
+    lowerBound.resize(numberOfTasksConstraints);
+    upperBound.resize(numberOfTasksConstraints);
+    jointVelocitiesLowerBound.resize(numberOfVariables - 6);
+    jointVelocitiesUpperBound.resize(numberOfVariables - 6);
+    solution.resize(numberOfVariables);
+    solverTime = 0;
+}
+
+int WalkingQPIK::getNumberOfVariables() const
+{
+    return m_numberOfVariables;
+}
+
+int WalkingQPIK::getNumberOfTasksConstraints() const
+{
+    if(m_useCoMAsConstraint)
+        return 6 + 6 + 3;
+
+    return 6 + 6;
+}
+
+void WalkingQPIK::getProblem(QPIKProblem& problem) const
+{
+    // the osqp backend evaluates only the upper triangular part of the hessian matrix
+    auto hessian(iDynTree::toEigen(m_hessianDense));
+    problem.hessian.triangularView<Eigen::Upper>() = hessian;
+    problem.hessian.triangularView<Eigen::StrictlyLower>() = hessian.transpose();
+
+    problem.gradient = iDynTree::toEigen(m_gradient);
+
+    problem.constraintsMatrix.middleRows<6>(0) = iDynTree::toEigen(m_leftFootJacobian);
+    problem.constraintsMatrix.middleRows<6>(6) = iDynTree::toEigen(m_rightFootJacobian);
+    if(m_useCoMAsConstraint)
+        problem.constraintsMatrix.middleRows<3>(12) = iDynTree::toEigen(m_comJacobian);
+
+    int numberOfTasksConstraints = getNumberOfTasksConstraints();
+    problem.lowerBound = iDynTree::toEigen(m_lowerBound).head(numberOfTasksConstraints);
+    problem.upperBound = iDynTree::toEigen(m_upperBound).head(numberOfTasksConstraints);
+
+    if(m_useJointsLimitsConstraint)
+        getJointVelocitiesBounds(problem.jointVelocitiesLowerBound, problem.jointVelocitiesUpperBound);
+    else
+    {
+        problem.jointVelocitiesLowerBound.setConstant(-std::numeric_limits<double>::infinity());
+        problem.jointVelocitiesUpperBound.setConstant(std::numeric_limits<double>::infinity());
+    }
+
+    problem.solution = iDynTree::toEigen(m_solution);
+}
+
 const iDynTree::VectorDynSize& WalkingQPIK::getSolution() const
 {
     return m_solution;
@@ -0,0 +1,40 @@
+/**
+ * @file QPInverseKinematicsAssembler.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematicsAssembler.h>
+
+using namespace WalkingControllers;
+
+template class WalkingControllers::FixedSizeQPIKAssembler<29>;
+template class WalkingControllers::FixedSizeQPIKAssembler<31>;
+template class WalkingControllers::FixedSizeQPIKAssembler<35>;
+template class WalkingControllers::FixedSizeQPIKAssembler<38>;
+template class WalkingControllers::FixedSizeQPIKAssembler<Eigen::Dynamic>;
+
+std::unique_ptr<QPIKAssembler> WalkingControllers::createQPIKAssembler(const int& numberOfVariables,
+                                                                       const bool& useFixedSize)
+{
+    if(useFixedSize)
+    {
+        switch(numberOfVariables)
+        {
+        case 29:
+            return std::make_unique<FixedSizeQPIKAssembler<29>>(numberOfVariables);
+        case 31:
+            return std::make_unique<FixedSizeQPIKAssembler<31>>(numberOfVariables);
+        case 35:
+            return std::make_unique<FixedSizeQPIKAssembler<35>>(numberOfVariables);
+        case 38:
+            return std::make_unique<FixedSizeQPIKAssembler<38>>(numberOfVariables);
+        default:
+            break;
+        }
+    }
+
+    return std::make_unique<FixedSizeQPIKAssembler<Eigen::Dynamic>>(numberOfVariables);
+}
@@ -0,0 +1,399 @@
+/**
+ * @file QPInverseKinematicsShadow.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// YARP
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Value.h>
+
+// eigen
+#include <Eigen/Sparse>
+
+// solvers
+#include <OsqpEigen/OsqpEigen.h>
+#include <qpOASES.hpp>
+
+#include <WalkingControllers/YarpUtilities/Helper.h>
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematicsShadow.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    /**
+     * Shadow solver based on osqp. The joint velocity bounds are added as constraints.
+     */
+    class QPIKShadowSolver_osqp : public QPIKShadowSolver
+    {
+        OsqpEigen::Solver m_solver; /**< Optimization solver. */
+        Eigen::SparseMatrix<double> m_hessian; /**< Upper triangular part of the hessian matrix. */
+        Eigen::SparseMatrix<double> m_constraintsMatrix; /**< Constraints matrix (tasks and joints). */
+        Eigen::VectorXd m_gradient; /**< Gradient vector. */
+        Eigen::VectorXd m_lowerBound; /**< Lower bound of the constraints. */
+        Eigen::VectorXd m_upperBound; /**< Upper bound of the constraints. */
+        int m_numberOfTasksConstraints; /**< Number of constraints related to the tasks. */
+
+    public:
+
+        void initialize(const int& numberOfVariables, const int& numberOfTasksConstraints) final
+        {
+            m_numberOfTasksConstraints = numberOfTasksConstraints;
+            int actuatedDOFs = numberOfVariables - 6;
+
+            // the sparsity patterns are dense, the values are set by solve()
+            std::vector<Eigen::Triplet<double>> triplets;
+            for(int i = 0; i < numberOfVariables; i++)
+                for(int j = i; j < numberOfVariables; j++)
+                    triplets.emplace_back(i, j, 1.0);
+            m_hessian.resize(numberOfVariables, numberOfVariables);
+            m_hessian.setFromTriplets(triplets.begin(), triplets.end());
+
+            triplets.clear();
+            for(int i = 0; i < numberOfTasksConstraints; i++)
+                for(int j = 0; j < numberOfVariables; j++)
+                    triplets.emplace_back(i, j, 1.0);
+            for(int i = 0; i < actuatedDOFs; i++)
+                triplets.emplace_back(numberOfTasksConstraints + i, i + 6, 1.0);
+            m_constraintsMatrix.resize(numberOfTasksConstraints + actuatedDOFs, numberOfVariables);
+            m_constraintsMatrix.setFromTriplets(triplets.begin(), triplets.end());
+
+            m_gradient.resize(numberOfVariables);
+            m_lowerBound.resize(numberOfTasksConstraints + actuatedDOFs);
+            m_upperBound.resize(numberOfTasksConstraints + actuatedDOFs);
+
+            m_solver.data()->setNumberOfVariables(numberOfVariables);
+            m_solver.data()->setNumberOfConstraints(numberOfTasksConstraints + actuatedDOFs);
+            m_solver.settings()->setVerbosity(false);
+            m_solver.settings()->setLinearSystemSolver(0);
+        }
+
+        bool solve(const QPIKProblem& problem, Eigen::VectorXd& solution) final
+        {
+            for(int k = 0; k < m_hessian.outerSize(); k++)
+                for(Eigen::SparseMatrix<double>::InnerIterator it(m_hessian, k); it; ++it)
+                    it.valueRef() = problem.hessian(it.row(), it.col());
+
+            for(int k = 0; k < m_constraintsMatrix.outerSize(); k++)
+                for(Eigen::SparseMatrix<double>::InnerIterator it(m_constraintsMatrix, k); it; ++it)
+                    if(it.row() < m_numberOfTasksConstraints)
+                        it.valueRef() = problem.constraintsMatrix(it.row(), it.col());
+
+            m_gradient = problem.gradient;
+            m_lowerBound.head(m_numberOfTasksConstraints) = problem.lowerBound;
+            m_upperBound.head(m_numberOfTasksConstraints) = problem.upperBound;
+            m_lowerBound.tail(problem.jointVelocitiesLowerBound.size())
+                = problem.jointVelocitiesLowerBound.cwiseMax(-OsqpEigen::INFTY);
+            m_upperBound.tail(problem.jointVelocitiesUpperBound.size())
+                = problem.jointVelocitiesUpperBound.cwiseMin(OsqpEigen::INFTY);
+
+            if(!m_solver.isInitialized())
+            {
+                if(!m_solver.data()->setHessianMatrix(m_hessian)
+                   || !m_solver.data()->setGradient(m_gradient)
+                   || !m_solver.data()->setLinearConstraintsMatrix(m_constraintsMatrix)
+                   || !m_solver.data()->setLowerBound(m_lowerBound)
+                   || !m_solver.data()->setUpperBound(m_upperBound)
+                   || !m_solver.initSolver())
+                {
+                    yError() << "[QPIKShadowSolver_osqp::solve] Unable to initialize the solver.";
+                    return false;
+                }
+            }
+            else
+            {
+                if(osqp_update_P_A(m_solver.workspace().get(),
+                                   m_hessian.valuePtr(), OSQP_NULL, m_hessian.nonZeros(),
+                                   m_constraintsMatrix.valuePtr(), OSQP_NULL,
+                                   m_constraintsMatrix.nonZeros()) != 0
+                   || !m_solver.updateGradient(m_gradient)
+                   || !m_solver.updateBounds(m_lowerBound, m_upperBound))
+                {
+                    yError() << "[QPIKShadowSolver_osqp::solve] Unable to update the solver.";
+                    return false;
+                }
+            }
+
+            if(!m_solver.solve())
+                return false;
+
+            solution = m_solver.getSolution();
+            return true;
+        }
+    };
+
+    /**
+     * Shadow solver based on qpOASES. The joint velocity bounds are bounds of the variables.
+     */
+    class QPIKShadowSolver_qpOASES : public QPIKShadowSolver
+    {
+        std::unique_ptr<qpOASES::SQProblem> m_solver; /**< Optimization solver. */
+        Eigen::VectorXd m_lowerBound; /**< Lower bound of the variables. */
+        Eigen::VectorXd m_upperBound; /**< Upper bound of the variables. */
+        bool m_isFirstTime; /**< True if the solver has to be initialized. */
+
+    public:
+
+        void initialize(const int& numberOfVariables, const int& numberOfTasksConstraints) final
+        {
+            m_solver = std::make_unique<qpOASES::SQProblem>(numberOfVariables, numberOfTasksConstraints);
+            m_solver->setPrintLevel(qpOASES::PL_NONE);
+
+            // the base is not bounded
+            m_lowerBound = Eigen::VectorXd::Constant(numberOfVariables, -qpOASES::INFTY);
+            m_upperBound = Eigen::VectorXd::Constant(numberOfVariables, qpOASES::INFTY);
+            m_isFirstTime = true;
+        }
+
+        bool solve(const QPIKProblem& problem, Eigen::VectorXd& solution) final
+        {
+            m_lowerBound.tail(problem.jointVelocitiesLowerBound.size())
+                = problem.jointVelocitiesLowerBound.cwiseMax(-qpOASES::INFTY);
+            m_upperBound.tail(problem.jointVelocitiesUpperBound.size())
+                = problem.jointVelocitiesUpperBound.cwiseMin(qpOASES::INFTY);
+
+            int nWSR = 100;
+            if(!m_isFirstTime
+               && m_solver->hotstart(problem.hessian.data(), problem.gradient.data(),
+                                     problem.constraintsMatrix.data(),
+                                     m_lowerBound.data(), m_upperBound.data(),
+                                     problem.lowerBound.data(), problem.upperBound.data(),
+                                     nWSR, 0) == qpOASES::SUCCESSFUL_RETURN)
+            {
+                m_solver->getPrimalSolution(solution.data());
+                return true;
+            }
+
+            // the solver is initialized from scratch the first time and when the hotstart fails
+            m_solver->reset();
+            nWSR = 100;
+            if(m_solver->init(problem.hessian.data(), problem.gradient.data(),
+                              problem.constraintsMatrix.data(),
+                              m_lowerBound.data(), m_upperBound.data(),
+                              problem.lowerBound.data(), problem.upperBound.data(),
+                              nWSR, 0) != qpOASES::SUCCESSFUL_RETURN)
+            {
+                m_isFirstTime = true;
+                return false;
+            }
+
+            m_isFirstTime = false;
+            m_solver->getPrimalSolution(solution.data());
+            return true;
+        }
+    };
+}
+
+std::unique_ptr<QPIKShadowSolver> WalkingControllers::createQPIKShadowSolver(const std::string& name)
+{
+    if(name == "osqp")
+        return std::make_unique<QPIKShadowSolver_osqp>();
+
+    if(name == "qpOASES")
+        return std::make_unique<QPIKShadowSolver_qpOASES>();
+
+    return nullptr;
+}
+
+WalkingQPIKShadow::~WalkingQPIKShadow()
+{
+    close();
+}
+
+bool WalkingQPIKShadow::initialize(const yarp::os::Searchable& config, const WalkingQPIK& primarySolver)
+{
+    if(m_isRunning)
+    {
+        yError() << "[WalkingQPIKShadow::initialize] The shadow solvers are already running.";
+        return false;
+    }
+
+    yarp::os::Value* solversNameYarp;
+    if(!config.check("shadow_solvers", solversNameYarp))
+    {
+        yError() << "[WalkingQPIKShadow::initialize] Unable to find shadow_solvers into config file.";
+        return false;
+    }
+    if(!YarpUtilities::yarpListToStringVector(solversNameYarp, m_solversName))
+    {
+        yError() << "[WalkingQPIKShadow::initialize] Unable to convert yarp list into a vector of strings.";
+        return false;
+    }
+
+    int queueSize = config.check("shadow_queue_size", yarp::os::Value(16)).asInt();
+    if(queueSize <= 0)
+    {
+        yError() << "[WalkingQPIKShadow::initialize] The size of the queue has to be positive.";
+        return false;
+    }
+
+    int numberOfVariables = primarySolver.getNumberOfVariables();
+    int numberOfTasksConstraints = primarySolver.getNumberOfTasksConstraints();
+
+    m_solvers.clear();
+    for(const auto& name : m_solversName)
+    {
+        std::unique_ptr<QPIKShadowSolver> solver = createQPIKShadowSolver(name);
+        if(solver == nullptr)
+        {
+            yError() << "[WalkingQPIKShadow::initialize] The shadow solver " << name
+                     << " is not available. The available solvers are osqp and qpOASES.";
+            return false;
+        }
+        solver->initialize(numberOfVariables, numberOfTasksConstraints);
+        m_solvers.push_back(std::move(solver));
+    }
+    m_shadowSolution.resize(numberOfVariables);
+
+    // the problems are allocated here, pushProblem() does not allocate memory
+    QPIKProblem problem;
+    problem.resize(numberOfVariables, numberOfTasksConstraints);
+    m_problems.resize(queueSize, problem);
+    m_numberOfDroppedProblems = 0;
+
+    // the latencies of the last 1000 problems are used to evaluate the percentiles
+    const std::size_t latencyWindow = 1000;
+    m_statistics.assign(m_solvers.size() + 1, SolverStatistics());
+    for(auto& statistics : m_statistics)
+        statistics.latencies.resize(latencyWindow);
+    m_sortedLatencies.reserve(latencyWindow);
+
+    m_statisticsVector.resize(1 + 7 * m_statistics.size());
+    m_statisticsVector.zero();
+
+    m_isRunning = true;
+    m_worker = std::thread(&WalkingQPIKShadow::run, this);
+
+    return true;
+}
+
+bool WalkingQPIKShadow::pushProblem(const WalkingQPIK& primarySolver, const double& solverTime)
+{
+    if(!m_isRunning)
+        return false;
+
+    QPIKProblem* problem = m_problems.back();
+    if(problem == nullptr)
+    {
+        m_numberOfDroppedProblems++;
+        return false;
+    }
+
+    primarySolver.getProblem(*problem);
+    problem->solverTime = solverTime;
+    m_problems.push();
+
+    return true;
+}
+
+void WalkingQPIKShadow::addLatency(SolverStatistics& statistics, const double& latency)
+{
+    statistics.latencies[statistics.numberOfSamples % statistics.latencies.size()] = latency;
+    statistics.numberOfSamples++;
+    statistics.meanLatency += (latency - statistics.meanLatency) / statistics.numberOfSamples;
+    statistics.maxLatency = std::max(statistics.maxLatency, latency);
+}
+
+void WalkingQPIKShadow::updateStatisticsVector()
+{
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+    m_statisticsVector(0) = m_numberOfDroppedProblems;
+    for(std::size_t i = 0; i < m_statistics.size(); i++)
+    {
+        const SolverStatistics& statistics = m_statistics[i];
+        std::size_t numberOfLatencies = std::min(statistics.numberOfSamples, statistics.latencies.size());
+
+        double percentile50 = 0;
+        double percentile99 = 0;
+        if(numberOfLatencies > 0)
+        {
+            m_sortedLatencies.assign(statistics.latencies.begin(),
+                                     statistics.latencies.begin() + numberOfLatencies);
+
+            auto percentile = [this, &numberOfLatencies](const double& p)
+            {
+                auto nth = m_sortedLatencies.begin() + static_cast<std::size_t>(p * (numberOfLatencies - 1));
+                std::nth_element(m_sortedLatencies.begin(), nth, m_sortedLatencies.end());
+                return *nth;
+            };
+            percentile50 = percentile(0.5);
+            percentile99 = percentile(0.99);
+        }
+
+        std::size_t index = 1 + 7 * i;
+        m_statisticsVector(index) = statistics.meanLatency;
+        m_statisticsVector(index + 1) = percentile50;
+        m_statisticsVector(index + 2) = percentile99;
+        m_statisticsVector(index + 3) = statistics.maxLatency;
+        m_statisticsVector(index + 4) = statistics.numberOfFailures;
+        m_statisticsVector(index + 5) = statistics.solutionError;
+        m_statisticsVector(index + 6) = statistics.maxSolutionError;
+    }
+}
+
+void WalkingQPIKShadow::run()
+{
+    while(m_isRunning)
+    {
+        QPIKProblem* problem = m_problems.front();
+        if(problem == nullptr)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // the primary solver is the first one
+        addLatency(m_statistics[0], problem->solverTime);
+
+        for(std::size_t i = 0; i < m_solvers.size(); i++)
+        {
+            SolverStatistics& statistics = m_statistics[i + 1];
+
+            auto start = std::chrono::steady_clock::now();
+            bool isSolved = m_solvers[i]->solve(*problem, m_shadowSolution);
+            std::chrono::duration<double> latency = std::chrono::steady_clock::now() - start;
+
+            addLatency(statistics, latency.count());
+
+            if(!isSolved)
+            {
+                statistics.numberOfFailures++;
+                continue;
+            }
+
+            statistics.solutionError = (m_shadowSolution - problem->solution).lpNorm<Eigen::Infinity>();
+            statistics.maxSolutionError = std::max(statistics.maxSolutionError, statistics.solutionError);
+        }
+
+        m_problems.pop();
+
+        updateStatisticsVector();
+    }
+}
+
+bool WalkingQPIKShadow::getStatistics(yarp::sig::Vector& statistics)
+{
+    // the control thread never waits for the worker thread
+    std::unique_lock<std::mutex> lock(m_statisticsMutex, std::try_to_lock);
+    if(!lock.owns_lock())
+        return false;
+
+    statistics = m_statisticsVector;
+    return true;
+}
+
+void WalkingQPIKShadow::close()
+{
+    m_isRunning = false;
+    if(m_worker.joinable())
+        m_worker.join();
+}
@@ -0,0 +1,339 @@
+/**
+ * @file QPInverseKinematics_KKT.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2018 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2018
+ */
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// YARP
+#include <yarp/os/LogStream.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_KKT.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    constexpr double activeSetTolerance = 1e-9; /**< Tolerance on the bounds and on the multipliers. */
+    constexpr double rankTolerance = 1e-10; /**< Tolerance used to detect dependent constraints. */
+}
+
+void WalkingQPIK_KKT::setNumberOfConstraints()
+{
+    // the joint velocity bounds are not considered here, they are added as equality
+    // constraints only when they are active
+    if(m_useCoMAsConstraint)
+        m_numberOfConstraints = 6 + 6 + 3;
+    else
+        m_numberOfConstraints = 6 + 6;
+}
+
+void WalkingQPIK_KKT::initializeSolverSpecificMatrices()
+{
+    // In the following we suppose that the constraints are saved in the following order
+    // (lf, rf com (if it is present)) and then the active joint velocity bounds
+    m_numberOfTasksConstraints = m_numberOfConstraints;
+
+    int maxNumberOfConstraints = m_numberOfTasksConstraints;
+    if(m_useJointsLimitsConstraint)
+        maxNumberOfConstraints += m_actuatedDOFs;
+
+    m_minJointLimit.resize(m_actuatedDOFs);
+    m_maxJointLimit.resize(m_actuatedDOFs);
+    for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+    {
+        m_minJointLimit(i) = -std::numeric_limits<double>::infinity();
+        m_maxJointLimit(i) = std::numeric_limits<double>::infinity();
+    }
+
+    m_jointBoundsStatus.assign(m_actuatedDOFs, BoundStatus::inactive);
+
+    // every iteration adds or removes a single bound
+    m_maxActiveSetIterations = 2 * m_actuatedDOFs + 1;
+
+    m_constraintsMatrixDense = Eigen::MatrixXd::Zero(maxNumberOfConstraints, m_numberOfVariables);
+    m_constraintsVector = Eigen::VectorXd::Zero(maxNumberOfConstraints);
+
+    m_constraintsQR = Eigen::HouseholderQR<Eigen::MatrixXd>(m_numberOfVariables, maxNumberOfConstraints);
+    m_orthogonalMatrix.resize(m_numberOfVariables, m_numberOfVariables);
+    m_nullSpaceHessian.resize(m_numberOfVariables, m_numberOfVariables);
+    m_hessianTimesNullSpace.resize(m_numberOfVariables, m_numberOfVariables);
+    m_nullSpaceHessianLLT = Eigen::LLT<Eigen::MatrixXd>(m_numberOfVariables);
+
+    m_rangeSpaceSolution.resize(maxNumberOfConstraints);
+    m_nullSpaceSolution.resize(m_numberOfVariables);
+    m_costGradient.resize(m_numberOfVariables);
+    m_multipliers.resize(maxNumberOfConstraints);
+}
+
+void WalkingQPIK_KKT::setJointVelocitiesBounds()
+{
+    if(m_useJointsLimitsConstraint)
+        for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+        {
+            m_minJointLimit(i) = m_kJointLimitsLowerBound *
+                std::tanh(m_jointPosition(i) - m_jointPositionsLowerBounds(i))
+                * (-m_jointVelocitiesBounds(i));
+
+            m_maxJointLimit(i) = m_kJointLimitsUpperBound *
+                std::tanh(m_jointPositionsUpperBounds(i) - m_jointPosition(i))
+                * m_jointVelocitiesBounds(i);
+        }
+
+    return;
+}
+
+void WalkingQPIK_KKT::getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                               Eigen::Ref<Eigen::VectorXd> upperBound) const
+{
+    lowerBound = iDynTree::toEigen(m_minJointLimit);
+    upperBound = iDynTree::toEigen(m_maxJointLimit);
+}
+
+void WalkingQPIK_KKT::instantiateSolver()
+{
+    // the problem is solved in closed form. Only the active set has to be reset
+    m_jointBoundsStatus.assign(m_actuatedDOFs, BoundStatus::inactive);
+}
+
+bool WalkingQPIK_KKT::solveEqualityConstrainedProblem()
+{
+    // the rows related to the tasks are already set. Here the active bounds are added
+    int numberOfConstraints = m_numberOfTasksConstraints;
+    for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+    {
+        if(m_jointBoundsStatus[i] == BoundStatus::inactive)
+            continue;
+
+        m_constraintsMatrixDense.row(numberOfConstraints).setZero();
+        m_constraintsMatrixDense(numberOfConstraints, i + 6) = 1;
+        m_constraintsVector(numberOfConstraints) = m_jointBoundsStatus[i] == BoundStatus::lower ?
+            m_minJointLimit(i) : m_maxJointLimit(i);
+        numberOfConstraints++;
+    }
+
+    if(numberOfConstraints > m_numberOfVariables)
+    {
+        yError() << "[solveEqualityConstrainedProblem] The number of active constraints is greater "
+                 << "than the number of variables.";
+        return false;
+    }
+
+    // A^T = Q R. The first columns of Q are a basis of the range space of A^T while the
+    // remaining columns are a basis of the null space of A
+    m_constraintsQR.compute(m_constraintsMatrixDense.topRows(numberOfConstraints).transpose());
+    if(m_constraintsQR.matrixQR().diagonal().head(numberOfConstraints).cwiseAbs().minCoeff() < rankTolerance)
+    {
+        yError() << "[solveEqualityConstrainedProblem] The constraints are linearly dependent.";
+        return false;
+    }
+    m_orthogonalMatrix = m_constraintsQR.householderQ();
+    m_numberOfActiveConstraints = numberOfConstraints;
+
+    const auto R = m_constraintsQR.matrixQR().topLeftCorner(numberOfConstraints, numberOfConstraints)
+        .triangularView<Eigen::Upper>();
+    auto rangeSpaceBasis = m_orthogonalMatrix.leftCols(numberOfConstraints);
+
+    auto hessian(iDynTree::toEigen(m_hessianDense));
+    auto gradient(iDynTree::toEigen(m_gradient));
+    auto solution(iDynTree::toEigen(m_solution));
+
+    // particular solution of A x = b
+    m_rangeSpaceSolution.head(numberOfConstraints) = R.transpose().solve(m_constraintsVector.head(numberOfConstraints));
+    solution.noalias() = rangeSpaceBasis * m_rangeSpaceSolution.head(numberOfConstraints);
+
+    // minimize the cost in the null space of the constraints
+    int nullSpaceSize = m_numberOfVariables - numberOfConstraints;
+    if(nullSpaceSize > 0)
+    {
+        auto nullSpaceBasis = m_orthogonalMatrix.rightCols(nullSpaceSize);
+        auto hessianTimesNullSpace = m_hessianTimesNullSpace.leftCols(nullSpaceSize);
+        auto nullSpaceHessian = m_nullSpaceHessian.topLeftCorner(nullSpaceSize, nullSpaceSize);
+        auto nullSpaceSolution = m_nullSpaceSolution.head(nullSpaceSize);
+
+        hessianTimesNullSpace.noalias() = hessian * nullSpaceBasis;
+        nullSpaceHessian.noalias() = nullSpaceBasis.transpose() * hessianTimesNullSpace;
+
+        m_costGradient = gradient;
+        m_costGradient.noalias() += hessian * solution;
+        nullSpaceSolution.noalias() = -nullSpaceBasis.transpose() * m_costGradient;
+
+        m_nullSpaceHessianLLT.compute(nullSpaceHessian);
+        if(m_nullSpaceHessianLLT.info() != Eigen::Success)
+        {
+            yError() << "[solveEqualityConstrainedProblem] The hessian matrix is not positive definite "
+                     << "in the null space of the constraints.";
+            return false;
+        }
+        m_nullSpaceHessianLLT.solveInPlace(nullSpaceSolution);
+
+        solution.noalias() += nullSpaceBasis * nullSpaceSolution;
+    }
+
+    // Lagrange multipliers (H x + g + A^T lambda = 0)
+    auto multipliers = m_multipliers.head(numberOfConstraints);
+    m_costGradient = gradient;
+    m_costGradient.noalias() += hessian * solution;
+    multipliers.noalias() = -rangeSpaceBasis.transpose() * m_costGradient;
+    R.solveInPlace(multipliers);
+
+    return true;
+}
+
+void WalkingQPIK_KKT::updateActiveSet(bool& isOptimal)
+{
+    isOptimal = false;
+
+    // add the most violated bound. A bound that depends on the active constraints is not added
+    // (the equality constrained problem would be rank deficient), it is handled by the saturation
+    // in solve()
+    int nullSpaceSize = m_numberOfVariables - m_numberOfActiveConstraints;
+    int violatedJoint = -1;
+    double maxViolation = activeSetTolerance;
+    BoundStatus violatedBound = BoundStatus::inactive;
+    for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+    {
+        if(m_jointBoundsStatus[i] != BoundStatus::inactive)
+            continue;
+
+        if(m_orthogonalMatrix.row(i + 6).tail(nullSpaceSize).norm() < rankTolerance)
+            continue;
+
+        double lowerViolation = m_minJointLimit(i) - m_solution(i + 6);
+        double upperViolation = m_solution(i + 6) - m_maxJointLimit(i);
+        if(lowerViolation > maxViolation)
+        {
+            maxViolation = lowerViolation;
+            violatedJoint = i;
+            violatedBound = BoundStatus::lower;
+        }
+        if(upperViolation > maxViolation)
+        {
+            maxViolation = upperViolation;
+            violatedJoint = i;
+            violatedBound = BoundStatus::upper;
+        }
+    }
+
+    if(violatedJoint >= 0)
+    {
+        m_jointBoundsStatus[violatedJoint] = violatedBound;
+        return;
+    }
+
+    // remove the active bound that pulls the solution inside the feasible set. The multiplier
+    // of an active upper (lower) bound has to be positive (negative)
+    int releasedJoint = -1;
+    double minMultiplier = -activeSetTolerance;
+    int row = m_numberOfTasksConstraints;
+    for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+    {
+        if(m_jointBoundsStatus[i] == BoundStatus::inactive)
+            continue;
+
+        double multiplier = m_jointBoundsStatus[i] == BoundStatus::upper ?
+            m_multipliers(row) : -m_multipliers(row);
+        row++;
+
+        if(multiplier < minMultiplier)
+        {
+            minMultiplier = multiplier;
+            releasedJoint = i;
+        }
+    }
+
+    if(releasedJoint >= 0)
+    {
+        m_jointBoundsStatus[releasedJoint] = BoundStatus::inactive;
+        return;
+    }
+
+    isOptimal = true;
+}
+
+bool WalkingQPIK_KKT::solve()
+{
+    evaluateHessianMatrix();
+    evaluateGradientVector();
+    evaluateBounds();
+
+    // rows related to the tasks. The bounds of the tasks are equal
+    m_constraintsMatrixDense.middleRows<6>(0) = iDynTree::toEigen(m_leftFootJacobian);
+    m_constraintsMatrixDense.middleRows<6>(6) = iDynTree::toEigen(m_rightFootJacobian);
+    if(m_useCoMAsConstraint)
+        m_constraintsMatrixDense.middleRows<3>(12) = iDynTree::toEigen(m_comJacobian);
+
+    m_constraintsVector.head(m_numberOfTasksConstraints) = iDynTree::toEigen(m_lowerBound);
+
+    if(!m_useJointsLimitsConstraint)
+    {
+        if(!solveEqualityConstrainedProblem())
+        {
+            yError() << "[solve] Unable to solve the problem.";
+            return false;
+        }
+        m_numberOfActiveSetIterations = 1;
+    }
+    else
+    {
+        // the active set of the previous call is used as initial guess
+        bool isOptimal = false;
+        bool isSolved = true;
+        m_numberOfActiveSetIterations = 0;
+        while(m_numberOfActiveSetIterations < m_maxActiveSetIterations && !isOptimal && isSolved)
+        {
+            m_numberOfActiveSetIterations++;
+            isSolved = solveEqualityConstrainedProblem();
+            if(isSolved)
+                updateActiveSet(isOptimal);
+        }
+
+        if(!isOptimal)
+        {
+            // the working set is reset. If the last iterate is not available the problem is
+            // solved without the bounds, then the solution is saturated
+            m_jointBoundsStatus.assign(m_actuatedDOFs, BoundStatus::inactive);
+            if(!isSolved && !solveEqualityConstrainedProblem())
+            {
+                yError() << "[solve] Unable to solve the problem.";
+                return false;
+            }
+
+            yWarning() << "[solve] The active set did not converge in " << m_numberOfActiveSetIterations
+                       << " iterations. The last iterate is saturated to the joint velocity bounds.";
+        }
+
+        // the bounds that cannot be added to the working set are enforced here
+        bool isSaturated = false;
+        for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+        {
+            double jointVelocity = std::min(std::max(m_solution(i + 6), m_minJointLimit(i)), m_maxJointLimit(i));
+            if(std::abs(jointVelocity - m_solution(i + 6)) > activeSetTolerance)
+                isSaturated = true;
+            m_solution(i + 6) = jointVelocity;
+        }
+
+        if(isOptimal && isSaturated)
+            yWarning() << "[solve] The joint velocity bounds depend on the active constraints. "
+                       << "The solution is saturated to the bounds.";
+    }
+
+    for(unsigned int i = 0; i < m_actuatedDOFs; i++)
+        m_desiredJointVelocitiesOutput(i) = m_solution(i + 6);
+
+    return true;
+}
+
+int WalkingQPIK_KKT::getNumberOfIterations() const
+{
+    return m_numberOfActiveSetIterations;
+}
@@ -8,6 +8,7 @@
 
 // std
 #include <cmath>
+#include <vector>
 
 // YARP
 #include <yarp/os/LogStream.h>
@@ -37,16 +38,67 @@ void WalkingQPIK_osqp::setNumberOfConstraints()
 
 void WalkingQPIK_osqp::initializeSolverSpecificMatrices()
 {
-    // add constraint for the maximum velocity.
     // In the following we suppose that the constraints are saved in the following order
     // (lf, rf com (if it is present))
-    int startingRow = 6 + 6;
+    m_numberOfTasksConstraints = 6 + 6;
     if(m_useCoMAsConstraint)
-        startingRow += 3;
+        m_numberOfTasksConstraints += 3;
+
+    // the sparsity patterns are computed only once. Explicit zeros are stored in order to keep
+    // the patterns constant, so that only the values have to be passed to the solver
+    std::vector<Eigen::Triplet<double>> hessianTriplets;
+    for(int j = 0; j < m_numberOfVariables; j++)
+        for(int i = 0; i <= j; i++)
+            hessianTriplets.emplace_back(i, j, 0.0);
+
+    m_hessianUpperTriangular.resize(m_numberOfVariables, m_numberOfVariables);
+    m_hessianUpperTriangular.setFromTriplets(hessianTriplets.begin(), hessianTriplets.end());
+    m_hessianUpperTriangular.makeCompressed();
 
+    std::vector<Eigen::Triplet<double>> constraintsTriplets;
+    for(int j = 0; j < m_numberOfVariables; j++)
+        for(int i = 0; i < m_numberOfTasksConstraints; i++)
+            constraintsTriplets.emplace_back(i, j, 0.0);
+
+    // add constraint for the maximum velocity.
     if(m_useJointsLimitsConstraint)
         for(unsigned int i = 0; i < m_actuatedDOFs; i++)
-            m_constraintsMatrixSparse(startingRow + i, i + 6) = 1;
+            constraintsTriplets.emplace_back(m_numberOfTasksConstraints + i, i + 6, 1.0);
+
+    m_constraintsMatrix.resize(m_numberOfConstraints, m_numberOfVariables);
+    m_constraintsMatrix.setFromTriplets(constraintsTriplets.begin(), constraintsTriplets.end());
+    m_constraintsMatrix.makeCompressed();
+}
+
+void WalkingQPIK_osqp::updateHessianValues()
+{
+    // the matrix is stored column major. The j-th column contains the elements (0, j) ... (j, j)
+    double* values = m_hessianUpperTriangular.valuePtr();
+    for(int j = 0; j < m_numberOfVariables; j++)
+    {
+        int columnStart = m_hessianUpperTriangular.outerIndexPtr()[j];
+        for(int i = 0; i <= j; i++)
+            values[columnStart + i] = m_hessianDense(i, j);
+    }
+}
+
+void WalkingQPIK_osqp::updateConstraintsMatrixValues()
+{
+    // the rows related to the tasks are the first elements of each column
+    double* values = m_constraintsMatrix.valuePtr();
+    for(int j = 0; j < m_numberOfVariables; j++)
+    {
+        int columnStart = m_constraintsMatrix.outerIndexPtr()[j];
+        for(int i = 0; i < 6; i++)
+        {
+            values[columnStart + i] = m_leftFootJacobian(i, j);
+            values[columnStart + 6 + i] = m_rightFootJacobian(i, j);
+        }
+
+        if(m_useCoMAsConstraint)
+            for(int i = 0; i < 3; i++)
+                values[columnStart + 12 + i] = m_comJacobian(i, j);
+    }
 }
 
 void WalkingQPIK_osqp::setJointVelocitiesBounds()
@@ -73,6 +125,14 @@ void WalkingQPIK_osqp::setJointVelocitiesBounds()
     return;
 }
 
+void WalkingQPIK_osqp::getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                                Eigen::Ref<Eigen::VectorXd> upperBound) const
+{
+    int numberOfTaskConstraints = getNumberOfTasksConstraints();
+    lowerBound = iDynTree::toEigen(m_lowerBound).segment(numberOfTaskConstraints, m_actuatedDOFs);
+    upperBound = iDynTree::toEigen(m_upperBound).segment(numberOfTaskConstraints, m_actuatedDOFs);
+}
+
 void WalkingQPIK_osqp::instantiateSolver()
 {
     // instantiate the solver
@@ -88,9 +148,7 @@ void WalkingQPIK_osqp::instantiateSolver()
 bool WalkingQPIK_osqp::initializeSolver()
 {
     // Hessian matrix
-    auto hessianDense(iDynTree::toEigen(m_hessianDense));
-    Eigen::SparseMatrix<double> hessianSparse = hessianDense.sparseView();
-    if(!m_optimizerSolver->data()->setHessianMatrix(hessianSparse))
+    if(!m_optimizerSolver->data()->setHessianMatrix(m_hessianUpperTriangular))
     {
         yError() << "[initializeSolver] Unable to set the hessian matrix.";
         return false;
@@ -104,10 +162,7 @@ bool WalkingQPIK_osqp::initializeSolver()
         return false;
     }
 
-
-    Eigen::SparseMatrix<double> constraintsMatrixSparse = iDynTree::toEigen(m_constraintsMatrixSparse);
-    // auto constraintsMatrixSparse(iDynTree::toEigen(m_constraintsMatrixSparse));
-    if(!m_optimizerSolver->data()->setLinearConstraintsMatrix(constraintsMatrixSparse))
+    if(!m_optimizerSolver->data()->setLinearConstraintsMatrix(m_constraintsMatrix))
     {
         yError() << "[initializeSolver] Unable to set the constraints matrix.";
         return false;
@@ -133,17 +188,30 @@ bool WalkingQPIK_osqp::initializeSolver()
         return false;
     }
 
+    // the values are updated assuming that the solver stores the same sparsity patterns
+    const OSQPData* data = m_optimizerSolver->workspace()->data;
+    if(data->P->p[m_numberOfVariables] != m_hessianUpperTriangular.nonZeros()
+       || data->A->p[m_numberOfVariables] != m_constraintsMatrix.nonZeros())
+    {
+        yError() << "[initializeSolver] The sparsity pattern stored by the solver is different "
+                 << "from the expected one.";
+        return false;
+    }
+
     return true;
 }
 
 bool WalkingQPIK_osqp::updateSolver()
 {
-    // Hessian matrix
-    auto hessianDense(iDynTree::toEigen(m_hessianDense));
-    Eigen::SparseMatrix<double> hessianSparse = hessianDense.sparseView();
-    if(!m_optimizerSolver->updateHessianMatrix(hessianSparse))
+    // the sparsity patterns are constant so only the values are updated. The hessian and the
+    // constraints matrices are updated together in order to factorize the KKT matrix only once
+    if(osqp_update_P_A(m_optimizerSolver->workspace().get(),
+                       m_hessianUpperTriangular.valuePtr(), OSQP_NULL,
+                       m_hessianUpperTriangular.nonZeros(),
+                       m_constraintsMatrix.valuePtr(), OSQP_NULL,
+                       m_constraintsMatrix.nonZeros()) != 0)
     {
-        yError() << "[updateSolver] Unable to set the hessian matrix.";
+        yError() << "[updateSolver] Unable to update the hessian and the constraints matrices.";
         return false;
     }
 
@@ -155,13 +223,6 @@ bool WalkingQPIK_osqp::updateSolver()
         return false;
     }
 
-    auto constraintsMatrixSparse(iDynTree::toEigen(m_constraintsMatrixSparse));
-    if(!m_optimizerSolver->updateLinearConstraintsMatrix(constraintsMatrixSparse))
-    {
-        yError() << "[updateSolver] Unable to set the constraints matrix.";
-        return false;
-    }
-
     auto lowerBound(iDynTree::toEigen(m_lowerBound));
     auto upperBound(iDynTree::toEigen(m_upperBound));
     if(!m_optimizerSolver->updateBounds(lowerBound, upperBound))
@@ -175,11 +236,15 @@ bool WalkingQPIK_osqp::updateSolver()
 
 bool WalkingQPIK_osqp::solve()
 {
-    evaluateHessianMatrix();
+    // osqp requires only the upper triangular part of the hessian matrix
+    evaluateHessianMatrix(true);
     evaluateGradientVector();
-    evaluateLinearConstraintMatrix();
     evaluateBounds();
 
+    // the values are written directly in the sparse matrices passed to the solver
+    updateHessianValues();
+    updateConstraintsMatrixValues();
+
     if(!m_optimizerSolver->isInitialized())
     {
         if(!initializeSolver())
@@ -209,3 +274,11 @@ bool WalkingQPIK_osqp::solve()
 
     return true;
 }
+
+int WalkingQPIK_osqp::getNumberOfIterations() const
+{
+    if(!m_optimizerSolver->isInitialized())
+        return 0;
+
+    return m_optimizerSolver->workspace()->info->iter;
+}
@@ -32,6 +32,8 @@ void WalkingQPIK_qpOASES::setNumberOfConstraints()
 
 void WalkingQPIK_qpOASES::initializeSolverSpecificMatrices()
 {
+    m_constraintsMatrixDense = MatrixXd::Zero(m_numberOfConstraints, m_numberOfVariables);
+
     m_minJointLimit.resize(m_numberOfVariables);
     m_maxJointLimit.resize(m_numberOfVariables);
 
@@ -59,6 +61,13 @@ void WalkingQPIK_qpOASES::setJointVelocitiesBounds()
     return;
 }
 
+void WalkingQPIK_qpOASES::getJointVelocitiesBounds(Eigen::Ref<Eigen::VectorXd> lowerBound,
+                                                   Eigen::Ref<Eigen::VectorXd> upperBound) const
+{
+    lowerBound = iDynTree::toEigen(m_minJointLimit).tail(m_actuatedDOFs);
+    upperBound = iDynTree::toEigen(m_maxJointLimit).tail(m_actuatedDOFs);
+}
+
 void WalkingQPIK_qpOASES::instantiateSolver()
 {
     m_optimizer = std::make_unique<qpOASES::SQProblem>(m_numberOfVariables,
@@ -68,40 +77,73 @@ void WalkingQPIK_qpOASES::instantiateSolver()
     m_isFirstTime = true;
 }
 
+bool WalkingQPIK_qpOASES::initializeSolver(const bool& useGuessedWorkingSet)
+{
+    int nWSR = m_maxNumberOfWorkingSetRecalculations;
+    if(m_optimizer->init(m_hessianDense.data(), m_gradient.data(), m_constraintsMatrixDense.data(),
+                         m_minJointLimit.data(), m_maxJointLimit.data(),
+                         m_lowerBound.data(), m_upperBound.data(), nWSR, 0,
+                         nullptr, nullptr,
+                         useGuessedWorkingSet ? &m_guessedBounds : nullptr,
+                         useGuessedWorkingSet ? &m_guessedConstraints : nullptr)
+       != qpOASES::SUCCESSFUL_RETURN)
+    {
+        yError() << "[initializeSolver] Unable to solve the problem.";
+        return false;
+    }
+
+    m_numberOfWorkingSetRecalculations = nWSR;
+    return true;
+}
+
 bool WalkingQPIK_qpOASES::solve()
 {
     evaluateHessianMatrix();
     evaluateGradientVector();
-    evaluateLinearConstraintMatrix();
     evaluateBounds();
 
-    // convert sparse matrix into a dense matrix
-    MatrixXd constraintMatrix = MatrixXd(iDynTree::toEigen(m_constraintsMatrixSparse));
+    // the hessian matrix is already stored row major. The constraints are written in the
+    // row major buffer passed to qpOASES
+    m_constraintsMatrixDense.middleRows<6>(0) = iDynTree::toEigen(m_leftFootJacobian);
+    m_constraintsMatrixDense.middleRows<6>(6) = iDynTree::toEigen(m_rightFootJacobian);
+    if(m_useCoMAsConstraint)
+        m_constraintsMatrixDense.middleRows<3>(12) = iDynTree::toEigen(m_comJacobian);
 
-    int nWSR = 100;
-    if(!m_isFirstTime)
+    if(m_isFirstTime)
     {
-        if(m_optimizer->hotstart(m_hessianDense.data(), m_gradient.data(), constraintMatrix.data(),
-                                 m_minJointLimit.data(), m_maxJointLimit.data(),
-                                 m_lowerBound.data(), m_upperBound.data(), nWSR, 0)
-           != qpOASES::SUCCESSFUL_RETURN)
+        if(!initializeSolver(false))
         {
-            yError() << "[solve] Unable to solve the problem.";
+            yError() << "[solve] Unable to initialize the solver.";
             return false;
         }
+
+        m_isFirstTime = false;
     }
     else
     {
-        if(m_optimizer->init(m_hessianDense.data(), m_gradient.data(), constraintMatrix.data(),
-                             m_minJointLimit.data(), m_maxJointLimit.data(),
-                             m_lowerBound.data(), m_upperBound.data(), nWSR, 0)
-           != qpOASES::SUCCESSFUL_RETURN)
+        // the working set of the previous solution is kept by the solver
+        int nWSR = m_maxNumberOfWorkingSetRecalculations;
+        if(m_optimizer->hotstart(m_hessianDense.data(), m_gradient.data(), m_constraintsMatrixDense.data(),
+                                 m_minJointLimit.data(), m_maxJointLimit.data(),
+                                 m_lowerBound.data(), m_upperBound.data(), nWSR, 0)
+           == qpOASES::SUCCESSFUL_RETURN)
         {
-            yError() << "[solve] Unable to solve the problem.";
-            return false;
+            m_numberOfWorkingSetRecalculations = nWSR;
         }
+        else
+        {
+            yWarning() << "[solve] The hotstart failed. The solver is initialized again from the last working set.";
 
-        m_isFirstTime = false;
+            m_optimizer->getBounds(m_guessedBounds);
+            m_optimizer->getConstraints(m_guessedConstraints);
+            m_optimizer->reset();
+
+            if(!initializeSolver(true))
+            {
+                yError() << "[solve] Unable to solve the problem.";
+                return false;
+            }
+        }
     }
 
     m_optimizer->getPrimalSolution(m_solution.data());
@@ -111,3 +153,8 @@ bool WalkingQPIK_qpOASES::solve()
 
     return true;
 }
+
+int WalkingQPIK_qpOASES::getNumberOfIterations() const
+{
+    return m_numberOfWorkingSetRecalculations;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file FilterBank.h
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2019 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2019
+ */
+
+#ifndef WALKING_CONTROLLERS_IDYNTREE_FILTER_BANK_H
+#define WALKING_CONTROLLERS_IDYNTREE_FILTER_BANK_H
+
+// std
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+namespace WalkingControllers
+{
+    /**
+     * Bank of first order low pass filters. The states of all the filtered signals are stored
+     * in contiguous arrays and all the channels are updated at once. The filters are discretized
+     * with the Tustin method as the iCub::ctrl::FirstOrderLowPassFilter.
+     * Usage: the signals are registered with addSignal(), at each tick the inputs are set with
+     * setInput(), all the channels are updated with filter() and the outputs are copied with
+     * getOutput().
+     */
+    class FirstOrderLowPassFilterBank
+    {
+        /**
+         * Portion of the bank associated to a signal.
+         */
+        struct Signal
+        {
+            Eigen::Index offset; /**< Index of the first channel of the signal. */
+            Eigen::Index size; /**< Number of channels of the signal. */
+        };
+
+        Eigen::Index m_capacity{0}; /**< Maximum number of channels. */
+        Eigen::Index m_numberOfChannels{0}; /**< Number of registered channels. */
+        std::vector<Signal> m_signals; /**< Registered signals. */
+
+        Eigen::ArrayXd m_input; /**< Inputs of the filters. */
+        Eigen::ArrayXd m_previousInput; /**< Inputs at the previous tick. */
+        Eigen::ArrayXd m_output; /**< Outputs of the filters. */
+        Eigen::ArrayXd m_inputGain; /**< Gain of the sum of the current and the previous inputs. */
+        Eigen::ArrayXd m_outputGain; /**< Gain of the previous output. */
+
+        /**
+         * Check if the signal exists and its size is correct.
+         * @param signal index of the signal;
+         * @param size size of the vector associated to the signal.
+         * @return true if the signal is valid.
+         */
+        bool isValid(const std::size_t& signal, const Eigen::Index& size) const;
+
+    public:
+
+        /**
+         * Initialize the bank.
+         * @param capacity maximum number of channels.
+         */
+        void initialize(const std::size_t& capacity);
+
+        /**
+         * Register a signal.
+         * @param size number of channels of the signal;
+         * @param cutFrequency cut frequency of the filters in Hz;
+         * @param samplingTime sampling time in seconds;
+         * @param signal index of the signal used to set its input and get its output.
+         * @return true/false in case of success/failure.
+         */
+        bool addSignal(const std::size_t& size, const double& cutFrequency, const double& samplingTime,
+                       std::size_t& signal);
+
+        /**
+         * Reset the state of the filters of a signal (i.e. the output and the previous
+         * input are set equal to the value).
+         * @param signal index of the signal;
+         * @param value initial value of the signal.
+         * @return true/false in case of success/failure.
+         */
+        bool reset(const std::size_t& signal, const Eigen::Ref<const Eigen::VectorXd>& value);
+
+        /**
+         * Set the input of a signal.
+         * @param signal index of the signal;
+         * @param input the input.
+         * @return true/false in case of success/failure.
+         */
+        bool setInput(const std::size_t& signal, const Eigen::Ref<const Eigen::VectorXd>& input);
+
+        /**
+         * Update all the filters of the bank.
+         */
+        void filter();
+
+        /**
+         * Get the filtered signal.
+         * @param signal index of the signal;
+         * @param output the filtered signal.
+         * @return true/false in case of success/failure.
+         */
+        bool getOutput(const std::size_t& signal, Eigen::Ref<Eigen::VectorXd> output) const;
+    };
+};
+
+#endif
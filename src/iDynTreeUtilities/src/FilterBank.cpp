@@ -0,0 +1,138 @@
+/**
+ * @file FilterBank.cpp
+ * @authors Giulio Romualdi <giulio.romualdi@iit.it>
+ * @copyright 2019 iCub Facility - Istituto Italiano di Tecnologia
+ *            Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ * @date 2019
+ */
+
+// std
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <cmath>
+
+// YARP
+#include <yarp/os/LogStream.h>
+
+#include <WalkingControllers/iDynTreeUtilities/FilterBank.h>
+
+using namespace WalkingControllers;
+
+void FirstOrderLowPassFilterBank::initialize(const std::size_t& capacity)
+{
+    m_capacity = capacity;
+    m_numberOfChannels = 0;
+    m_signals.clear();
+
+    // the storage is allocated once
+    m_input = Eigen::ArrayXd::Zero(m_capacity);
+    m_previousInput = Eigen::ArrayXd::Zero(m_capacity);
+    m_output = Eigen::ArrayXd::Zero(m_capacity);
+    m_inputGain = Eigen::ArrayXd::Zero(m_capacity);
+    m_outputGain = Eigen::ArrayXd::Zero(m_capacity);
+}
+
+bool FirstOrderLowPassFilterBank::addSignal(const std::size_t& size, const double& cutFrequency,
+                                            const double& samplingTime, std::size_t& signal)
+{
+    if(m_numberOfChannels + static_cast<Eigen::Index>(size) > m_capacity)
+    {
+        yError() << "[FirstOrderLowPassFilterBank::addSignal] The capacity of the bank is" << m_capacity
+                 << "channels. Unable to add" << size << "channels.";
+        return false;
+    }
+
+    if(cutFrequency <= 0 || samplingTime <= 0)
+    {
+        yError() << "[FirstOrderLowPassFilterBank::addSignal] The cut frequency and the sampling time have to be"
+                 << "positive.";
+        return false;
+    }
+
+    // y(k) = (Ts * (u(k) + u(k-1)) - (Ts - 2 tau) * y(k-1)) / (Ts + 2 tau)
+    double tau = 1.0 / (2.0 * M_PI * cutFrequency);
+    double denominator = samplingTime + 2.0 * tau;
+
+    Signal newSignal;
+    newSignal.offset = m_numberOfChannels;
+    newSignal.size = size;
+    m_inputGain.segment(newSignal.offset, newSignal.size).setConstant(samplingTime / denominator);
+    m_outputGain.segment(newSignal.offset, newSignal.size).setConstant((2.0 * tau - samplingTime) / denominator);
+
+    m_numberOfChannels += newSignal.size;
+    signal = m_signals.size();
+    m_signals.push_back(newSignal);
+
+    return true;
+}
+
+bool FirstOrderLowPassFilterBank::isValid(const std::size_t& signal, const Eigen::Index& size) const
+{
+    if(signal >= m_signals.size())
+    {
+        yError() << "[FirstOrderLowPassFilterBank::isValid] The signal" << signal << "is not registered.";
+        return false;
+    }
+
+    if(m_signals[signal].size != size)
+    {
+        yError() << "[FirstOrderLowPassFilterBank::isValid] The size of the signal" << signal << "is"
+                 << m_signals[signal].size << "while the size of the vector is" << size;
+        return false;
+    }
+
+    return true;
+}
+
+bool FirstOrderLowPassFilterBank::reset(const std::size_t& signal, const Eigen::Ref<const Eigen::VectorXd>& value)
+{
+    if(!isValid(signal, value.size()))
+    {
+        yError() << "[FirstOrderLowPassFilterBank::reset] Unable to reset the signal.";
+        return false;
+    }
+
+    const Signal& resetSignal = m_signals[signal];
+    m_input.segment(resetSignal.offset, resetSignal.size) = value.array();
+    m_previousInput.segment(resetSignal.offset, resetSignal.size) = value.array();
+    m_output.segment(resetSignal.offset, resetSignal.size) = value.array();
+
+    return true;
+}
+
+bool FirstOrderLowPassFilterBank::setInput(const std::size_t& signal, const Eigen::Ref<const Eigen::VectorXd>& input)
+{
+    if(!isValid(signal, input.size()))
+    {
+        yError() << "[FirstOrderLowPassFilterBank::setInput] Unable to set the input of the signal.";
+        return false;
+    }
+
+    m_input.segment(m_signals[signal].offset, m_signals[signal].size) = input.array();
+    return true;
+}
+
+void FirstOrderLowPassFilterBank::filter()
+{
+    // all the channels are updated with a single vectorized expression
+    auto input = m_input.head(m_numberOfChannels);
+    auto previousInput = m_previousInput.head(m_numberOfChannels);
+    auto output = m_output.head(m_numberOfChannels);
+
+    output = m_inputGain.head(m_numberOfChannels) * (input + previousInput)
+        + m_outputGain.head(m_numberOfChannels) * output;
+    previousInput = input;
+}
+
+bool FirstOrderLowPassFilterBank::getOutput(const std::size_t& signal, Eigen::Ref<Eigen::VectorXd> output) const
+{
+    if(!isValid(signal, output.size()))
+    {
+        yError() << "[FirstOrderLowPassFilterBank::getOutput] Unable to get the output of the signal.";
+        return false;
+    }
+
+    output = m_output.segment(m_signals[signal].offset, m_signals[signal].size).matrix();
+    return true;
+}
@@ -0,0 +1,193 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Core/MatrixDynSize.h>
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/Twist.h>
+#include <iDynTree/Core/VectorDynSize.h>
+#include <iDynTree/KinDynComputations.h>
+#include <iDynTree/Model/ModelTestUtils.h>
+
+#include <WalkingControllers/KinDynWrapper/KinematicsWorkspace.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    constexpr double tolerance = 1e-9;
+
+    template <class T, class U>
+    double maxError(const T& expected, const U& actual)
+    {
+        return (iDynTree::toEigen(expected) - iDynTree::toEigen(actual)).cwiseAbs().maxCoeff();
+    }
+
+    std::vector<KinematicsConfiguration> getRandomConfigurations(const iDynTree::Model& model,
+                                                                 std::size_t numberOfConfigurations)
+    {
+        std::vector<KinematicsConfiguration> configurations(numberOfConfigurations);
+        for(auto& configuration : configurations)
+        {
+            configuration.worldToBaseTransform = iDynTree::getRandomTransform();
+            configuration.jointPositions.resize(model.getNrOfPosCoords());
+            iDynTree::getRandomJointPositions(configuration.jointPositions, model);
+        }
+        return configurations;
+    }
+
+    void requireEqualWorkspaces(const KinematicsWorkspace& expected, const KinematicsWorkspace& actual)
+    {
+        REQUIRE(maxError(expected.getCoMPosition(), actual.getCoMPosition()) < tolerance);
+
+        iDynTree::Transform expectedTransform, transform;
+        iDynTree::MatrixDynSize expectedJacobian, jacobian;
+        for(iDynTree::FrameIndex frame = 0; frame < expected.getKinematicsModel().model.getNrOfFrames(); frame++)
+        {
+            REQUIRE(expected.getWorldTransform(frame, expectedTransform));
+            REQUIRE(actual.getWorldTransform(frame, transform));
+            REQUIRE(maxError(expectedTransform.getPosition(), transform.getPosition()) < tolerance);
+            REQUIRE(maxError(expectedTransform.getRotation(), transform.getRotation()) < tolerance);
+
+            REQUIRE(expected.getFrameFreeFloatingJacobian(frame, expectedJacobian));
+            REQUIRE(actual.getFrameFreeFloatingJacobian(frame, jacobian));
+            REQUIRE(maxError(expectedJacobian, jacobian) < tolerance);
+        }
+    }
+}
+
+TEST_CASE("Compare KinematicsWorkspace with KinDynComputations", "[KinematicsWorkspace]")
+{
+    iDynTree::Model model = iDynTree::getRandomModel(20);
+
+    // an additional frame is used as base frame, so the transform between the base frame and its
+    // link is not the identity
+    REQUIRE(model.getNrOfFrames() > model.getNrOfLinks());
+    const std::string baseFrame = model.getFrameName(model.getNrOfLinks());
+
+    std::shared_ptr<const KinematicsModel> kinematicsModel;
+    REQUIRE(createKinematicsModel(model, baseFrame, kinematicsModel));
+
+    KinematicsWorkspace workspace;
+    iDynTree::Transform transform;
+    iDynTree::MatrixDynSize jacobian;
+
+    // the workspace is not initialized
+    REQUIRE_FALSE(workspace.getWorldTransform(0, transform));
+    REQUIRE_FALSE(workspace.getFrameFreeFloatingJacobian(0, jacobian));
+
+    REQUIRE(workspace.initialize(kinematicsModel));
+
+    // the configuration is not evaluated
+    REQUIRE_FALSE(workspace.getWorldTransform(0, transform));
+
+    iDynTree::KinDynComputations kinDyn;
+    REQUIRE(kinDyn.loadRobotModel(model));
+    REQUIRE(kinDyn.setFloatingBase(model.getLinkName(kinematicsModel->baseLink)));
+    REQUIRE(kinDyn.setFrameVelocityRepresentation(iDynTree::MIXED_REPRESENTATION));
+
+    iDynTree::VectorDynSize jointPositions(model.getNrOfPosCoords());
+    iDynTree::VectorDynSize jointVelocities(model.getNrOfDOFs());
+    jointVelocities.zero();
+    iDynTree::Twist baseTwist;
+    baseTwist.zero();
+    iDynTree::Vector3 gravity;
+    gravity.zero();
+    gravity(2) = -9.81;
+
+    iDynTree::MatrixDynSize expectedJacobian(6, model.getNrOfDOFs() + 6);
+    for(int i = 0; i < 10; i++)
+    {
+        iDynTree::Transform worldToBaseTransform = iDynTree::getRandomTransform();
+        iDynTree::getRandomJointPositions(jointPositions, model);
+
+        REQUIRE(workspace.setConfiguration(worldToBaseTransform, jointPositions));
+
+        // KinDynComputations uses the transform of the base link
+        iDynTree::Transform worldToBaseLinkTransform = worldToBaseTransform
+            * kinematicsModel->baseFrameToLinkTransform;
+        REQUIRE(kinDyn.setRobotState(worldToBaseLinkTransform, jointPositions, baseTwist,
+                                     jointVelocities, gravity));
+
+        REQUIRE(maxError(kinDyn.getCenterOfMassPosition(), workspace.getCoMPosition()) < tolerance);
+
+        for(iDynTree::FrameIndex frame = 0; frame < model.getNrOfFrames(); frame++)
+        {
+            REQUIRE(workspace.getWorldTransform(frame, transform));
+            iDynTree::Transform expectedTransform = kinDyn.getWorldTransform(frame);
+            REQUIRE(maxError(expectedTransform.getPosition(), transform.getPosition()) < tolerance);
+            REQUIRE(maxError(expectedTransform.getRotation(), transform.getRotation()) < tolerance);
+
+            REQUIRE(workspace.getFrameFreeFloatingJacobian(frame, jacobian));
+            REQUIRE(kinDyn.getFrameFreeFloatingJacobian(frame, expectedJacobian));
+            REQUIRE(maxError(expectedJacobian, jacobian) < tolerance);
+        }
+    }
+
+    // invalid frame indices
+    REQUIRE_FALSE(workspace.getWorldTransform(iDynTree::FRAME_INVALID_INDEX, transform));
+    REQUIRE_FALSE(workspace.getWorldTransform(model.getNrOfFrames(), transform));
+    REQUIRE_FALSE(workspace.getFrameFreeFloatingJacobian(model.getNrOfFrames(), jacobian));
+}
+
+TEST_CASE("Evaluate a batch of configurations with several threads", "[KinematicsBatch]")
+{
+    iDynTree::Model model = iDynTree::getRandomModel(20);
+    const std::string baseFrame = model.getLinkName(0);
+
+    std::shared_ptr<const KinematicsModel> kinematicsModel;
+    REQUIRE(createKinematicsModel(model, baseFrame, kinematicsModel));
+
+    constexpr std::size_t capacity = 8;
+    KinematicsBatch batch;
+
+    // the batch is not initialized
+    REQUIRE_FALSE(batch.evaluate(getRandomConfigurations(model, 1)));
+
+    REQUIRE_FALSE(batch.initialize(kinematicsModel, 0, 3));
+    REQUIRE(batch.initialize(kinematicsModel, capacity, 3));
+    REQUIRE_FALSE(batch.initialize(kinematicsModel, capacity, 3));
+
+    KinematicsWorkspace sequentialWorkspace;
+    REQUIRE(sequentialWorkspace.initialize(kinematicsModel));
+
+    // the batch is reused with a different number of configurations
+    for(std::size_t numberOfConfigurations : {capacity, std::size_t(3), capacity - 1})
+    {
+        std::vector<KinematicsConfiguration> configurations = getRandomConfigurations(model, numberOfConfigurations);
+        REQUIRE(batch.evaluate(configurations));
+
+        for(std::size_t i = 0; i < numberOfConfigurations; i++)
+        {
+            REQUIRE(sequentialWorkspace.setConfiguration(configurations[i]));
+            requireEqualWorkspaces(sequentialWorkspace, batch.getWorkspace(i));
+        }
+    }
+
+    // empty batch
+    REQUIRE(batch.evaluate(std::vector<KinematicsConfiguration>()));
+
+    // the number of configurations is greater than the capacity
+    REQUIRE_FALSE(batch.evaluate(getRandomConfigurations(model, capacity + 1)));
+
+    // a configuration with a wrong number of joints is not evaluated
+    std::vector<KinematicsConfiguration> configurations = getRandomConfigurations(model, 2);
+    configurations[1].jointPositions.resize(model.getNrOfPosCoords() + 1);
+    REQUIRE_FALSE(batch.evaluate(configurations));
+
+    // the batch still works after a failure
+    configurations = getRandomConfigurations(model, capacity);
+    REQUIRE(batch.evaluate(configurations));
+    REQUIRE(sequentialWorkspace.setConfiguration(configurations.back()));
+    requireEqualWorkspaces(sequentialWorkspace, batch.getWorkspace(capacity - 1));
+
+    batch.close();
+}
@@ -0,0 +1,306 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+// std
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+// eigen
+#include <Eigen/Dense>
+
+// YARP
+#include <yarp/os/Property.h>
+
+// iDynTree
+#include <iDynTree/Core/EigenHelpers.h>
+#include <iDynTree/Core/MatrixDynSize.h>
+#include <iDynTree/Core/Transform.h>
+#include <iDynTree/Core/Twist.h>
+#include <iDynTree/Core/VectorDynSize.h>
+
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_KKT.h>
+#include <WalkingControllers/WholeBodyControllers/QPInverseKinematics_qpOASES.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    constexpr int actuatedDOFs = 23;
+
+    /**
+     * QP-IK solver whose robot state can be set without the forward kinematics.
+     */
+    template <class Solver>
+    class RandomQPIK : public Solver
+    {
+    public:
+        void setMeasuredState(const iDynTree::VectorDynSize& jointPosition,
+                              const iDynTree::Transform& leftFootToWorldTransform,
+                              const iDynTree::Transform& rightFootToWorldTransform,
+                              const iDynTree::Rotation& neckOrientation,
+                              const iDynTree::Position& comPosition)
+        {
+            this->m_jointPosition = jointPosition;
+            this->m_leftFootToWorldTransform = leftFootToWorldTransform;
+            this->m_rightFootToWorldTransform = rightFootToWorldTransform;
+            this->m_neckOrientation = neckOrientation;
+            this->m_comPosition = comPosition;
+        }
+    };
+
+    /**
+     * Random equality-constrained least-squares problem. The feet (and the CoM) tasks are
+     * equality constraints, the CoM, the neck and the joint regularization are in the cost.
+     */
+    struct RandomProblem
+    {
+        iDynTree::VectorDynSize jointPosition{actuatedDOFs};
+        iDynTree::Transform leftFootToWorldTransform;
+        iDynTree::Transform rightFootToWorldTransform;
+        iDynTree::Rotation neckOrientation;
+        iDynTree::Position comPosition;
+
+        iDynTree::MatrixDynSize leftFootJacobian{6, actuatedDOFs + 6};
+        iDynTree::MatrixDynSize rightFootJacobian{6, actuatedDOFs + 6};
+        iDynTree::MatrixDynSize neckJacobian{6, actuatedDOFs + 6};
+        iDynTree::MatrixDynSize comJacobian{3, actuatedDOFs + 6};
+
+        iDynTree::Transform desiredLeftFootToWorldTransform;
+        iDynTree::Transform desiredRightFootToWorldTransform;
+        iDynTree::Twist desiredLeftFootTwist;
+        iDynTree::Twist desiredRightFootTwist;
+        iDynTree::Rotation desiredNeckOrientation;
+        iDynTree::Position desiredComPosition;
+        iDynTree::Vector3 desiredComVelocity;
+    };
+
+    iDynTree::Rotation randomRotation()
+    {
+        Eigen::Vector3d rpy = Eigen::Vector3d::Random();
+        return iDynTree::Rotation::RPY(rpy(0), rpy(1), rpy(2));
+    }
+
+    iDynTree::Position randomPosition()
+    {
+        iDynTree::Position position;
+        iDynTree::toEigen(position) = Eigen::Vector3d::Random();
+        return position;
+    }
+
+    iDynTree::Transform randomTransform()
+    {
+        return iDynTree::Transform(randomRotation(), randomPosition());
+    }
+
+    iDynTree::Twist randomTwist()
+    {
+        iDynTree::Twist twist;
+        iDynTree::toEigen(twist.getLinearVec3()) = Eigen::Vector3d::Random();
+        iDynTree::toEigen(twist.getAngularVec3()) = Eigen::Vector3d::Random();
+        return twist;
+    }
+
+    RandomProblem createRandomProblem()
+    {
+        RandomProblem problem;
+        iDynTree::toEigen(problem.jointPosition) = Eigen::VectorXd::Random(actuatedDOFs);
+        problem.leftFootToWorldTransform = randomTransform();
+        problem.rightFootToWorldTransform = randomTransform();
+        problem.neckOrientation = randomRotation();
+        problem.comPosition = randomPosition();
+
+        iDynTree::toEigen(problem.leftFootJacobian) = Eigen::MatrixXd::Random(6, actuatedDOFs + 6);
+        iDynTree::toEigen(problem.rightFootJacobian) = Eigen::MatrixXd::Random(6, actuatedDOFs + 6);
+        iDynTree::toEigen(problem.neckJacobian) = Eigen::MatrixXd::Random(6, actuatedDOFs + 6);
+        iDynTree::toEigen(problem.comJacobian) = Eigen::MatrixXd::Random(3, actuatedDOFs + 6);
+
+        problem.desiredLeftFootToWorldTransform = randomTransform();
+        problem.desiredRightFootToWorldTransform = randomTransform();
+        problem.desiredLeftFootTwist = randomTwist();
+        problem.desiredRightFootTwist = randomTwist();
+        problem.desiredNeckOrientation = randomRotation();
+        problem.desiredComPosition = randomPosition();
+        iDynTree::toEigen(problem.desiredComVelocity) = Eigen::Vector3d::Random();
+
+        return problem;
+    }
+
+    yarp::os::Property createConfig(bool useCoMAsConstraint, bool useJointLimitsConstraint = false)
+    {
+        std::ostringstream joints, weights, gains;
+        for(int i = 0; i < actuatedDOFs; i++)
+        {
+            joints << 5.0 * i << " ";
+            weights << 0.1 + 0.05 * i << " ";
+            gains << 1.0 + 0.2 * i << " ";
+        }
+
+        std::ostringstream config;
+        config << "(use_com_as_constraint " << (useCoMAsConstraint ? 1 : 0) << ") "
+               << "(use_joint_limits_constraint " << (useJointLimitsConstraint ? 1 : 0) << ") "
+               << "(com_weight (10.0 10.0 10.0)) "
+               << "(neck_weight 5.0) "
+               << "(additional_rotation ((0.0 0.0 1.0) (1.0 0.0 0.0) (0.0 1.0 0.0))) "
+               << "(joint_regularization (" << joints.str() << ")) "
+               << "(joint_regularization_weights (" << weights.str() << ")) "
+               << "(joint_regularization_gains (" << gains.str() << ")) "
+               << "(k_posCom 1.0) (k_posFoot 7.0) (k_attFoot 5.0) (k_neck 5.0) "
+               << "(k_joint_limit_lower_bound 1.0) (k_joint_limit_upper_bound 1.0)";
+
+        yarp::os::Property property;
+        property.fromString(config.str());
+        return property;
+    }
+
+    template <class Solver>
+    void setProblem(RandomQPIK<Solver>& solver, const RandomProblem& problem)
+    {
+        solver.setMeasuredState(problem.jointPosition,
+                                problem.leftFootToWorldTransform,
+                                problem.rightFootToWorldTransform,
+                                problem.neckOrientation,
+                                problem.comPosition);
+
+        REQUIRE(solver.setLeftFootJacobian(problem.leftFootJacobian));
+        REQUIRE(solver.setRightFootJacobian(problem.rightFootJacobian));
+        REQUIRE(solver.setNeckJacobian(problem.neckJacobian));
+        REQUIRE(solver.setCoMJacobian(problem.comJacobian));
+
+        solver.setDesiredFeetTransformation(problem.desiredLeftFootToWorldTransform,
+                                            problem.desiredRightFootToWorldTransform);
+        solver.setDesiredFeetTwist(problem.desiredLeftFootTwist, problem.desiredRightFootTwist);
+        solver.setDesiredNeckOrientation(problem.desiredNeckOrientation);
+        solver.setDesiredCoMPosition(problem.desiredComPosition);
+        solver.setDesiredCoMVelocity(problem.desiredComVelocity);
+    }
+
+    /**
+     * Return -1 (1) if the joint velocity is at the lower (upper) bound and 0 otherwise.
+     */
+    int getBoundStatus(double velocity, double lowerBound, double upperBound)
+    {
+        constexpr double tolerance = 1e-7;
+        if(std::abs(velocity - lowerBound) < tolerance)
+            return -1;
+        if(std::abs(velocity - upperBound) < tolerance)
+            return 1;
+        return 0;
+    }
+}
+
+TEST_CASE("Compare the KKT and the qpOASES QP-IK solutions", "[WalkingQPIK_KKT]")
+{
+    std::srand(42);
+
+    // joint limits are not considered, the problem is equality-constrained
+    iDynTree::VectorDynSize maxJointsVelocity(actuatedDOFs);
+    iDynTree::VectorDynSize maxJointsPosition(actuatedDOFs);
+    iDynTree::VectorDynSize minJointsPosition(actuatedDOFs);
+    iDynTree::toEigen(maxJointsVelocity).setConstant(10.0);
+    iDynTree::toEigen(maxJointsPosition).setConstant(3.0);
+    iDynTree::toEigen(minJointsPosition).setConstant(-3.0);
+
+    for(bool useCoMAsConstraint : {false, true})
+    {
+        yarp::os::Property config = createConfig(useCoMAsConstraint);
+
+        RandomQPIK<WalkingQPIK_KKT> kktSolver;
+        RandomQPIK<WalkingQPIK_qpOASES> qpOASESSolver;
+        REQUIRE(kktSolver.initialize(config, actuatedDOFs, maxJointsVelocity,
+                                     maxJointsPosition, minJointsPosition));
+        REQUIRE(qpOASESSolver.initialize(config, actuatedDOFs, maxJointsVelocity,
+                                         maxJointsPosition, minJointsPosition));
+
+        for(int i = 0; i < 10; i++)
+        {
+            RandomProblem problem = createRandomProblem();
+            setProblem(kktSolver, problem);
+            setProblem(qpOASESSolver, problem);
+
+            REQUIRE(kktSolver.solve());
+            REQUIRE(qpOASESSolver.solve());
+
+            const Eigen::VectorXd kktSolution = iDynTree::toEigen(kktSolver.getSolution());
+            const Eigen::VectorXd qpOASESSolution = iDynTree::toEigen(qpOASESSolver.getSolution());
+            REQUIRE(kktSolution.size() == actuatedDOFs + 6);
+            REQUIRE((kktSolution - qpOASESSolution).lpNorm<Eigen::Infinity>()
+                    <= 1e-6 * (1.0 + qpOASESSolution.lpNorm<Eigen::Infinity>()));
+        }
+    }
+}
+
+TEST_CASE("Compare the KKT and the qpOASES QP-IK solutions with the joint limits", "[WalkingQPIK_KKT]")
+{
+    std::srand(7);
+
+    // the first joints have tight velocity and position limits, so their bounds are activated
+    // and released between consecutive calls. The bounds of the other joints are never active
+    constexpr int boundedJoints = 6;
+    iDynTree::VectorDynSize maxJointsVelocity(actuatedDOFs);
+    iDynTree::VectorDynSize maxJointsPosition(actuatedDOFs);
+    iDynTree::VectorDynSize minJointsPosition(actuatedDOFs);
+    for(int i = 0; i < actuatedDOFs; i++)
+    {
+        bool isBounded = i < boundedJoints;
+        maxJointsVelocity(i) = isBounded ? 0.3 : 100.0;
+        maxJointsPosition(i) = isBounded ? 1.2 : 3.0;
+        minJointsPosition(i) = isBounded ? -1.2 : -3.0;
+    }
+
+    for(bool useCoMAsConstraint : {false, true})
+    {
+        yarp::os::Property config = createConfig(useCoMAsConstraint, true);
+
+        RandomQPIK<WalkingQPIK_KKT> kktSolver;
+        RandomQPIK<WalkingQPIK_qpOASES> qpOASESSolver;
+        REQUIRE(kktSolver.initialize(config, actuatedDOFs, maxJointsVelocity,
+                                     maxJointsPosition, minJointsPosition));
+        REQUIRE(qpOASESSolver.initialize(config, actuatedDOFs, maxJointsVelocity,
+                                         maxJointsPosition, minJointsPosition));
+
+        int numberOfActivatedBounds = 0;
+        int numberOfReleasedBounds = 0;
+        std::vector<int> previousStatus(actuatedDOFs, 0);
+
+        // the solvers are warm started with the working set of the previous call
+        for(int i = 0; i < 20; i++)
+        {
+            RandomProblem problem = createRandomProblem();
+            setProblem(kktSolver, problem);
+            setProblem(qpOASESSolver, problem);
+
+            REQUIRE(kktSolver.solve());
+            REQUIRE(qpOASESSolver.solve());
+
+            const Eigen::VectorXd kktSolution = iDynTree::toEigen(kktSolver.getSolution());
+            const Eigen::VectorXd qpOASESSolution = iDynTree::toEigen(qpOASESSolver.getSolution());
+            REQUIRE((kktSolution - qpOASESSolution).lpNorm<Eigen::Infinity>()
+                    <= 1e-6 * (1.0 + qpOASESSolution.lpNorm<Eigen::Infinity>()));
+
+            // the gains of the joint limits are equal to one
+            for(int j = 0; j < actuatedDOFs; j++)
+            {
+                double lowerBound = std::tanh(problem.jointPosition(j) - minJointsPosition(j))
+                    * (-maxJointsVelocity(j));
+                double upperBound = std::tanh(maxJointsPosition(j) - problem.jointPosition(j))
+                    * maxJointsVelocity(j);
+
+                double velocity = kktSolver.getDesiredJointVelocities()(j);
+                REQUIRE(velocity >= lowerBound - 1e-7);
+                REQUIRE(velocity <= upperBound + 1e-7);
+
+                int status = getBoundStatus(velocity, lowerBound, upperBound);
+                if(status != 0)
+                    numberOfActivatedBounds++;
+                if(previousStatus[j] != 0 && status != previousStatus[j])
+                    numberOfReleasedBounds++;
+                previousStatus[j] = status;
+            }
+        }
+
+        REQUIRE(numberOfActivatedBounds > 0);
+        REQUIRE(numberOfReleasedBounds > 0);
+    }
+}
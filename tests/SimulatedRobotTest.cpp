@@ -0,0 +1,194 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+
+// std
+#include <fstream>
+#include <string>
+
+// YARP
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/os/Time.h>
+#include <yarp/sig/Vector.h>
+
+// iDynTree
+#include <iDynTree/Core/Utils.h>
+
+#include <WalkingControllers/RobotInterface/SimulatedRobot.h>
+#include <WalkingControllers/YarpUtilities/Helper.h>
+
+using namespace WalkingControllers;
+
+namespace
+{
+    constexpr double gravityAcceleration = 9.81;
+    constexpr double totalMass = 13.0;
+
+    /**
+     * Biped with a 10 kg trunk, a 1 kg left leg and two 1 kg feet. The legs are moved along the y
+     * axis of the trunk by two prismatic joints, the left foot is lifted by a prismatic joint
+     * along the z axis.
+     */
+    const std::string model = R"(<?xml version="1.0"?>
+<robot name="biped">
+  <link name="root_link">
+    <inertial>
+      <origin xyz="0 0 0" rpy="0 0 0"/>
+      <mass value="10.0"/>
+      <inertia ixx="0.1" ixy="0" ixz="0" iyy="0.1" iyz="0" izz="0.1"/>
+    </inertial>
+  </link>
+  <link name="l_foot">
+    <inertial>
+      <origin xyz="0 0 0" rpy="0 0 0"/>
+      <mass value="1.0"/>
+      <inertia ixx="0.01" ixy="0" ixz="0" iyy="0.01" iyz="0" izz="0.01"/>
+    </inertial>
+  </link>
+  <link name="l_leg_link">
+    <inertial>
+      <origin xyz="0 0 0" rpy="0 0 0"/>
+      <mass value="1.0"/>
+      <inertia ixx="0.01" ixy="0" ixz="0" iyy="0.01" iyz="0" izz="0.01"/>
+    </inertial>
+  </link>
+  <link name="r_foot">
+    <inertial>
+      <origin xyz="0 0 0" rpy="0 0 0"/>
+      <mass value="1.0"/>
+      <inertia ixx="0.01" ixy="0" ixz="0" iyy="0.01" iyz="0" izz="0.01"/>
+    </inertial>
+  </link>
+  <link name="l_sole"/>
+  <link name="r_sole"/>
+  <joint name="l_leg" type="prismatic">
+    <origin xyz="0 0.1 -0.4" rpy="0 0 0"/>
+    <axis xyz="0 1 0"/>
+    <parent link="root_link"/>
+    <child link="l_leg_link"/>
+    <limit lower="-0.2" upper="0.2" effort="100" velocity="1"/>
+  </joint>
+  <joint name="l_leg_z" type="prismatic">
+    <origin xyz="0 0 -0.1" rpy="0 0 0"/>
+    <axis xyz="0 0 1"/>
+    <parent link="l_leg_link"/>
+    <child link="l_foot"/>
+    <limit lower="-0.1" upper="0.1" effort="100" velocity="1"/>
+  </joint>
+  <joint name="r_leg" type="prismatic">
+    <origin xyz="0 -0.1 -0.5" rpy="0 0 0"/>
+    <axis xyz="0 1 0"/>
+    <parent link="root_link"/>
+    <child link="r_foot"/>
+    <limit lower="-0.2" upper="0.2" effort="100" velocity="1"/>
+  </joint>
+  <joint name="l_sole_fixed_joint" type="fixed">
+    <origin xyz="0 0 0" rpy="0 0 0"/>
+    <parent link="l_foot"/>
+    <child link="l_sole"/>
+  </joint>
+  <joint name="r_sole_fixed_joint" type="fixed">
+    <origin xyz="0 0 0" rpy="0 0 0"/>
+    <parent link="r_foot"/>
+    <child link="r_sole"/>
+  </joint>
+</robot>
+)";
+
+    /**
+     * Move the joints, read the encoders and the wrenches published by the robot.
+     * @return the normal force of the right foot.
+     */
+    double moveAndReadRightFootForce(SimulatedRobot& robot, double leftLeg, double leftFootHeight, double rightLeg,
+                                     yarp::os::BufferedPort<yarp::sig::Vector>& leftWrenchPort,
+                                     yarp::os::BufferedPort<yarp::sig::Vector>& rightWrenchPort)
+    {
+        // the prismatic joints are commanded in "degrees" as the revolute ones
+        double references[3] = {iDynTree::rad2deg(leftLeg), iDynTree::rad2deg(leftFootHeight),
+                                iDynTree::rad2deg(rightLeg)};
+        double timeBeforeMove = yarp::os::Time::now();
+        REQUIRE(robot.positionMove(references));
+        double timeAfterMove = yarp::os::Time::now();
+
+        double encoders[3], timestamps[3];
+        REQUIRE(robot.getEncodersTimed(encoders, timestamps));
+        for(int i = 0; i < 3; i++)
+            REQUIRE(encoders[i] == Approx(references[i]));
+
+        // the state is stamped with the wall-clock time
+        REQUIRE(timestamps[0] >= timeBeforeMove);
+        REQUIRE(timestamps[0] <= timeAfterMove);
+
+        yarp::sig::Vector* leftWrench = leftWrenchPort.read(true);
+        yarp::sig::Vector* rightWrench = rightWrenchPort.read(true);
+        REQUIRE(leftWrench != nullptr);
+        REQUIRE(rightWrench != nullptr);
+        REQUIRE(leftWrench->size() == 6);
+        REQUIRE(rightWrench->size() == 6);
+
+        // the wrenches are stamped with the time of the encoders
+        yarp::os::Stamp stamp;
+        REQUIRE(rightWrenchPort.getEnvelope(stamp));
+        REQUIRE(stamp.getTime() == Approx(timestamps[0]));
+
+        // the robot is at rest, the feet forces balance the gravity
+        REQUIRE((*leftWrench)(2) + (*rightWrench)(2) == Approx(totalMass * gravityAcceleration));
+        for(int i = 0; i < 2; i++)
+        {
+            REQUIRE((*leftWrench)(i) == Approx(0.0).margin(1e-9));
+            REQUIRE((*rightWrench)(i) == Approx(0.0).margin(1e-9));
+        }
+
+        return (*rightWrench)(2);
+    }
+}
+
+TEST_CASE("Check the wrenches and the stance foot of the simulated robot", "[SimulatedRobot]")
+{
+    yarp::os::Network::setLocalMode(true);
+    yarp::os::Network yarp;
+
+    const std::string modelFile = "SimulatedRobotTest.urdf";
+    std::ofstream(modelFile) << model;
+
+    yarp::os::Property config;
+    YarpUtilities::addVectorOfStringToProperty(config, "axesNames", {"l_leg", "l_leg_z", "r_leg"});
+    config.put("sampling_time", 0.01);
+    config.put("model", modelFile);
+    config.put("left_foot_wrench_port_name", "/simulatedRobotTest/leftWrench:o");
+    config.put("right_foot_wrench_port_name", "/simulatedRobotTest/rightWrench:o");
+
+    SimulatedRobot robot;
+    REQUIRE(robot.open(config));
+
+    yarp::os::BufferedPort<yarp::sig::Vector> leftWrenchPort, rightWrenchPort;
+    REQUIRE(leftWrenchPort.open("/simulatedRobotTest/leftWrench:i"));
+    REQUIRE(rightWrenchPort.open("/simulatedRobotTest/rightWrench:i"));
+    REQUIRE(yarp::os::Network::connect("/simulatedRobotTest/leftWrench:o", "/simulatedRobotTest/leftWrench:i"));
+    REQUIRE(yarp::os::Network::connect("/simulatedRobotTest/rightWrench:o", "/simulatedRobotTest/rightWrench:i"));
+
+    const double weight = totalMass * gravityAcceleration;
+
+    // the left foot is the stance foot and it is placed in the origin, the right foot is at
+    // y = -0.2 m. In double support the share of the right foot is -y_com / 0.2
+    // (y_com = -1.2 / 13 m)
+    REQUIRE(moveAndReadRightFootForce(robot, 0.0, 0.0, 0.0, leftWrenchPort, rightWrenchPort)
+            == Approx(6.0 / 13.0 * weight));
+
+    // the trunk moves towards the right foot (y_com = -1.7 / 13 m). The ZMP is closer to the
+    // right foot, so it becomes the stance foot
+    REQUIRE(moveAndReadRightFootForce(robot, 0.05, 0.0, 0.05, leftWrenchPort, rightWrenchPort)
+            == Approx(8.5 / 13.0 * weight));
+
+    // the left foot is lifted. Since the right foot is the stance foot the robot is in single
+    // support (if the left foot was the stance foot the right one would be pushed below the
+    // ground and the robot would be in double support)
+    REQUIRE(moveAndReadRightFootForce(robot, 0.05, 0.02, 0.05, leftWrenchPort, rightWrenchPort)
+            == Approx(weight));
+
+    leftWrenchPort.close();
+    rightWrenchPort.close();
+    REQUIRE(robot.close());
+}